@@ -116,6 +116,16 @@ struct __attribute__((packed, aligned(8))) CSlot {
     size_t size() const {
         return sizeof(*this) + max_banks * sizeof(BankInfo);
     }
+
+    // FNV-1a over (crc, size) of all banks, identical for mirrored copies of the same slot
+    uint64_t fingerprint() const {
+        uint64_t h = 1469598103934665603ULL;
+        for (uint32_t i = 0; i < allocated_banks; i++) {
+            h ^= bankInfos[i].crc;  h *= 1099511628211ULL;
+            h ^= bankInfos[i].size; h *= 1099511628211ULL;
+        }
+        return h;
+    }
 };
 
 }
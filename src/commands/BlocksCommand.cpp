@@ -10,8 +10,14 @@
 #include "BlocksCommand.hpp"
 #include "utils/common.hpp"
 #include "core/structs.hpp"
+#include "scanning/PatternSearch.hpp"
 #include <lz4.h>
 
+#ifdef __linux__
+#include <fcntl.h>
+#endif
+#include <unistd.h>
+
 extern "C" {
     uint32_t vcrc32(uint32_t crc, const void *buf, unsigned int len);
 }
@@ -43,23 +49,45 @@ std::vector<BlockStruct> vbListBlocks(FILE* f){
     fseek(f, 0, SEEK_END);
     size_t fsize = ftell(f);
     fseek(f, 0, SEEK_SET);
+#ifdef __linux__
+    // listed and then extracted front to back
+    posix_fadvise(fileno(f), 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
 
     const size_t bufsize = 0x8000000;
     char* buf = (char*)malloc(bufsize);
     uint64_t hs = 0;
+    PatternSearch search;
+    search.add(signatures::lz_hdr_prefix());
+    std::vector<PatternSearch::Match> matches;
     while( hs < fsize ) {
+#ifdef SEEK_DATA
+        // holes of sparse files hold no blocks, jump to the next data
+        // (the FILE is re-positioned below in any case, lseek() moves the fd under its buffer)
+        const off_t data = lseek(fileno(f), hs, SEEK_DATA);
+        if( data == -1 && errno == ENXIO ){
+            break; // only a hole up to EOF
+        }
+        if( data > (off_t)hs ){
+            hs = data & ~0xfffULL;
+        }
+#endif
+        fseek(f, hs, SEEK_SET);
         size_t lzsz = (hs + bufsize > fsize) ? (fsize - hs) : bufsize;
         size_t nread = fread(buf, 1, lzsz, f);
         if( nread != lzsz ){
             logger->warn("nread {:x} != lzsz {:x}", nread, lzsz);
         }
-        for( size_t i = 0; i < nread; i++ ) {
-            // XXX no need to check every byte, values are aligned to 4, or even to 0x1000 bytes
-            if( *(uint32_t*)(buf+i) == LZ_START_MAGIC && buf[i+11] == 0 ) {
-                blocks.emplace_back(BlockStruct{hs+i, *(uint32_t*)(buf+i+4), *(uint32_t*)(buf+i+8)});
-            }
+        matches.clear();
+        search.find(std::span<const uint8_t>((const uint8_t*)buf, nread), matches);
+        for( const auto& m : matches ) {
+            blocks.emplace_back(BlockStruct{hs+m.pos, *(uint32_t*)(buf+m.pos+4), *(uint32_t*)(buf+m.pos+8)});
+        }
+        if( nread == 0 ){
+            break;
         }
-        hs += nread;
+        // a header must fit into the buffer to be found, so the last few bytes are searched again with the next chunk
+        hs += (hs + nread < fsize && nread > sizeof(lz_hdr)) ? nread - (sizeof(lz_hdr) - 1) : nread;
     }
 
     free(buf);
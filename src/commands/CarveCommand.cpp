@@ -20,6 +20,7 @@ REGISTER_COMMAND(CarveCommand);
  */
 CarveCommand::CarveCommand(bool reg) : Command(reg, "carve", "Block Carver. (Data blocks | Empty blocks)") {
     m_parser.add_argument("filename").help("VIB/VBK file");
+    m_parser.add_argument("--direct").help("bypass the page cache (O_DIRECT)").default_value(false).implicit_value(true);
 }
 
 /**
@@ -42,7 +43,7 @@ int CarveCommand::run() {
     int64_t offset = 0;
     std::string output = get_out_pathname(fname, "carved_blocks.csv").string();
 
-    if (!carver.OpenInput(fname, offset)) {
+    if (!carver.OpenInput(fname, offset, m_parser.get<bool>("direct") ? Reader::RF_DIRECT : 0)) {
         logger->critical("{}: {}", fname, strerror(errno));
         exit(1);
     }
@@ -0,0 +1,53 @@
+/**
+ * @file CarvedCsvCommand.cpp
+ * @brief Implementation of the CarvedCsvCommand for exporting carved_blocks.bin as csv.
+ *
+ * `scan --blocks` lists the data blocks it finds in the binary carved_blocks.bin,
+ * and with --no-csv only there. This command writes the same rows a scan writes
+ * to carved_blocks.csv, for reading or for tools that expect the text format.
+ */
+
+#include "CarvedCsvCommand.hpp"
+#include "utils/common.hpp"
+#include "data/CarvedLog.hpp"
+
+#include <cstring>
+#include <fstream>
+
+REGISTER_COMMAND(CarvedCsvCommand);
+
+/**
+ * @brief Constructs a CarvedCsvCommand with the specified registration status.
+ * @param reg Boolean indicating whether to register this command with the command registry.
+ */
+CarvedCsvCommand::CarvedCsvCommand(bool reg) : Command(reg, "carved-csv", "export carved_blocks.bin as csv") {
+    m_parser.add_argument("filename").help("carved_blocks.bin of a scan");
+    m_parser.add_argument("output").help("csv file (default: carved_blocks.csv next to it)").default_value(std::string{});
+}
+
+/**
+ * @brief Writes every entry of the log as a csv row.
+ *
+ * @return EXIT_SUCCESS on success.
+ * @throws std::runtime_error If the log can't be read or the csv can't be written.
+ */
+int CarvedCsvCommand::run() {
+    const fs::path fname = m_parser.get("filename");
+    fs::path out_fname = m_parser.get("output");
+    if (out_fname.empty()) {
+        out_fname = fname;
+        out_fname.replace_extension(".csv");
+    }
+
+    std::ofstream out(out_fname, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!out) {
+        throw std::runtime_error(fmt::format("Failed to open output file {}: {}", out_fname.string(), std::strerror(errno)));
+    }
+    const size_t nrows = CarvedLog::export_csv(fname, out);
+    out.close();
+    if (!out) {
+        throw std::runtime_error(fmt::format("Failed to write {}", out_fname.string()));
+    }
+    logger->info("{} blocks written to {}", nrows, out_fname.string());
+    return EXIT_SUCCESS;
+}
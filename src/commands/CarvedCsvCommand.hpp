@@ -0,0 +1,12 @@
+#include "Command.hpp"
+
+class CarvedCsvCommand : public Command {
+public:
+    int run() override;
+
+private:
+    static CarvedCsvCommand instance; // Static instance to trigger registration
+    CarvedCsvCommand(bool reg=false);
+
+    friend class CarvedCsvCommandTest;
+};
@@ -60,6 +60,11 @@ void MDCommand::add_common_args(argparse::ArgumentParser& parser){
         .implicit_value(true)
         .help("go over all PageStacks and try to interpret them as files");
 
+    parser.add_argument("--mmap")
+        .default_value(false)
+        .implicit_value(true)
+        .help("map the backup into memory instead of reading it (healthy local files only, a bad sector kills the process)");
+
     parser.add_argument("-D", "--decompress")
         .default_value(false)
         .implicit_value(true)
@@ -73,7 +78,7 @@ void MDCommand::add_common_args(argparse::ArgumentParser& parser){
         .help("Device for extracting files from carved data.");
     parser.add_argument("--data")
         .append()
-        .help("Carved offset file data.");
+        .help("Carved offset file data (carved_blocks.csv or carved_blocks.bin).");
     parser.add_argument("--skip-read")
         .default_value(false)
         .implicit_value(true)
@@ -130,7 +135,8 @@ CMeta MDCommand::create_meta(const fs::path& fname){
     std::string password = m_parser_ptr->get<std::string>("--password");
     const bool dump_keysets = m_parser_ptr->get<bool>("--dump-keysets");
     const bool session_only = m_parser_ptr->get<bool>("--session");
-    CMeta meta(fname, g_force, m_meta_offset, m_meta_src, password, dump_keysets, m_keysets_same_file, session_only);
+    const bool mmap = m_parser_ptr->get<bool>("--mmap");
+    CMeta meta(fname, g_force, m_meta_offset, m_meta_src, password, dump_keysets, m_keysets_same_file, session_only, mmap);
     if( m_parser_ptr->is_used("--new-version") ){
         meta.set_version(parse_bool(m_parser_ptr->get<std::string>("--new-version")) ? 1 : 0);
     }
@@ -206,7 +212,7 @@ void MDCommand::load_external_hashtable(const fs::path& md_fname) {
             const auto& csv_fname = csv_fnames[i];
             logger->info("exHT: loading {} ...", csv_fname);
 
-            if (m_external_ht.loadFromTextFile(csv_fname, static_cast<uint8_t>(i))){
+            if (m_external_ht.loadFromFile(csv_fname, static_cast<uint8_t>(i))){
                 logger->info("exHT: loaded {} entries from {}", m_external_ht.size(), csv_fname);
             } else {
                 logger->critical("exHT: Error loading {}", csv_fname);
@@ -255,6 +261,9 @@ int MDCommand::extract_file(const fs::path& md_fname, const std::string& xname,
         auto devices = m_parser_ptr->get<std::vector<std::string>>("--device");
         for (const auto& dev : devices) {
             device_files.emplace_back(std::make_unique<Reader>(dev));
+            device_files.back()->advise(Reader::Access::RANDOM); // blocks are read in descriptor order, prefetched by ExtractContext
+            // skip regions an earlier scan of the device found unreadable
+            device_files.back()->set_bad_regions(BadRegionMap::load_if_exists(get_out_pathname(dev, "bad_regions.csv")));
         }
     }
 
@@ -289,6 +298,8 @@ int MDCommand::extract_file(const fs::path& md_fname, const std::string& xname,
     std::unique_ptr<Reader> vbkf;
     if( !vbk_fname.empty()){
         vbkf = std::make_unique<Reader>(vbk_fname);
+        vbkf->advise(Reader::Access::RANDOM);
+        vbkf->set_bad_regions(BadRegionMap::load_if_exists(get_out_pathname(vbk_fname, "bad_regions.csv")));
     }
 
     if( m_parser_ptr->get<bool>("--no-vbk") && !test_only ){
@@ -11,6 +11,8 @@
 #include "Scan2Command.hpp"
 #include "utils/common.hpp"
 #include "scanning/ScannerV2.hpp"
+#include "scanning/ScanCheckpoint.hpp"
+#include <thread>
 
 REGISTER_COMMAND(Scan2Command);
 
@@ -21,14 +23,64 @@ REGISTER_COMMAND(Scan2Command);
 Scan2Command::Scan2Command(bool reg) : Command(reg, "scan", "scan for MD blocks") {
     m_parser.add_argument("filename").help("VIB/VBK file");
     m_parser.add_argument("-s", "--start").help("start offset (hex)").scan<'x', uint64_t>().default_value(uint64_t{0});
+    m_parser.add_argument("-r", "--range").help("scan only start:end (hex, end exclusive, empty end = EOF), for splitting a scan into shards");
 
     auto &arg = m_parser.add_argument("--blocks").help("(or --data) find data blocks").default_value(false).implicit_value(true);
     m_parser.add_argument("--carve").help("carve multiple veeam backups from a disk.").default_value(false).implicit_value(true);
     m_parser.add_argument("--keysets").help("load keysets").default_value(std::string{});
+    m_parser.add_argument("--direct").help("bypass the page cache (O_DIRECT)").default_value(false).implicit_value(true);
+    m_parser.add_argument("--mmap").help("map the source into memory instead of reading it (local image files)").default_value(false).implicit_value(true);
+    m_parser.add_argument("--queue-depth").help("number of concurrent reads per buffer (io_uring on linux)").scan<'i', int>().default_value(1);
+    m_parser.add_argument("--buffers").help("number of read-ahead buffers").scan<'i', int>().default_value(2);
+    m_parser.add_argument("--buffer-size").help("read buffer size in MB").scan<'i', int>().default_value(8);
+    m_parser.add_argument("--no-csv").help("list found data blocks only in carved_blocks.bin, not in carved_blocks.csv (see carved-csv)").default_value(false).implicit_value(true);
+    m_parser.add_argument("--skip-covered").help("rescan only what carved_blocks.map of an earlier --blocks scan doesn't cover, appending to its csv files").default_value(false).implicit_value(true);
+    m_parser.add_argument("--checkpoint").help("save the scan state every N seconds to scan.checkpoint in the output dir (0 = never)").scan<'i', int>().default_value(300);
+    m_parser.add_argument("--resume").help("continue an interrupted scan from its checkpoint (same options, no --start/--range)").default_value(false).implicit_value(true);
+    m_parser.add_argument("-j", "--threads").help("number of threads probing for data blocks (0 = all cores)").scan<'i', int>().default_value(1);
 
     m_parser.add_hidden_alias_for(arg, "--data");
 }
 
+/**
+ * @brief Parses a "start:end" range of hex offsets.
+ *
+ * Both offsets must be page aligned, so that a range scan visits the same pages
+ * as a full scan. An empty end means EOF and is returned as 0.
+ *
+ * @param s Range string, e.g. "0:10000000" or "10000000:".
+ * @return Pair of start and end offsets.
+ * @throws std::invalid_argument If the string is malformed or not page aligned.
+ */
+static std::pair<uint64_t, uint64_t> parse_range(const std::string& s) {
+    const size_t colon = s.find(':');
+    if (colon == std::string::npos) {
+        throw std::invalid_argument(fmt::format("invalid range \"{}\", expected start:end", s));
+    }
+    uint64_t start = 0, end = 0;
+    try {
+        size_t idx = 0;
+        const std::string start_s = s.substr(0, colon), end_s = s.substr(colon + 1);
+        if (!start_s.empty()) {
+            start = std::stoull(start_s, &idx, 16);
+            if (idx != start_s.size()) throw std::invalid_argument(start_s);
+        }
+        if (!end_s.empty()) {
+            end = std::stoull(end_s, &idx, 16);
+            if (idx != end_s.size()) throw std::invalid_argument(end_s);
+        }
+    } catch (const std::exception&) {
+        throw std::invalid_argument(fmt::format("invalid range \"{}\", expected hex start:end", s));
+    }
+    if (start % Veeam::VBK::PAGE_SIZE || end % Veeam::VBK::PAGE_SIZE) {
+        throw std::invalid_argument(fmt::format("range {:#x}:{:#x} is not aligned to {:#x}", start, end, Veeam::VBK::PAGE_SIZE));
+    }
+    if (end && end <= start) {
+        throw std::invalid_argument(fmt::format("range end {:#x} <= start {:#x}", end, start));
+    }
+    return {start, end};
+}
+
 /**
  * @brief Executes the scan command to find metadata and data blocks in a VIB/VBK file.
  *
@@ -45,13 +97,53 @@ int Scan2Command::run() {
     const size_t vbk_size = Reader::get_size(vbk_fname);
     logger->info("source vbk {} ({:x} = {})", vbk_fname, vbk_size, bytes2human(vbk_size));
 
+    uint64_t start = m_parser.get<uint64_t>("start"), end = 0;
+    if (m_parser.present("range")) {
+        if (m_parser.is_used("start")) {
+            throw std::invalid_argument("--start and --range are mutually exclusive");
+        }
+        std::tie(start, end) = parse_range(m_parser.get("range"));
+        logger->info("scanning range {:x}:{:x}", start, end ? end : vbk_size);
+    }
+
+    const bool resume = m_parser.get<bool>("resume");
+    if (resume) {
+        if (m_parser.is_used("start") || m_parser.present("range")) {
+            throw std::invalid_argument("--resume continues where the interrupted scan stopped, --start and --range can't be used with it");
+        }
+        const auto hdr = ScanCheckpoint::load(ScanCheckpoint::pathname(vbk_fname));
+        if (hdr.source_size != vbk_size) {
+            throw std::invalid_argument(fmt::format("the checkpoint was made for a source of {:x} bytes", hdr.source_size));
+        }
+        start = hdr.offset;
+        end = hdr.end;
+    }
+
+    const bool skip_covered = m_parser.get<bool>("skip-covered");
+    if (skip_covered && !std::filesystem::exists(get_out_pathname(vbk_fname, "carved_blocks.map"))) {
+        throw std::invalid_argument("--skip-covered needs carved_blocks.map of an earlier --blocks scan in the output dir");
+    }
+
     ScannerV2 scanner(
         vbk_fname,
-        m_parser.get<uint64_t>("start"),
+        start,
         m_parser.get<bool>("blocks"),
         m_parser.get<bool>("carve"),
-        m_parser.get<std::string>("keysets")
+        m_parser.get<std::string>("keysets"),
+        (m_parser.get<bool>("direct") ? Reader::RF_DIRECT : 0) | (m_parser.get<bool>("mmap") ? Reader::RF_MMAP : 0)
     );
+    scanner.set_end(end);
+    scanner.set_queue_depth(std::max(m_parser.get<int>("queue-depth"), 1));
+    int threads = m_parser.get<int>("threads");
+    if (threads <= 0) {
+        threads = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+    scanner.set_threads(threads);
+    scanner.set_write_csv(!m_parser.get<bool>("no-csv"));
+    scanner.set_skip_covered(skip_covered);
+    scanner.set_checkpoint_interval(std::max(m_parser.get<int>("checkpoint"), 0));
+    scanner.set_resume(resume);
+    scanner.set_buffers(std::max(m_parser.get<int>("buffers"), 2), (size_t)std::max(m_parser.get<int>("buffer-size"), 1) * 1024 * 1024);
     scanner.scan();
     return 0;
 }
@@ -10,4 +10,5 @@ private:
 
     friend class MDCommandTest;
     friend class Scan2CommandTest;
+    friend class ScanMergeCommandTest;
 };
@@ -0,0 +1,285 @@
+/**
+ * @file ScanMergeCommand.cpp
+ * @brief Implementation of the ScanMergeCommand for combining range-sharded scans.
+ *
+ * A large source can be scanned in parts with `scan --range start:end`, each part
+ * writing to its own output dir (-o), possibly on different machines. This command
+ * merges those dirs into the output dir of the source, producing the same layout a
+ * single scan would: csv files and carved_blocks.bin logs are combined in offset order, bitmaps are OR-ed,
+ * mirrored slots are dropped and banks referenced by a slot are written into it
+ * instead of being kept as separate .bank files.
+ */
+
+#include "ScanMergeCommand.hpp"
+#include "utils/common.hpp"
+#include "Veeam/VBK.hpp"
+#include "io/Writer.hpp"
+#include "data/CarvedLog.hpp"
+
+#include <fstream>
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
+
+using namespace Veeam::VBK;
+
+REGISTER_COMMAND(ScanMergeCommand);
+
+/**
+ * @brief Constructs a ScanMergeCommand with the specified registration status.
+ * @param reg Boolean indicating whether to register this command with the command registry.
+ */
+ScanMergeCommand::ScanMergeCommand(bool reg) : Command(reg, "scan-merge", "merge outputs of range-sharded scans") {
+    m_parser.add_argument("filename").help("scanned VIB/VBK file or device, selects the default output dir");
+    m_parser.add_argument("shards")
+        .nargs(argparse::nargs_pattern::at_least_one)
+        .help("output dirs of 'scan --range' runs");
+}
+
+static buf_t read_whole_file(const fs::path& fname) {
+    std::ifstream in(fname, std::ios::binary);
+    if (!in) {
+        throw std::runtime_error(fmt::format("Cannot open {}", fname.string()));
+    }
+    buf_t buf(fs::file_size(fname));
+    in.read((char*)buf.data(), buf.size());
+    return buf;
+}
+
+/**
+ * @brief Concatenates per-shard csv files, sorted by offset (first column).
+ *
+ * Rows reported by more than one shard (overlapping ranges) are written once.
+ *
+ * @param shards Shard output dirs.
+ * @param name Csv file name inside each dir.
+ * @param out_fname Merged csv pathname.
+ * @return Number of rows written.
+ */
+static size_t merge_csv(const std::vector<fs::path>& shards, const std::string& name, const fs::path& out_fname) {
+    std::vector<std::pair<uint64_t, std::string>> rows;
+    bool found = false;
+    for (const auto& shard : shards) {
+        std::ifstream in(shard / name, std::ios::binary);
+        if (!in) {
+            continue;
+        }
+        found = true;
+        std::string line;
+        while (std::getline(in, line)) {
+            if (line.empty()) {
+                continue;
+            }
+            try {
+                rows.emplace_back(std::stoull(line.substr(0, line.find(';')), nullptr, 16), line);
+            } catch (const std::exception&) {
+                logger->warn("{}: skipping malformed line \"{}\"", (shard / name).string(), line);
+            }
+        }
+    }
+    if (!found) {
+        return 0;
+    }
+
+    std::sort(rows.begin(), rows.end());
+    rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+
+    std::ofstream out(out_fname, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!out) {
+        throw std::runtime_error(fmt::format("Failed to open output file {}: {}", out_fname.string(), std::strerror(errno)));
+    }
+    for (const auto& [offset, line] : rows) {
+        out << line << '\n';
+    }
+    return rows.size();
+}
+
+/**
+ * @brief Concatenates per-shard carved_blocks.bin logs, sorted by offset.
+ *
+ * Entries reported by more than one shard (overlapping ranges) are written once.
+ *
+ * @param shards Shard output dirs.
+ * @param out_fname Merged log pathname.
+ * @return Number of entries written.
+ * @throws std::runtime_error If a shard's log is not a carved blocks log.
+ */
+static size_t merge_logs(const std::vector<fs::path>& shards, const fs::path& out_fname) {
+    std::vector<HashEntry> entries;
+    bool found = false;
+    for (const auto& shard : shards) {
+        const fs::path fname = shard / CarvedLog::FNAME;
+        if (!fs::exists(fname)) {
+            continue;
+        }
+        if (!CarvedLog::is_log(fname)) {
+            throw std::runtime_error(fmt::format("{} is not a carved blocks log", fname.string()));
+        }
+        found = true;
+        const buf_t buf = read_whole_file(fname);
+        const size_t n = (buf.size() - sizeof(CarvedLogHeader)) / sizeof(HashEntry);
+        const HashEntry* begin = reinterpret_cast<const HashEntry*>(buf.data() + sizeof(CarvedLogHeader));
+        entries.insert(entries.end(), begin, begin + n);
+    }
+    if (!found) {
+        return 0;
+    }
+
+    std::stable_sort(entries.begin(), entries.end(), [](const HashEntry& a, const HashEntry& b) { return a.offset < b.offset; });
+    entries.erase(std::unique(entries.begin(), entries.end(), [](const HashEntry& a, const HashEntry& b) {
+        return memcmp(&a, &b, sizeof(HashEntry)) == 0;
+    }), entries.end());
+
+    CarvedLog log(out_fname, false);
+    log.append(entries);
+    return entries.size();
+}
+
+/**
+ * @brief ORs per-shard carved_blocks.map bitmaps together.
+ *
+ * Every shard maps the whole source, so the bitmaps are normally the same size.
+ *
+ * @param shards Shard output dirs.
+ * @param out_fname Merged bitmap pathname.
+ */
+static void merge_bitmaps(const std::vector<fs::path>& shards, const fs::path& out_fname) {
+    buf_t merged;
+    for (const auto& shard : shards) {
+        const fs::path fname = shard / "carved_blocks.map";
+        if (!fs::exists(fname)) {
+            continue;
+        }
+        const buf_t bitmap = read_whole_file(fname);
+        if (!merged.empty() && merged.size() != bitmap.size()) {
+            logger->warn("{}: bitmap size {:x} differs from {:x}, were the shards scanned from the same source?", fname.string(), bitmap.size(), merged.size());
+        }
+        if (bitmap.size() > merged.size()) {
+            merged.resize(bitmap.size());
+        }
+        for (size_t i = 0; i < bitmap.size(); i++) {
+            merged[i] |= bitmap[i];
+        }
+    }
+    if (!merged.empty()) {
+        Writer(out_fname).write(merged.data(), merged.size());
+    }
+}
+
+/**
+ * @brief Merges the outputs of range-sharded scans into one output dir.
+ *
+ * Slots are deduplicated by fingerprint the same way the scanner does it, keeping
+ * the one with the lowest offset. Banks whose (crc, size) is referenced by a kept
+ * slot are written into that slot at the referenced offset, all other banks are
+ * copied as they are.
+ *
+ * @return EXIT_SUCCESS (0) on success.
+ * @throws std::invalid_argument If a shard dir does not exist or is the output dir.
+ */
+int ScanMergeCommand::run() {
+    const std::string fname = m_parser.get("filename");
+    init_log(fname);
+
+    const fs::path out_dir = get_out_dir(fname);
+    std::vector<fs::path> shards;
+    for (const auto& s : m_parser.get<std::vector<std::string>>("shards")) {
+        if (!fs::is_directory(s)) {
+            throw std::invalid_argument(fmt::format("shard dir {} does not exist", s));
+        }
+        if (fs::equivalent(s, out_dir)) {
+            throw std::invalid_argument(fmt::format("shard dir {} is the output dir", s));
+        }
+        shards.emplace_back(s);
+    }
+    logger->info("merging {} shards into {}", shards.size(), out_dir.string());
+
+    const size_t nlogged = merge_logs(shards, get_out_pathname(fname, CarvedLog::FNAME));
+    const size_t nblocks = std::max(merge_csv(shards, "carved_blocks.csv", get_out_pathname(fname, "carved_blocks.csv")), nlogged);
+    const size_t nbad = merge_csv(shards, "bad_blocks.csv", get_out_pathname(fname, "bad_blocks.csv"));
+    merge_bitmaps(shards, get_out_pathname(fname, "carved_blocks.map"));
+
+    std::map<uint64_t, buf_t> slots;           // offset => .slot contents
+    std::map<uint64_t, fs::path> banks;        // (crc << 32 | size) => .bank pathname
+    std::vector<fs::path> reconstructed;
+    for (const auto& shard : shards) {
+        for (const auto& entry : fs::directory_iterator(shard)) {
+            const fs::path& path = entry.path();
+            const std::string name = path.filename().string();
+            if (name == "reconstructed_slot.slot") {
+                reconstructed.push_back(path);
+            } else if (path.extension() == ".slot") {
+                try {
+                    slots.try_emplace(std::stoull(path.stem().string(), nullptr, 16), read_whole_file(path));
+                } catch (const std::invalid_argument&) {
+                    logger->warn("{}: unexpected slot file name, skipped", path.string());
+                }
+            } else if (path.extension() == ".bank") {
+                uint32_t crc = 0, size = 0;
+                if (sscanf(name.c_str(), "_%08x_%08x.bank", &crc, &size) == 2) {
+                    banks.try_emplace(((uint64_t)crc << 32) | size, path);
+                }
+            }
+        }
+    }
+
+    std::unordered_map<uint64_t, uint64_t> seen_fingerprints;
+    std::unordered_set<uint64_t> used_banks;
+    size_t nslots = 0;
+    for (auto& [slot_offset, data] : slots) {
+        const CSlot* slot = (const CSlot*)data.data();
+        if (data.size() < sizeof(CSlot) || !slot->valid_fast() || data.size() < slot->size()) {
+            logger->warn("{:012x}.slot: invalid slot header, copied as is", slot_offset);
+            Writer(get_out_pathname(fname, fmt::format("{:012x}.slot", slot_offset))).write(data.data(), data.size());
+            continue;
+        }
+
+        const auto [it, inserted] = seen_fingerprints.try_emplace(slot->fingerprint(), slot_offset);
+        if (!inserted) {
+            logger->info("Skipping duplicate slot at {:012x} (identical to {:012x})", slot_offset, it->second);
+            continue;
+        }
+
+        // copy BankInfos, data may be reallocated below
+        std::vector<CSlot::BankInfo> infos(slot->bankInfos, slot->bankInfos + slot->allocated_banks);
+        for (const auto& bi : infos) {
+            auto bank_it = banks.find(((uint64_t)bi.crc << 32) | bi.size);
+            if (bi.size == 0 || bi.offset < 0 || bank_it == banks.end()) {
+                continue;
+            }
+            const buf_t bank = read_whole_file(bank_it->second);
+            if (data.size() < (size_t)bi.offset + bank.size()) {
+                data.resize(bi.offset + bank.size());
+            }
+            if (memcmp(data.data() + bi.offset, bank.data(), bank.size()) != 0) {
+                logger->debug("{:012x}.slot: adding bank {} @ {:x}", slot_offset, bank_it->second.filename().string(), bi.offset);
+                memcpy(data.data() + bi.offset, bank.data(), bank.size());
+            }
+            used_banks.insert(bank_it->first);
+        }
+        Writer(get_out_pathname(fname, fmt::format("{:012x}.slot", slot_offset))).write(data.data(), data.size());
+        nslots++;
+    }
+
+    for (const auto& [bank_id, path] : banks) {
+        if (!used_banks.count(bank_id)) {
+            fs::copy_file(path, get_out_pathname(fname, path.filename().string()), fs::copy_options::overwrite_existing);
+        }
+    }
+
+    if (!reconstructed.empty()) {
+        if (nslots > 0) {
+            logger->info("real slots found, ignoring {} reconstructed slot(s)", reconstructed.size());
+        } else if (reconstructed.size() == 1) {
+            fs::copy_file(reconstructed[0], get_out_pathname(fname, "reconstructed_slot.slot"), fs::copy_options::overwrite_existing);
+        } else {
+            logger->warn("{} shards built their own reconstructed slot from partial bank sets, they are not merged", reconstructed.size());
+        }
+    }
+
+    logger->info("merged: {} data blocks, {} bad blocks, {} slots, {} banks ({} merged into slots)",
+        nblocks, nbad, nslots, banks.size() - used_banks.size(), used_banks.size());
+    return 0;
+}
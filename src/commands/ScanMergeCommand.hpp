@@ -0,0 +1,12 @@
+#include "Command.hpp"
+
+class ScanMergeCommand : public Command {
+public:
+    int run() override;
+
+private:
+    static ScanMergeCommand instance; // Static instance to trigger registration
+    ScanMergeCommand(bool reg=false);
+
+    friend class ScanMergeCommandTest;
+};
@@ -63,7 +63,8 @@ int VBKCommand::run() {
     const size_t vbk_size = Reader::get_size(vbk_fname);
     logger->info("source vbk {} ({:x} = {})", vbk_fname, vbk_size, bytes2human(vbk_size));
 
-    Reader reader(vbk_fname);
+    // a bad sector in a mapped file is a SIGBUS, not a read error: map only when asked to
+    Reader reader(vbk_fname, m_parser.get<bool>("--mmap") ? Reader::RF_MMAP : 0);
     const uint64_t offset = m_parser.get<uint64_t>("--offset");
 
     buf_t hdr_buf(PAGE_SIZE);
@@ -91,8 +92,8 @@ int VBKCommand::run() {
     }
 
     std::map<size_t, std::vector<bool>> slots_map; // offset -> [valid banks]
-    buf_t slot_buf(slot_size);
-    buf_t bank_buf;
+    pooled_buf_t slot_buf; // only used when the reader is not mapped
+    pooled_buf_t bank_buf;
     size_t tail_offset = 0;
     size_t storage_eof = 0;
     for( size_t slot_idx=0; slot_idx<MAX_SLOTS; slot_idx++ ) {
@@ -101,10 +102,10 @@ int VBKCommand::run() {
         }
         logger->info("");
         size_t slot_offset = offset + PAGE_SIZE + slot_idx * slot_size;
-        reader.read_at(slot_offset, slot_buf.data(), slot_size);
-        CSlot* slot = (CSlot*)slot_buf.data();
+        auto slot_view = reader.view(slot_offset, slot_size, slot_buf);
+        const CSlot* slot = (const CSlot*)slot_view.data();
 
-        logger->trace("slot[{}]: {}", slot_idx, to_hexdump(slot_buf));
+        logger->trace("slot[{}]: {}", slot_idx, to_hexdump(slot_view.data(), slot_view.size()));
         bool valid = slot->size() <= slot_size && slot->valid_fast() && slot->valid_crc();
         const char* color = valid ? ANSI_COLOR_GREEN : ANSI_COLOR_RED;
         logger->info("{:08x}: slot[{}]: {}{}{}", slot_offset, slot_idx, color, slot->to_string(), ANSI_COLOR_RESET);
@@ -122,8 +123,7 @@ int VBKCommand::run() {
         }
         for(uint32_t i=0; i<slot->allocated_banks; i++){
             const CSlot::BankInfo& bi = slot->bankInfos[i];
-            bank_buf.resize(bi.size);
-            reader.read_at(offset+bi.offset, bank_buf.data(), bi.size);
+            const CBank* bank = (const CBank*)reader.view(offset+bi.offset, bi.size, bank_buf).data();
             if( offset + bi.offset + bi.size > tail_offset ){
                 tail_offset = offset + bi.offset + bi.size;
             }
@@ -138,7 +138,6 @@ int VBKCommand::run() {
 //                }
 //            }
 
-            CBank* bank = (CBank*)bank_buf.data();
             color = ANSI_COLOR_RED;
             const size_t actual_size = bank->size();
             const uint32_t actual_crc = vcrc32(0, bank, bi.size);
@@ -0,0 +1,297 @@
+/**
+ * @file BufferPool.cpp
+ * @brief Implementation of the aligned buffer pool and pooled_buf_t.
+ *
+ * Scanners and readers allocate the same large buffers over and over. The pool
+ * keeps released blocks around (up to a fixed limit) and hands them out again
+ * without touching their contents, so there is neither an allocation nor a
+ * zero-fill per use. All blocks are aligned, which O_DIRECT reads require.
+ *
+ * Big buffers that are scanned byte by byte for the whole run can be backed by
+ * huge pages: with 4K pages a 64 MB buffer spans 16384 TLB entries, with 2M
+ * pages only 32.
+ */
+
+#include "BufferPool.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <new>
+#include <string>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+static void* aligned_malloc(size_t size, size_t align) {
+#ifdef _WIN32
+    return _aligned_malloc(size, align);
+#else
+    void* ptr = nullptr;
+    if (posix_memalign(&ptr, align, size) != 0) {
+        return nullptr;
+    }
+    return ptr;
+#endif
+}
+
+static void aligned_free(void* ptr) {
+#ifdef _WIN32
+    _aligned_free(ptr);
+#else
+    ::free(ptr);
+#endif
+}
+
+const char* page_mode_name(PageMode mode) {
+    switch (mode) {
+        case PageMode::TRANSPARENT: return "transparent huge pages";
+        case PageMode::HUGETLB:     return "hugetlb pages";
+        default:                    return "normal pages";
+    }
+}
+
+#ifdef __linux__
+// THP is usable unless disabled ("always [madvise] never" => enabled)
+static bool thp_enabled() {
+    static const bool enabled = [] {
+        std::ifstream f("/sys/kernel/mm/transparent_hugepage/enabled");
+        std::string line;
+        return std::getline(f, line) && line.find("[never]") == std::string::npos;
+    }();
+    return enabled;
+}
+#endif
+
+/**
+ * @brief Returns the process-wide pool.
+ *
+ * The pool is intentionally never destroyed, so buffers released during static
+ * destruction still have a valid pool to return to.
+ */
+BufferPool& BufferPool::instance() {
+    static BufferPool* pool = new BufferPool();
+    return *pool;
+}
+
+/**
+ * @brief Rounds a block size up to its size class.
+ *
+ * From MIN_CLASS up there are 4 classes per power of two (64K, 80K, 96K, 112K,
+ * 128K, 160K, ...), so at most a quarter of a block is wasted, and e.g. per-block
+ * decompression buffers whose size varies slightly from block to block keep
+ * reusing the same cached blocks. Smaller sizes are only aligned.
+ *
+ * @param size Requested size in bytes.
+ * @param align Alignment, must be a power of two.
+ * @return Class size, a multiple of align.
+ */
+size_t BufferPool::size_class(size_t size, size_t align) {
+    if (size > MIN_CLASS) {
+        const size_t step = std::bit_floor(size) / 4;
+        size = (size + step - 1) & ~(step - 1);
+    }
+    return (size + align - 1) & ~(align - 1);
+}
+
+/**
+ * @brief Allocates an aligned block, reusing a cached one when available.
+ *
+ * @param size Block size in bytes.
+ * @param align Required alignment, must be a power of two.
+ * @param huge Try to back the block with huge pages.
+ * @param[out] mode If not null, receives what actually backs the block.
+ * @return Pointer to uninitialized memory.
+ * @throws std::bad_alloc If the allocation fails.
+ */
+void* BufferPool::alloc(size_t size, size_t align, bool huge, PageMode* mode) {
+    PageMode actual = PageMode::NORMAL;
+    void* ptr = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_free.find({size, align, huge});
+        if (it != m_free.end()) {
+            std::tie(ptr, actual) = it->second;
+            m_free.erase(it);
+            m_cached -= size;
+        }
+    }
+
+    if (!ptr) {
+        ptr = huge ? alloc_huge(size, align, actual) : aligned_malloc(size, align);
+    }
+    if (!ptr) {
+        throw std::bad_alloc();
+    }
+    if (mode) {
+        *mode = actual;
+    }
+    return ptr;
+}
+
+/**
+ * @brief Allocates a block backed by huge pages, falling back to normal pages.
+ *
+ * Transparent huge pages are preferred: they need no setup and don't take pages
+ * reserved for other applications. The reserved hugetlb pool is used only when
+ * THP is disabled. Elsewhere than on Linux this is a normal allocation.
+ *
+ * @param size Block size in bytes.
+ * @param align Required alignment.
+ * @param[out] mode What backs the returned block.
+ * @return Pointer to uninitialized memory, nullptr on failure.
+ */
+void* BufferPool::alloc_huge(size_t size, size_t align, PageMode& mode) {
+    mode = PageMode::NORMAL;
+#ifdef __linux__
+    if (thp_enabled()) {
+        void* ptr = aligned_malloc(size, std::max(align, HUGE_PAGE_SIZE));
+        if (ptr && madvise(ptr, size, MADV_HUGEPAGE) == 0) {
+            mode = PageMode::TRANSPARENT;
+        }
+        return ptr;
+    }
+    if (size % HUGE_PAGE_SIZE == 0 && align <= HUGE_PAGE_SIZE) {
+        void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (ptr != MAP_FAILED) {
+            mode = PageMode::HUGETLB;
+            return ptr;
+        }
+    }
+#endif
+    return aligned_malloc(size, align);
+}
+
+void BufferPool::release_block(void* ptr, size_t size, PageMode mode) {
+#ifdef __linux__
+    if (mode == PageMode::HUGETLB) {
+        munmap(ptr, size);
+        return;
+    }
+#endif
+    aligned_free(ptr);
+}
+
+/**
+ * @brief Returns a block to the pool, or frees it when the cache is full.
+ *
+ * @param ptr Block obtained from alloc().
+ * @param size Size passed to alloc().
+ * @param align Alignment passed to alloc().
+ * @param huge Huge flag passed to alloc().
+ * @param mode Page mode returned by alloc().
+ */
+void BufferPool::free(void* ptr, size_t size, size_t align, bool huge, PageMode mode) {
+    if (!ptr) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_cached + size <= MAX_CACHED) {
+            m_free.emplace(std::make_tuple(size, align, huge), std::make_pair(ptr, mode));
+            m_cached += size;
+            return;
+        }
+    }
+    release_block(ptr, size, mode);
+}
+
+/**
+ * @brief Frees all cached blocks.
+ */
+void BufferPool::trim() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto& [key, block] : m_free) {
+        release_block(block.first, std::get<0>(key), block.second);
+    }
+    m_free.clear();
+    m_cached = 0;
+}
+
+/**
+ * @brief Returns the total size of the cached blocks.
+ */
+size_t BufferPool::cached_bytes() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_cached;
+}
+
+/**
+ * @brief Allocates an uninitialized aligned buffer from the pool.
+ *
+ * @param size Buffer size in bytes.
+ * @param align Alignment of the buffer start, must be a power of two.
+ * @param huge Back the buffer with huge pages if possible, see page_mode().
+ */
+pooled_buf_t::pooled_buf_t(size_t size, size_t align, bool huge) : m_align(align), m_huge(huge) {
+    resize(size);
+}
+
+pooled_buf_t::~pooled_buf_t() {
+    release();
+}
+
+pooled_buf_t::pooled_buf_t(pooled_buf_t&& other) noexcept
+    : m_data(other.m_data), m_size(other.m_size), m_capacity(other.m_capacity), m_align(other.m_align), m_huge(other.m_huge), m_mode(other.m_mode) {
+    other.m_data = nullptr;
+    other.m_size = other.m_capacity = 0;
+}
+
+pooled_buf_t& pooled_buf_t::operator=(pooled_buf_t&& other) noexcept {
+    if (this != &other) {
+        release();
+        m_data = other.m_data;
+        m_size = other.m_size;
+        m_capacity = other.m_capacity;
+        m_align = other.m_align;
+        m_huge = other.m_huge;
+        m_mode = other.m_mode;
+        other.m_data = nullptr;
+        other.m_size = other.m_capacity = 0;
+    }
+    return *this;
+}
+
+/**
+ * @brief Changes the buffer size without initializing new bytes.
+ *
+ * Shrinking and growing within capacity only adjusts the size. Growing beyond
+ * capacity takes a block of the matching size class from the pool and copies
+ * the old contents.
+ *
+ * @param size New size in bytes.
+ */
+void pooled_buf_t::resize(size_t size) {
+    if (size <= m_capacity) {
+        m_size = size;
+        return;
+    }
+
+    size_t capacity = m_huge
+        ? (size + BufferPool::HUGE_PAGE_SIZE - 1) & ~(BufferPool::HUGE_PAGE_SIZE - 1)
+        : BufferPool::size_class(size, m_align);
+    PageMode mode = PageMode::NORMAL;
+    uint8_t* data = static_cast<uint8_t*>(BufferPool::instance().alloc(capacity, m_align, m_huge, &mode));
+    if (m_data) {
+        memcpy(data, m_data, m_size);
+        release();
+    }
+    m_data = data;
+    m_size = size;
+    m_capacity = capacity;
+    m_mode = mode;
+}
+
+/**
+ * @brief Returns the memory block to the pool.
+ */
+void pooled_buf_t::release() {
+    if (m_data) {
+        BufferPool::instance().free(m_data, m_capacity, m_align, m_huge, m_mode);
+        m_data = nullptr;
+    }
+    m_size = m_capacity = 0;
+}
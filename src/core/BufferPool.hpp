@@ -0,0 +1,100 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <utility>
+
+// what backs a block requested with huge pages
+enum class PageMode : uint8_t {
+    NORMAL,         // huge pages not available, regular 4K pages
+    TRANSPARENT,    // 2M-aligned and madvise(MADV_HUGEPAGE), the kernel backs it with THP when it can
+    HUGETLB,        // mmap(MAP_HUGETLB) from the reserved huge page pool
+};
+
+const char* page_mode_name(PageMode mode);
+
+// process-wide cache of aligned memory blocks
+// big I/O buffers are allocated once and recycled, instead of being zero-filled by std::vector on every use
+// big blocks are rounded up to size classes (4 per power of two), so buffers of varying size share cached blocks
+class BufferPool {
+    public:
+    static BufferPool& instance();
+
+    static constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+    // smallest class >= size, a multiple of align
+    static size_t size_class(size_t size, size_t align);
+
+    // returned memory is NOT initialized
+    // huge: back the block with huge pages if possible, size should then be a multiple of HUGE_PAGE_SIZE
+    void* alloc(size_t size, size_t align, bool huge = false, PageMode* mode = nullptr);
+    void free(void* ptr, size_t size, size_t align, bool huge = false, PageMode mode = PageMode::NORMAL);
+
+    // release all cached blocks
+    void trim();
+    size_t cached_bytes() const;
+
+    private:
+    BufferPool() = default;
+
+    mutable std::mutex m_mutex;
+    std::multimap<std::tuple<size_t, size_t, bool>, std::pair<void*, PageMode>> m_free; // (size, align, huge) => block
+    size_t m_cached = 0;
+
+    void* alloc_huge(size_t size, size_t align, PageMode& mode);
+    static void release_block(void* ptr, size_t size, PageMode mode);
+
+    static constexpr size_t MAX_CACHED = 512 * 1024 * 1024;
+    static constexpr size_t MIN_CLASS = 64 * 1024; // smaller blocks are only rounded up to the alignment
+
+};
+
+// aligned, uninitialized buffer backed by BufferPool
+// suitable for O_DIRECT reads when align is a multiple of the sector size
+// use instead of buf_t for scratch buffers that are overwritten anyway, buf_t zero-fills on every resize
+class pooled_buf_t {
+    public:
+    static constexpr size_t DEFAULT_ALIGN = 4096;
+
+    pooled_buf_t() = default;
+    // huge: for big long-lived buffers scanned byte by byte, less TLB misses; falls back to normal pages
+    explicit pooled_buf_t(size_t size, size_t align = DEFAULT_ALIGN, bool huge = false);
+    ~pooled_buf_t();
+
+    pooled_buf_t(const pooled_buf_t&) = delete;
+    pooled_buf_t& operator=(const pooled_buf_t&) = delete;
+    pooled_buf_t(pooled_buf_t&& other) noexcept;
+    pooled_buf_t& operator=(pooled_buf_t&& other) noexcept;
+
+    uint8_t* data() { return m_data; }
+    const uint8_t* data() const { return m_data; }
+    size_t size() const { return m_size; }
+    size_t capacity() const { return m_capacity; }
+    size_t alignment() const { return m_align; }
+    PageMode page_mode() const { return m_mode; }
+    bool empty() const { return m_size == 0; }
+
+    uint8_t& operator[](size_t i) { return m_data[i]; }
+    const uint8_t& operator[](size_t i) const { return m_data[i]; }
+
+    uint8_t* begin() { return m_data; }
+    uint8_t* end() { return m_data + m_size; }
+    const uint8_t* begin() const { return m_data; }
+    const uint8_t* end() const { return m_data + m_size; }
+
+    // keeps existing contents, new bytes are NOT initialized
+    void resize(size_t size);
+    void clear() { m_size = 0; }
+
+    private:
+    void release();
+
+    uint8_t* m_data = nullptr;
+    size_t m_size = 0;
+    size_t m_capacity = 0;
+    size_t m_align = DEFAULT_ALIGN;
+    bool m_huge = false;
+    PageMode m_mode = PageMode::NORMAL;
+};
@@ -27,7 +27,7 @@ namespace fs = std::filesystem;
 
 extern std::shared_ptr<Logger> logger;
 
-bool vObtainMetaID(buf_t& meta, uint32_t& metaID);
+bool vObtainMetaID(std::span<const uint8_t> meta, uint32_t& metaID);
 
 
 /**
@@ -41,8 +41,9 @@ bool vObtainMetaID(buf_t& meta, uint32_t& metaID);
  * @param ignore_errors If true, continue processing despite validation errors.
  * @param offset File offset where metadata begins (for embedded metadata).
  * @param meta_src Metadata source type (MS_AUTO for auto-detection).
+ * @param mmap If true, the source is memory-mapped instead of read (a bad sector is then a SIGBUS).
  */
-CMeta::CMeta(const std::filesystem::path& fname, bool ignore_errors, off_t offset, EMetaSource meta_src, const std::string& password, bool dump_keysets, std::optional<std::filesystem::path> keysets_same_file, bool dump_session_only){
+CMeta::CMeta(const std::filesystem::path& fname, bool ignore_errors, off_t offset, EMetaSource meta_src, const std::string& password, bool dump_keysets, std::optional<std::filesystem::path> keysets_same_file, bool dump_session_only, bool mmap){
     m_ignore_errors = ignore_errors;
     m_password = password;
     m_dump_keysets = dump_keysets;
@@ -50,7 +51,10 @@ CMeta::CMeta(const std::filesystem::path& fname, bool ignore_errors, off_t offse
     m_source_path = fname;
     m_keysets_same_file = std::move(keysets_same_file);
 
-    Reader reader(fname);
+    // a bad sector in a mapped file is a SIGBUS, not a read error: map only when asked to (--mmap)
+    Reader reader(fname, mmap ? Reader::RF_MMAP : 0);
+    // pages are followed by id all over the file and revisited, keep them cached without readahead
+    reader.advise(Reader::Access::RANDOM);
 
     if( meta_src == MS_AUTO ){
         if( fname.extension() == ".slot" )
@@ -91,10 +95,10 @@ void CMeta::import_bank(Reader& reader, const off_t offset) {
     size_t bank_size = reader.size() - offset;
     buf_t buf( bank_size );
     reader.read_at( offset, buf );
-    m_banks.push_back(buf);
+    m_banks.push_back(std::move(buf));
 
     int i = m_banks.size() - 1;
-    CBank* bank = (CBank*)buf.data();
+    CBank* bank = (CBank*)m_banks.back().data();
     int valid_fast = bank->valid_fast();
     int valid_slow = bank->valid_slow(bank_size);
     logger->debug("{}Bank[{}]: {} valid_fast={} valid_slow={}{}", (valid_fast && valid_slow) ? ANSI_COLOR_GREEN : ANSI_COLOR_RED,i, bank->to_string(), valid_fast, valid_slow, ANSI_COLOR_RESET);
@@ -117,21 +121,20 @@ void CMeta::import_bank(Reader& reader, const off_t offset) {
  */
 void CMeta::import_slot(Reader& reader, const off_t offset) {
     logger->debug("MetaData is from Slot");
-    buf_t buf( PAGE_SIZE );
-    if (reader.read_at(offset, buf) != PAGE_SIZE) {
+    buf_t buf;
+    if ((size_t)offset + PAGE_SIZE > reader.size()) {
         throw std::runtime_error("Failed to read Slot page 0");
     }
-    CSlot* slot = (CSlot*)buf.data();
+    const CSlot* slot = (const CSlot*)reader.view(offset, PAGE_SIZE, buf).data();
     logger->trace("loading {}", slot->to_string());
     if( slot->size() < PAGE_SIZE ){
         throw std::runtime_error(fmt::format("Invalid Slot size: {:#x}", slot->size()));
     }
-    buf.resize(slot->size()); // resize() may invalidate slot pointer
-    slot = (CSlot*)buf.data();
-    size_t to_read = slot->size() - PAGE_SIZE;
-    if (reader.read_at(offset + PAGE_SIZE, buf.data()+PAGE_SIZE, to_read) != to_read) {
+    if ((size_t)offset + slot->size() > reader.size()) {
         throw std::runtime_error("Failed to read Slot page 1+");
     }
+    // in place when the reader is mapped, slot pointer from page 0 view is invalid now
+    slot = (const CSlot*)reader.view(offset, slot->size(), buf).data();
 
     int valid_fast = slot->valid_fast();
     int valid_crc = slot->valid_crc();
@@ -626,7 +629,7 @@ void CMeta::import_legacy(Reader& reader, const off_t offset) {
 
         if( TOCMark ){
             logger->debug("Loading Bank {:04x} Size {:6x} @ {:8x}", m_banks.size(), curBankSize, pos);
-            m_banks.push_back(buf);
+            m_banks.push_back(std::move(buf));
         } else {
             uint32_t pd = 0;
             vObtainMetaID(buf, pd);
@@ -634,8 +637,9 @@ void CMeta::import_legacy(Reader& reader, const off_t offset) {
             if( m_banks.size() <= pd ){
                 m_banks.resize(pd+1);
             }
-            m_banks[pd] = buf;
+            m_banks[pd] = std::move(buf);
         }
+        buf = buf_t(); // moved-from
     }
 }
 
@@ -101,7 +101,7 @@ class CMeta {
         }
     };
 
-    CMeta(const std::filesystem::path& fname, bool ignore_errors=false, off_t offset=0, EMetaSource meta_src=MS_AUTO, const std::string& password="", bool dump_keysets=false, std::optional<std::filesystem::path> keysets_same_file = std::nullopt, bool dump_session_only=false);
+    CMeta(const std::filesystem::path& fname, bool ignore_errors=false, off_t offset=0, EMetaSource meta_src=MS_AUTO, const std::string& password="", bool dump_keysets=false, std::optional<std::filesystem::path> keysets_same_file = std::nullopt, bool dump_session_only=false, bool mmap=false);
 
     // if ignore_errors is true  => just log error message
     // if ignore_errors is false => throw std::runtime_error
@@ -3,6 +3,8 @@
 #include <fstream>
 #include <mio/mmap.hpp>
 #include <cstdint>
+#include <cstring>
+#include <system_error>
 
 class BitFileMappedArray {
     size_t m_bit_size;
@@ -42,7 +44,7 @@ public:
             m_mmap[byte] &= ~(1 << bit);
     }
 
-    // sets all bits in range to 1
+    // sets all bits in range [start, end) to 1
     void set_range(size_t start, size_t end) {
         if (start >= m_bit_size || end > m_bit_size || start >= end)
             throw std::out_of_range("Invalid bit range: " + std::to_string(start) + " to " + std::to_string(end) + 
@@ -51,33 +53,50 @@ public:
         size_t start_byte = start / 8;
         size_t end_byte = (end - 1) / 8;
 
-        size_t start_bit = 7 - start % 8;
-        size_t end_bit = 7 - ((end - 1) % 8);
+        // index 0 is the most significant bit of a byte, see get()
+        uint8_t head = 0xFFu >> (start % 8);
+        uint8_t tail = 0xFFu << (7 - (end - 1) % 8);
 
         uint8_t* ptr = data();
 
-        // --- Case 1: Same byte
         if (start_byte == end_byte) {
-            uint8_t mask = ((1u << (end_bit - start_bit + 1)) - 1) << start_bit;
-            ptr[start_byte] |= mask;
+            ptr[start_byte] |= head & tail;
             return;
         }
+        ptr[start_byte] |= head;
+        for (size_t i = start_byte + 1; i < end_byte; ++i)
+            ptr[i] = 0xFF;
+        ptr[end_byte] |= tail;
+    }
 
-        // --- Case 2: First (partial) byte
-        if (start_bit != 0) {
-            uint8_t mask = 0xFFu << start_bit;
-            ptr[start_byte++] |= mask;
+    // index of the first bit equal to value at or after from, size_bits() if there is none
+    // runs of whole bytes are skipped 8 at a time, so long covered/uncovered runs cost little
+    size_t find_first(bool value, size_t from) const {
+        size_t i = from;
+        for (; i < m_bit_size && i % 8; i++) {
+            if (get(i) == value) return i;
+        }
+        if (i >= m_bit_size) {
+            return m_bit_size;
         }
 
-        // --- Case 3: Full middle bytes
-        for (size_t i = start_byte; i < end_byte; ++i)
-            ptr[i] = 0xFF;
-
-        // --- Case 4: Last (partial) byte
-        if ((end_bit + 1) != 0) {
-            uint8_t mask = (1u << (end_bit + 1)) - 1;
-            ptr[end_byte] |= mask;
+        const uint8_t* p = data();
+        const size_t nbytes = m_bit_size / 8; // whole bytes, a partial last one is checked bit by bit
+        const uint8_t skip = value ? 0x00 : 0xFF;
+        const uint64_t skip64 = value ? 0 : ~0ULL;
+        size_t byte = i / 8;
+        for (uint64_t w; byte + sizeof(w) <= nbytes; byte += sizeof(w)) {
+            memcpy(&w, p + byte, sizeof(w));
+            if (w != skip64) break;
+        }
+        while (byte < nbytes && p[byte] == skip) {
+            byte++;
         }
+        // the match is in this byte, or in the partial last one
+        for (i = byte * 8; i < m_bit_size; i++) {
+            if (get(i) == value) return i;
+        }
+        return m_bit_size;
     }
 
     uint8_t* data() { return reinterpret_cast<uint8_t*>(m_mmap.data()); }
@@ -86,6 +105,11 @@ public:
     size_t size_bits() const { return m_bit_size; }
     size_t size_bytes() const { return (m_bit_size+7) / 8; }
 
-    // void flush() { m_mmap.sync(mio::sync_type::sync); }
+    // writes dirty pages to disk and waits for it
+    void flush() {
+        std::error_code error;
+        m_mmap.sync(error);
+        if (error) throw std::system_error(error, "BitFileMappedArray: msync");
+    }
 };
 
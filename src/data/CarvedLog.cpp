@@ -0,0 +1,108 @@
+/**
+ * @file CarvedLog.cpp
+ * @brief Binary log of the data blocks found by `scan --blocks`.
+ *
+ * carved_blocks.csv costs a fmt::format() per block while scanning and a
+ * getline/split/parse per block when `md --data` loads it into the hash
+ * table. With hundreds of millions of blocks that text round trip takes
+ * hours and tens of GB. The binary log stores the HashEntry the hash table
+ * needs, so loading it is a copy of the mapped file followed by the sort.
+ */
+
+#include "CarvedLog.hpp"
+#include "utils/common.hpp"
+
+#include <cstring>
+#include <vector>
+
+/**
+ * @brief Opens a log for appending.
+ *
+ * @param fname Log pathname.
+ * @param append If false, an existing log is truncated.
+ * @throws std::runtime_error If the file can't be opened or holds something else than a carved blocks log.
+ */
+CarvedLog::CarvedLog(const std::filesystem::path& fname, bool append) {
+    const bool has_data = append && std::filesystem::exists(fname) && std::filesystem::file_size(fname) > 0;
+    if (has_data && !is_log(fname)) {
+        throw std::runtime_error(fmt::format("{} is not a carved blocks log", fname.string()));
+    }
+    m_file = std::ofstream(fname, std::ios::out | std::ios::binary | (append ? std::ios::app : std::ios::trunc));
+    if (!m_file.is_open()) {
+        throw std::runtime_error(fmt::format("Failed to open output file {}: {}", fname.string(), std::strerror(errno)));
+    }
+    if (!has_data) {
+        const CarvedLogHeader hdr;
+        m_file.write(reinterpret_cast<const char*>(&hdr), sizeof(hdr));
+    }
+}
+
+void CarvedLog::append(std::span<const HashEntry> entries) {
+    m_file.write(reinterpret_cast<const char*>(entries.data()), entries.size_bytes());
+}
+
+void CarvedLog::flush() {
+    m_file.flush();
+}
+
+bool CarvedLog::is_log(const std::filesystem::path& fname) {
+    std::ifstream in(fname, std::ios::binary);
+    CarvedLogHeader hdr;
+    return in.read(reinterpret_cast<char*>(&hdr), sizeof(hdr)) && hdr.valid();
+}
+
+/**
+ * @brief Formats an entry the way the scanner writes carved_blocks.csv.
+ *
+ * @param entry Entry of a carved blocks log.
+ * @return Csv row without the newline.
+ */
+std::string CarvedLog::csv_row(const HashEntry& entry) {
+    const char* comp_type = "NONE";
+    switch (entry.comp_type) {
+        case CT_LZ4: comp_type = "LZ4"; break;
+        case CT_ZLIB_LO: comp_type = "ZLIB"; break;
+        default: break;
+    }
+    std::string row = fmt::format("{:012x};{:06x};{:06x};{};{:08x};{}",
+        entry.offset, entry.comp_size, entry.orig_size, entry.hash, entry.crc, comp_type);
+    if (entry.keyset_id) {
+        row += fmt::format(";{}", entry.keyset_id);
+    }
+    return row;
+}
+
+/**
+ * @brief Converts a carved blocks log to csv.
+ *
+ * @param fname Log pathname.
+ * @param out Stream the rows are written to.
+ * @return Number of rows written.
+ * @throws std::runtime_error If the file can't be read or is not a carved blocks log.
+ */
+size_t CarvedLog::export_csv(const std::filesystem::path& fname, std::ostream& out) {
+    std::ifstream in(fname, std::ios::binary);
+    CarvedLogHeader hdr;
+    if (!in.read(reinterpret_cast<char*>(&hdr), sizeof(hdr)) || !hdr.valid()) {
+        throw std::runtime_error(fmt::format("{} is not a carved blocks log", fname.string()));
+    }
+
+    std::vector<HashEntry> entries(0x10000);
+    std::string text;
+    size_t nrows = 0;
+    while (in) {
+        in.read(reinterpret_cast<char*>(entries.data()), entries.size() * sizeof(HashEntry));
+        const size_t n = in.gcount() / sizeof(HashEntry);
+        text.clear();
+        for (size_t i = 0; i < n; i++) {
+            text += csv_row(entries[i]);
+            text += '\n';
+        }
+        out << text;
+        nrows += n;
+    }
+    if (in.gcount() % sizeof(HashEntry)) {
+        logger->warn("{}: ignoring a truncated entry at the end", fname.string());
+    }
+    return nrows;
+}
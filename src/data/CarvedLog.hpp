@@ -0,0 +1,51 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <ostream>
+#include <span>
+#include <string>
+
+#include "HashTable.hpp"
+
+struct CarvedLogHeader {
+    static const uint64_t MAGIC   = 0x474f4c4556524143; // "CARVELOG"
+    static const uint32_t VERSION = 1;
+
+    uint64_t magic = MAGIC;
+    uint32_t version = VERSION;
+    uint32_t entry_size = sizeof(HashEntry);
+
+    bool valid() const {
+        return magic == MAGIC && version == VERSION && entry_size == sizeof(HashEntry);
+    }
+};
+
+static_assert(sizeof(CarvedLogHeader) == 16, "CarvedLogHeader size must be 16 bytes");
+
+// binary log of carved blocks (carved_blocks.bin): a CarvedLogHeader followed by one HashEntry per block
+// in the order they were found, device_index is 0; written by the scanner next to (or instead of)
+// carved_blocks.csv, loaded by HashTable without parsing text, csv_row() gives the csv line of an entry
+class CarvedLog {
+    public:
+    static constexpr const char* FNAME = "carved_blocks.bin";
+
+    // opens fname for appending, writes the header to a new or empty file
+    // throws std::runtime_error if the file can't be opened or isn't a carved blocks log
+    CarvedLog(const std::filesystem::path& fname, bool append);
+
+    void append(std::span<const HashEntry> entries);
+    void flush();
+
+    // true if fname starts with a valid header
+    static bool is_log(const std::filesystem::path& fname);
+
+    // "offset;comp_size;orig_size;md5;crc;comp_type[;keyset_id]", same as carved_blocks.csv, without newline
+    static std::string csv_row(const HashEntry& entry);
+
+    // writes every entry of the log at fname as a csv row, returns the number of rows
+    static size_t export_csv(const std::filesystem::path& fname, std::ostream& out);
+
+    private:
+    std::ofstream m_file;
+};
@@ -10,6 +10,7 @@
  */
 
 #include "HashTable.hpp"
+#include "CarvedLog.hpp"
 #include <algorithm>
 #include <fstream>
 #include <iomanip>
@@ -65,7 +66,7 @@ bool HashTable::loadFromTextFile(const std::string& filename, uint8_t device_ind
 
         auto tokens = splitCSV(line);
         if (tokens.size() >= 5) {
-            HashEntry entry;
+            HashEntry entry{};
             entry.offset = Hex2Dec64(tokens[0]);
             entry.comp_size = (uint32_t)Hex2Dec64(tokens[1]);
             entry.orig_size = (uint32_t)Hex2Dec64(tokens[2]);
@@ -88,7 +89,7 @@ bool HashTable::loadFromTextFile(const std::string& filename, uint8_t device_ind
                 entry.comp_type = CT_LZ4;  // Default for legacy entries : TODO: verify if this fallback is appropriate
             }
             entry.device_index = device_index;
-            // entry.crc = (uint32_t)Hex2Dec64(tokens[4]);
+            entry.crc = (uint32_t)Hex2Dec64(tokens[4]);
             
             m_entries.push_back(entry);
             progress.found();
@@ -103,6 +104,56 @@ bool HashTable::loadFromTextFile(const std::string& filename, uint8_t device_ind
     return true;
 }
 
+/**
+ * @brief Loads hash table entries from a binary carved blocks log.
+ *
+ * The log holds HashEntry records already, they are copied from the mapped
+ * file and tagged with the device index.
+ *
+ * @param filename Path to the carved_blocks.bin file to load.
+ * @param device_index Index identifying which device/source this data came from.
+ * @return True if file was successfully loaded, false if it can't be mapped or is not a carved blocks log.
+ */
+bool HashTable::loadFromLog(const std::filesystem::path& filename, uint8_t device_index) {
+    std::error_code error;
+    mio::mmap_source mmap = mio::make_mmap_source(filename.native(), error);
+    if (error) {
+        std::cerr << "Error mapping " << filename << ": " << error.message() << std::endl;
+        return false;
+    }
+    const CarvedLogHeader* hdr = reinterpret_cast<const CarvedLogHeader*>(mmap.data());
+    if (mmap.size() < sizeof(CarvedLogHeader) || !hdr->valid()) {
+        std::cerr << "Invalid carved blocks log header" << std::endl;
+        return false;
+    }
+
+    const size_t n = (mmap.size() - sizeof(CarvedLogHeader)) / sizeof(HashEntry);
+    const HashEntry* begin = reinterpret_cast<const HashEntry*>(mmap.data() + sizeof(CarvedLogHeader));
+    const size_t first = m_entries.size();
+    m_entries.insert(m_entries.end(), begin, begin + n);
+    for (size_t i = first; i < m_entries.size(); i++) {
+        m_entries[i].device_index = device_index;
+    }
+
+    m_begin = m_entries.data();
+    m_end = m_begin + m_entries.size();
+    return true;
+}
+
+/**
+ * @brief Loads hash table entries from a carved blocks log or csv file.
+ *
+ * @param filename Path to a carved_blocks.bin or carved_blocks.csv file.
+ * @param device_index Index identifying which device/source this data came from.
+ * @return True if file was successfully loaded.
+ */
+bool HashTable::loadFromFile(const std::string& filename, uint8_t device_index) {
+    if (CarvedLog::is_log(filename)) {
+        return loadFromLog(filename, device_index);
+    }
+    return loadFromTextFile(filename, device_index);
+}
+
 /**
  * @brief Sorts hash table entries and removes duplicates.
  *
@@ -19,7 +19,8 @@ struct __attribute__((packed)) HashEntry {
     uint32_t orig_size;
     ECompType comp_type;  // compression type for carved blocks
     uint8_t device_index;
-    uint8_t padding[6];   // pad to 56 bytes (not strictly necessary, but good for performance)
+    uint32_t crc;         // as stored in the block header, 0 for zlib blocks
+    uint8_t padding[2];   // pad to 56 bytes (not strictly necessary, but good for performance)
 
     const std::string to_string() const {
         return fmt::format("<HashEntry offset={:x}, hash={}, keyset_id={}, comp_size={:x}, orig_size={:x}, comp_type={}>",
@@ -30,7 +31,7 @@ struct __attribute__((packed)) HashEntry {
 static_assert(sizeof(HashEntry) == 56, "HashEntry size must be 56 bytes");
 struct CacheFileHeader {
     static const uint64_t MAGIC   = 0x4c42545f48534148; // "HASH_TBL"
-    static const uint64_t VERSION = 9; // Added keyset_id to HashEntry
+    static const uint64_t VERSION = 10; // Added crc to HashEntry
 
     uint64_t magic = MAGIC;
     uint32_t version = VERSION;
@@ -46,7 +47,10 @@ class HashTable {
 public:
     HashTable() = default;
     
+    // carved_blocks.bin (CarvedLog) or carved_blocks.csv, told apart by the log header
+    bool loadFromFile(const std::string& filename, uint8_t device_index = 0);
     bool loadFromTextFile(const std::string& filename, uint8_t device_index = 0);
+    bool loadFromLog(const std::filesystem::path& filename, uint8_t device_index = 0);
     bool sortEntries();
     bool saveToCache(const std::filesystem::path&,std::size_t num_of_devices) const;
     bool loadFromCache(const std::filesystem::path&,std::size_t num_of_devices);
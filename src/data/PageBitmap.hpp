@@ -0,0 +1,82 @@
+#pragma once
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <unordered_set>
+#include <vector>
+
+// set of offsets on a page grid (base + n * page_size), one bit per page
+// bits live in 4K chunks allocated on first use, so memory follows the number of distinct
+// 128M regions (with 4K pages) holding set bits, and never exceeds size / page_size / 8 bytes;
+// offsets off the grid are rare (a scan restarted at an unaligned offset) and go to a hash set
+class PageBitmap {
+    public:
+    static constexpr size_t CHUNK_WORDS = 512; // 4K of bits per chunk
+    static constexpr size_t CHUNK_BITS = CHUNK_WORDS * 64;
+
+    PageBitmap(uint64_t size, size_t page_size, uint64_t base = 0)
+        : m_page_size(page_size), m_base(base), m_npages(size > base ? (size - base + page_size - 1) / page_size : 0),
+          m_chunks((m_npages + CHUNK_BITS - 1) / CHUNK_BITS) {}
+
+    void insert(uint64_t offset) {
+        size_t idx;
+        if (!index(offset, idx)) {
+            m_off_grid.insert(offset);
+            return;
+        }
+        auto& chunk = m_chunks[idx / CHUNK_BITS];
+        if (!chunk) {
+            chunk = std::make_unique<uint64_t[]>(CHUNK_WORDS); // zeroed
+            m_nchunks++;
+        }
+        chunk[idx % CHUNK_BITS / 64] |= 1ULL << (idx % 64);
+    }
+
+    bool contains(uint64_t offset) const {
+        size_t idx;
+        if (!index(offset, idx)) {
+            return !m_off_grid.empty() && m_off_grid.count(offset);
+        }
+        const auto& chunk = m_chunks[idx / CHUNK_BITS];
+        return chunk && (chunk[idx % CHUNK_BITS / 64] >> (idx % 64) & 1);
+    }
+
+    // all offsets >= from, grid ones in ascending order followed by the off-grid ones
+    std::vector<uint64_t> offsets(uint64_t from = 0) const {
+        std::vector<uint64_t> out;
+        for (size_t c = 0; c < m_chunks.size(); c++) {
+            if (!m_chunks[c]) continue;
+            for (size_t w = 0; w < CHUNK_WORDS; w++) {
+                for (uint64_t bits = m_chunks[c][w]; bits; bits &= bits - 1) {
+                    const uint64_t offset = m_base + (c * CHUNK_BITS + w * 64 + std::countr_zero(bits)) * m_page_size;
+                    if (offset >= from) out.push_back(offset);
+                }
+            }
+        }
+        for (uint64_t offset : m_off_grid) {
+            if (offset >= from) out.push_back(offset);
+        }
+        return out;
+    }
+
+    size_t memory_usage() const {
+        return m_chunks.size() * sizeof(m_chunks[0]) + m_nchunks * CHUNK_WORDS * sizeof(uint64_t) + m_off_grid.size() * sizeof(uint64_t);
+    }
+
+    private:
+    bool index(uint64_t offset, size_t& idx) const {
+        if (offset < m_base || (offset - m_base) % m_page_size != 0) {
+            return false;
+        }
+        idx = (offset - m_base) / m_page_size;
+        return idx < m_npages;
+    }
+
+    size_t m_page_size;
+    uint64_t m_base;
+    size_t m_npages;
+    std::vector<std::unique_ptr<uint64_t[]>> m_chunks;
+    size_t m_nchunks = 0;
+    std::unordered_set<uint64_t> m_off_grid; // incl. offsets past the end
+};
@@ -17,6 +17,7 @@
 
 #include "io/Errorlogger.hpp"
 #include "io/Writer.hpp"
+#include "scanning/PatternSearch.hpp"
 
 #include <lz4.h>
 
@@ -40,21 +41,25 @@ std::vector<BlockStruct> RepoIndexer::vbListBlocksRepo(FILE* f) {
     const size_t bufsize = 0x8000000;
     unsigned char* buf = (unsigned char*)malloc(bufsize);
     uint64_t hs = 0;
-    const unsigned char prlg[4] = { 0x0F, 0x00, 0x00, 0xF8 };
+    PatternSearch search;
+    search.add(signatures::lz_hdr_prefix());
+    std::vector<PatternSearch::Match> matches;
 
     while (hs < fsize) {
         size_t lzsz = (hs + bufsize > fsize) ? (fsize - hs) : bufsize;
+        fseek(f, hs, SEEK_SET);
         fread(buf, 1, lzsz, f);
-        for (size_t i = 0; i + 11 < lzsz; i++) {
-            if (memcmp(buf + i, prlg, 4) == 0 && buf[i + 11] == 0) {
-                BlockStruct blk;
-                blk.pos = hs + i;
-                blk.crc = *(uint32_t*)(buf + i + 4);
-                blk.srcSize = *(uint32_t*)(buf + i + 8);
-                blocks.push_back(blk);
-            }
+        matches.clear();
+        search.find(std::span<const uint8_t>(buf, lzsz), matches);
+        for (const auto& m : matches) {
+            BlockStruct blk;
+            blk.pos = hs + m.pos;
+            blk.crc = *(uint32_t*)(buf + m.pos + 4);
+            blk.srcSize = *(uint32_t*)(buf + m.pos + 8);
+            blocks.push_back(blk);
         }
-        hs += lzsz;
+        // headers crossing the end of the buffer are found with the next chunk
+        hs += (hs + lzsz < fsize) ? lzsz - (sizeof(lz_hdr) - 1) : lzsz;
     }
     free(buf);
     return blocks;
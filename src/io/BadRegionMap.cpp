@@ -0,0 +1,114 @@
+/**
+ * @file BadRegionMap.cpp
+ * @brief Implementation of the persistent map of unreadable source regions.
+ *
+ * Reading a bad sector can take seconds of device timeout, and a rescan or an
+ * extraction would hit the same sectors again. Regions found by Reader's salvage
+ * reads are recorded here and appended to a csv file in the output dir, so later
+ * runs skip them immediately.
+ */
+
+#include "BadRegionMap.hpp"
+#include "utils/common.hpp"
+
+#include <cstring>
+
+/**
+ * @brief Loads the bad region file, if it exists.
+ *
+ * Malformed lines are skipped with a warning. The file is opened for appending
+ * only when the first new region is added.
+ *
+ * @param fname Pathname of the bad region csv file.
+ */
+BadRegionMap::BadRegionMap(const std::filesystem::path& fname) : m_fname(fname) {
+    std::ifstream in(fname);
+    std::string line;
+    while (std::getline(in, line)) {
+        unsigned long long offset = 0, size = 0;
+        if (sscanf(line.c_str(), "%llx;%llx", &offset, &size) != 2 || size == 0) {
+            logger->warn("{}: skipping malformed line \"{}\"", fname.string(), line);
+            continue;
+        }
+        insert(offset, offset + size);
+    }
+    if (!m_regions.empty()) {
+        logger->info("loaded {} bad region{} ({}) from {}", count(), count() == 1 ? "" : "s", bytes2human(total_bytes()), fname.string());
+    }
+}
+
+std::shared_ptr<BadRegionMap> BadRegionMap::load_if_exists(const std::filesystem::path& fname) {
+    if (!std::filesystem::exists(fname)) {
+        return nullptr;
+    }
+    return std::make_shared<BadRegionMap>(fname);
+}
+
+// merges [start, end) with all regions it overlaps or touches
+void BadRegionMap::insert(off_t start, off_t end) {
+    auto it = m_regions.upper_bound(start);
+    if (it != m_regions.begin() && std::prev(it)->second >= start) {
+        --it;
+    }
+    while (it != m_regions.end() && it->first <= end) {
+        start = std::min(start, it->first);
+        end = std::max(end, it->second);
+        it = m_regions.erase(it);
+    }
+    m_regions.emplace(start, end);
+}
+
+/**
+ * @brief Records an unreadable range, appending it to the file (if any).
+ *
+ * @param offset Start of the range.
+ * @param size Size of the range in bytes.
+ */
+void BadRegionMap::add(off_t offset, size_t size) {
+    if (size == 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    insert(offset, offset + size);
+
+    if (m_fname.empty()) {
+        return;
+    }
+    if (!m_out.is_open()) {
+        m_out.open(m_fname, std::ios::out | std::ios::app);
+        if (!m_out) {
+            logger->error("Failed to open {}: {}", m_fname.string(), std::strerror(errno));
+            m_fname.clear();
+            return;
+        }
+    }
+    // flushed right away: the next bad sector might as well hang the process
+    m_out << fmt::format("{:012x};{:x}\n", offset, size) << std::flush;
+}
+
+std::pair<off_t, off_t> BadRegionMap::find(off_t offset, size_t size) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const off_t end = offset + size;
+    auto it = m_regions.upper_bound(offset);
+    if (it != m_regions.begin() && std::prev(it)->second > offset) {
+        --it;
+    }
+    if (it != m_regions.end() && it->first < end) {
+        return *it;
+    }
+    return {0, 0};
+}
+
+size_t BadRegionMap::count() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_regions.size();
+}
+
+size_t BadRegionMap::total_bytes() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    size_t total = 0;
+    for (const auto& [start, end] : m_regions) {
+        total += end - start;
+    }
+    return total;
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+// set of unreadable byte ranges of a source, optionally persisted to a csv file
+// ("offset;size" in hex, one region per line), so later runs can skip them without touching the device
+// adjacent and overlapping regions are merged, all methods are thread-safe
+class BadRegionMap {
+    public:
+    BadRegionMap() = default;
+
+    // loads fname if it exists, new regions are appended to it (the file is created on first add)
+    explicit BadRegionMap(const std::filesystem::path& fname);
+
+    // map for fname if it exists, nullptr otherwise
+    static std::shared_ptr<BadRegionMap> load_if_exists(const std::filesystem::path& fname);
+
+    void add(off_t offset, size_t size);
+
+    // first known bad region overlapping [offset, offset+size) as [start, end), {0, 0} if none
+    std::pair<off_t, off_t> find(off_t offset, size_t size) const;
+    bool overlaps(off_t offset, size_t size) const { auto r = find(offset, size); return r.second > r.first; }
+
+    size_t count() const;
+    size_t total_bytes() const;
+
+    const std::filesystem::path& fname() const { return m_fname; }
+
+    private:
+    void insert(off_t start, off_t end);
+
+    mutable std::mutex m_mutex;
+    std::map<off_t, off_t> m_regions; // start => end (exclusive)
+    std::filesystem::path m_fname;
+    std::ofstream m_out;
+};
@@ -0,0 +1,119 @@
+/**
+ * @file FileWriteQueue.cpp
+ * @brief Background writer for scan output files.
+ *
+ * The scanner saves every slot and bank it finds as a file of its own and
+ * patches banks into the saved slots. Writing them from the scan thread
+ * stalls the scan on every file creation, which is slow on network shares
+ * and on the failing disks VeeamPhaser is pointed at. The queue takes a copy
+ * of the data, so the scan buffer can be reused right away, and one thread
+ * writes the files in submission order.
+ */
+
+#include "FileWriteQueue.hpp"
+#include "Writer.hpp"
+#include "utils/common.hpp"
+
+FileWriteQueue::~FileWriteQueue() {
+    try {
+        flush();
+    } catch (const std::exception& e) {
+        logger->error("FileWriteQueue: {}", e.what());
+    }
+    if (m_thread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_cv.notify_all();
+        m_thread.join();
+    }
+}
+
+/**
+ * @brief Queues a file write.
+ *
+ * Blocks while more than max_pending bytes are queued, so a burst of large
+ * banks can't exhaust memory.
+ *
+ * @param fname Output file.
+ * @param data Data to write, copied before returning.
+ * @param truncate If true, the file is created anew; if false, data is written into it at offset.
+ * @param offset Write position, used only if truncate is false.
+ * @throws std::runtime_error Error of an earlier queued write.
+ */
+void FileWriteQueue::write(const std::filesystem::path& fname, std::span<const uint8_t> data, bool truncate, off_t offset) {
+    Job job{fname, offset, truncate, buf_t(data.size())};
+    std::copy(data.begin(), data.end(), job.data.begin());
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (!m_thread.joinable()) {
+        m_thread = std::thread(&FileWriteQueue::thr_proc, this);
+    }
+    // a job larger than the limit waits for an empty queue instead of forever
+    m_cv.wait(lock, [&] { return m_pending == 0 || m_pending + data.size() <= m_max_pending; });
+    m_pending += data.size();
+    m_jobs.push_back(std::move(job));
+    lock.unlock();
+    m_cv.notify_all();
+
+    rethrow_error();
+}
+
+/**
+ * @brief Waits until all queued writes are done.
+ *
+ * @throws std::runtime_error Error of a queued write.
+ */
+void FileWriteQueue::flush() {
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cv.wait(lock, [this] { return m_jobs.empty() && !m_busy; });
+    }
+    rethrow_error();
+}
+
+void FileWriteQueue::rethrow_error() {
+    std::exception_ptr error;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::swap(error, m_error);
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+void FileWriteQueue::thr_proc() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+        m_cv.wait(lock, [this] { return !m_jobs.empty() || m_stop; });
+        if (m_jobs.empty()) {
+            return; // stopped
+        }
+        Job job = std::move(m_jobs.front());
+        m_jobs.pop_front();
+        m_busy = true;
+        lock.unlock();
+
+        std::exception_ptr error;
+        try {
+            logger->trace("writing {} @ {:x}", job.fname, job.offset);
+            Writer w(job.fname, job.truncate);
+            if (!job.truncate) {
+                w.seek(job.offset);
+            }
+            w.write(job.data.data(), job.data.size());
+        } catch (...) {
+            error = std::current_exception();
+        }
+
+        lock.lock();
+        if (error && !m_error) {
+            m_error = error;
+        }
+        m_pending -= job.data.size();
+        m_busy = false;
+        m_cv.notify_all();
+    }
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <filesystem>
+#include <mutex>
+#include <span>
+#include <thread>
+
+#include "core/buf_t.hpp"
+
+// background writer for the many small output files of a scan (.slot, .bank):
+// write() copies the data and returns, one thread writes the files in submission order,
+// so a file created by one write() exists for a later write() into it
+// write() blocks while more than max_pending bytes are queued, write errors are thrown from a later write() or flush()
+class FileWriteQueue {
+    public:
+    static constexpr size_t DEFAULT_MAX_PENDING = 64 * 1024 * 1024;
+
+    explicit FileWriteQueue(size_t max_pending = DEFAULT_MAX_PENDING) : m_max_pending(max_pending) {}
+    // writes out what's queued, only logs errors
+    ~FileWriteQueue();
+
+    FileWriteQueue(const FileWriteQueue&) = delete;
+    FileWriteQueue& operator=(const FileWriteQueue&) = delete;
+
+    // truncate: create the file anew, otherwise write into an existing one at offset
+    void write(const std::filesystem::path& fname, std::span<const uint8_t> data, bool truncate = true, off_t offset = 0);
+
+    // waits until everything queued is written
+    void flush();
+
+    private:
+    struct Job {
+        std::filesystem::path fname;
+        off_t offset;
+        bool truncate;
+        buf_t data;
+    };
+
+    void rethrow_error();
+    void thr_proc();
+
+    const size_t m_max_pending;
+    std::deque<Job> m_jobs;
+    size_t m_pending = 0; // bytes in m_jobs and the one being written
+    bool m_busy = false;  // m_thread is writing a job
+    bool m_stop = false;
+    std::exception_ptr m_error;
+
+    std::thread m_thread; // started by the first write()
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+};
@@ -0,0 +1,420 @@
+/**
+ * @file ReadQueue.cpp
+ * @brief Implementation of batched asynchronous reads on top of Reader.
+ *
+ * On Linux the queue talks to io_uring directly through the raw syscalls, so no
+ * extra library is needed. Many positioned reads can be kept in flight at once,
+ * which is what NVMe arrays and iSCSI LUNs need to reach their IOPS. When io_uring
+ * is unavailable (other platforms, old kernels, seccomp) the same API is served by
+ * sequential Reader::read_at() calls.
+ */
+
+#include "ReadQueue.hpp"
+#include "utils/common.hpp"
+#include <spdlog/fmt/bundled/core.h>
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define HAVE_IO_URING 1
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/**
+ * @brief Creates a read queue for the given reader.
+ *
+ * Tries to set up an io_uring instance with the requested depth. If that fails,
+ * the queue silently works in synchronous mode.
+ *
+ * @param reader Reader to read from. Must outlive the queue.
+ * @param depth Maximum number of reads pending at the same time.
+ */
+ReadQueue::ReadQueue(Reader& reader, unsigned depth) : m_reader(reader), m_depth(std::max(depth, 1u)) {
+    m_slots.resize(m_depth);
+    if( m_reader.fd() != -1 && setup_ring() ){ // concatenated sources have no single fd to submit to
+        logger->debug("ReadQueue: io_uring, depth {}", m_depth);
+    } else {
+        logger->debug("ReadQueue: synchronous reads, depth {}", m_depth);
+    }
+}
+
+/**
+ * @brief Waits for all in-flight reads and releases the ring.
+ *
+ * Reads still owned by the kernel must finish before their buffers can be freed
+ * by the caller, so pending completions are drained and discarded.
+ */
+ReadQueue::~ReadQueue() {
+    std::vector<Completion> discarded;
+    while( m_npending ){
+        try {
+            reap(discarded, m_npending);
+        } catch (const std::exception& e) {
+            logger->error("ReadQueue: {}", e.what());
+            break;
+        }
+    }
+    close_ring();
+}
+
+/**
+ * @brief Sets up the io_uring instance and maps its rings.
+ *
+ * @return True if io_uring is usable, false to fall back to synchronous reads.
+ */
+bool ReadQueue::setup_ring() {
+#ifdef HAVE_IO_URING
+    io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    int fd = syscall(__NR_io_uring_setup, m_depth, &p);
+    if( fd == -1 ){
+        logger->debug("io_uring_setup({}): {}", m_depth, strerror(errno));
+        return false;
+    }
+    m_ring_fd = fd;
+
+    // kernels 5.1-5.5 set up a ring but reject IORING_OP_READ, and cannot be probed either
+    std::vector<uint8_t> probe_buf(sizeof(io_uring_probe) + IORING_OP_LAST * sizeof(io_uring_probe_op));
+    io_uring_probe* probe = reinterpret_cast<io_uring_probe*>(probe_buf.data());
+    if( syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, IORING_OP_LAST) == -1
+            || probe->last_op < IORING_OP_READ || !(probe->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED) ){
+        logger->debug("io_uring: IORING_OP_READ not supported");
+        close_ring();
+        return false;
+    }
+    m_read_op = IORING_OP_READ;
+
+    m_sq_map_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    m_cq_map_size = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+    if( p.features & IORING_FEAT_SINGLE_MMAP ){
+        m_sq_map_size = m_cq_map_size = std::max(m_sq_map_size, m_cq_map_size);
+    }
+
+    m_sq_ptr = mmap(nullptr, m_sq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if( m_sq_ptr == MAP_FAILED ){
+        m_sq_ptr = nullptr;
+        close_ring();
+        return false;
+    }
+
+    if( p.features & IORING_FEAT_SINGLE_MMAP ){
+        m_cq_ptr = m_sq_ptr;
+    } else {
+        m_cq_ptr = mmap(nullptr, m_cq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if( m_cq_ptr == MAP_FAILED ){
+            m_cq_ptr = nullptr;
+            close_ring();
+            return false;
+        }
+    }
+
+    m_sqes_map_size = p.sq_entries * sizeof(io_uring_sqe);
+    m_sqes = mmap(nullptr, m_sqes_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if( m_sqes == MAP_FAILED ){
+        m_sqes = nullptr;
+        close_ring();
+        return false;
+    }
+
+    uint8_t* sq = static_cast<uint8_t*>(m_sq_ptr);
+    m_sq_head  = reinterpret_cast<unsigned*>(sq + p.sq_off.head);
+    m_sq_tail  = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+    m_sq_mask  = reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+    m_sq_array = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+
+    uint8_t* cq = static_cast<uint8_t*>(m_cq_ptr);
+    m_cq_head = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+    m_cq_tail = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+    m_cq_mask = reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+    m_cqes    = cq + p.cq_off.cqes;
+    return true;
+#else
+    return false;
+#endif
+}
+
+/**
+ * @brief Unmaps the rings and closes the io_uring descriptor.
+ */
+void ReadQueue::close_ring() {
+#ifdef HAVE_IO_URING
+    if( m_sqes ) munmap(m_sqes, m_sqes_map_size);
+    if( m_cq_ptr && m_cq_ptr != m_sq_ptr ) munmap(m_cq_ptr, m_cq_map_size);
+    if( m_sq_ptr ) munmap(m_sq_ptr, m_sq_map_size);
+    if( m_ring_fd != -1 ) close(m_ring_fd);
+#endif
+    m_sqes = m_cq_ptr = m_sq_ptr = nullptr;
+    m_ring_fd = -1;
+}
+
+/**
+ * @brief Queues a positioned read.
+ *
+ * The read is not started until submit() or reap() is called. The buffer must
+ * stay valid until the matching completion is reaped.
+ *
+ * @param offset File position to read from.
+ * @param buf Destination buffer.
+ * @param count Number of bytes to read.
+ * @param tag Caller-defined value returned in the completion.
+ * @throws std::invalid_argument If offset is negative.
+ * @throws std::logic_error If depth reads are already pending.
+ */
+void ReadQueue::push(off_t offset, void* buf, size_t count, uint64_t tag) {
+    if( offset < 0 ){
+        throw std::invalid_argument(fmt::format("offset < 0: {:#x}", offset));
+    }
+    if( m_npending >= m_depth ){
+        throw std::logic_error(fmt::format("ReadQueue: {} reads already pending", m_npending));
+    }
+
+    auto it = std::find_if(m_slots.begin(), m_slots.end(), [](const Request& r){ return !r.busy; });
+    *it = Request{tag, offset, buf, count, true};
+    m_queued.push_back(it - m_slots.begin());
+    m_npending++;
+}
+
+/**
+ * @brief Submits all queued reads to the kernel.
+ *
+ * In synchronous mode this is a no-op, queued reads are executed by reap().
+ *
+ * @return Number of reads handed to the kernel.
+ * @throws std::runtime_error If io_uring_enter() fails.
+ */
+size_t ReadQueue::submit() {
+#ifdef HAVE_IO_URING
+    if( !is_async() || m_read_unsupported || m_queued.empty() ){
+        return 0;
+    }
+
+    const size_t align = m_reader.get_align();
+    unsigned tail = *m_sq_tail;
+    size_t nsubmit = 0;
+    for( auto it = m_queued.begin(); it != m_queued.end(); ){
+        const Request& req = m_slots[*it];
+        if( req.count > UINT32_MAX / 2 ){
+            ++it; // too big for a single sqe, reap() will read it synchronously
+            continue;
+        }
+        if( align && (req.offset % align || req.count % align || reinterpret_cast<uintptr_t>(req.buf) % align) ){
+            ++it; // unaligned direct read, Reader::read_at() bounces it through an aligned buffer
+            continue;
+        }
+
+        unsigned idx = tail & *m_sq_mask;
+        io_uring_sqe* sqe = static_cast<io_uring_sqe*>(m_sqes) + idx;
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = m_read_op;
+        sqe->fd = m_reader.fd();
+        sqe->off = req.offset;
+        sqe->addr = reinterpret_cast<uint64_t>(req.buf);
+        sqe->len = req.count;
+        sqe->user_data = *it;
+        m_sq_array[idx] = idx;
+
+        tail++;
+        nsubmit++;
+        it = m_queued.erase(it);
+    }
+    __atomic_store_n(m_sq_tail, tail, __ATOMIC_RELEASE);
+
+    size_t left = nsubmit;
+    while( left ){
+        int ret = syscall(__NR_io_uring_enter, m_ring_fd, left, 0, 0, nullptr, 0);
+        if( ret == -1 ){
+            if( errno == EINTR || errno == EAGAIN ) continue;
+            throw std::runtime_error(fmt::format("io_uring_enter({}): {}", left, strerror(errno)));
+        }
+        left -= ret;
+    }
+    return nsubmit;
+#else
+    return 0;
+#endif
+}
+
+/**
+ * @brief Collects finished reads.
+ *
+ * Submits anything still queued, then blocks until at least min_complete reads
+ * are finished (or nothing is pending anymore).
+ *
+ * @param[out] out Completions are appended here, in completion order.
+ * @param min_complete Minimum number of completions to wait for.
+ * @return Number of completions appended.
+ */
+size_t ReadQueue::reap(std::vector<Completion>& out, size_t min_complete) {
+    submit();
+    min_complete = std::min(min_complete, m_npending);
+
+    size_t n = 0;
+    // whatever could not go to the kernel is read right here
+    while( !m_queued.empty() ){
+        Request& req = m_slots[m_queued.front()];
+        m_queued.pop_front();
+        out.push_back(read_sync(req));
+        req.busy = false;
+        m_npending--;
+        n++;
+    }
+
+#ifdef HAVE_IO_URING
+    while( is_async() && m_npending ){
+        unsigned head = *m_cq_head;
+        unsigned tail = __atomic_load_n(m_cq_tail, __ATOMIC_ACQUIRE);
+        for( ; head != tail; head++ ){
+            const io_uring_cqe* cqe = static_cast<io_uring_cqe*>(m_cqes) + (head & *m_cq_mask);
+            Request& req = m_slots[cqe->user_data];
+            out.push_back(complete(req, cqe->res));
+            req.busy = false;
+            m_npending--;
+            n++;
+        }
+        __atomic_store_n(m_cq_head, head, __ATOMIC_RELEASE);
+
+        if( m_read_unsupported && !m_npending ){
+            logger->debug("ReadQueue: kernel rejected the read, switching to synchronous reads");
+            close_ring();
+            break;
+        }
+        if( n >= min_complete ){
+            break;
+        }
+
+        int ret = syscall(__NR_io_uring_enter, m_ring_fd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+        if( ret == -1 && errno != EINTR && errno != EAGAIN ){
+            throw std::runtime_error(fmt::format("io_uring_enter(GETEVENTS): {}", strerror(errno)));
+        }
+    }
+#endif
+    return n;
+}
+
+/**
+ * @brief Turns a raw io_uring result into a completion.
+ *
+ * Interrupted reads are retried synchronously, short reads before EOF are
+ * finished synchronously, so callers only ever see short reads at EOF.
+ * -EINVAL means the kernel does not know the read opcode: the read is served
+ * synchronously and the queue stops submitting, the ring is closed by reap()
+ * once the reads already in the kernel are back.
+ *
+ * @param req The finished request.
+ * @param res The cqe result: bytes read or negative errno.
+ * @return Completion describing the request.
+ */
+ReadQueue::Completion ReadQueue::complete(const Request& req, int res) {
+    if( res == -EINTR || res == -EAGAIN ){
+        return read_sync(req);
+    }
+    if( res == -EINVAL ){
+        m_read_unsupported = true;
+        return read_sync(req);
+    }
+
+    Completion c{req.tag, req.offset, req.buf, req.count, 0, 0};
+    if( res < 0 ){
+        c.error = -res;
+        return c;
+    }
+
+    c.nread = res;
+    if( c.nread > 0 && c.nread < c.count && (size_t)c.offset + c.nread < m_reader.size() ){
+        Request rest{req.tag, req.offset + (off_t)c.nread, static_cast<uint8_t*>(req.buf) + c.nread, req.count - c.nread, true};
+        Completion cr = read_sync(rest);
+        c.nread += cr.nread;
+        c.error = cr.error;
+    }
+    return c;
+}
+
+/**
+ * @brief Executes a request with a plain Reader::read_at().
+ *
+ * @param req Request to execute.
+ * @return Completion with error set to EIO if the read failed.
+ */
+ReadQueue::Completion ReadQueue::read_sync(const Request& req) {
+    Completion c{req.tag, req.offset, req.buf, req.count, 0, 0};
+    try {
+        c.nread = m_reader.read_at(req.offset, req.buf, req.count);
+    } catch (const Reader::ReadError& e) {
+        logger->trace("{}", e.what());
+        c.error = EIO;
+    }
+    return c;
+}
+
+/**
+ * @brief Reads a contiguous range using several concurrent chunk reads.
+ *
+ * Drop-in replacement for Reader::read_at() on large buffers: the range is split
+ * into chunk_size pieces and up to depth() of them are kept in flight.
+ *
+ * @param offset File position to read from.
+ * @param buf Buffer to read into.
+ * @param count Number of bytes to read.
+ * @param chunk_size Size of each individual read.
+ * @return Number of bytes actually read (may be less than count at EOF).
+ * @throws std::invalid_argument If offset is negative.
+ * @throws std::logic_error If other reads are still pending.
+ * @throws Reader::ReadError If any chunk fails, after all chunks have finished.
+ */
+size_t ReadQueue::read_at(off_t offset, void* buf, size_t count, size_t chunk_size) {
+    if( offset < 0 ){
+        throw std::invalid_argument(fmt::format("offset < 0: {:#x}", offset));
+    }
+    if( m_npending ){
+        throw std::logic_error("ReadQueue::read_at() needs an idle queue");
+    }
+    if( (size_t)offset >= m_reader.size() ){
+        return 0;
+    }
+    count = std::min(count, m_reader.size() - offset);
+    chunk_size = std::max<size_t>(chunk_size, 1);
+
+    const size_t nchunks = (count + chunk_size - 1) / chunk_size;
+    std::vector<size_t> chunk_nread(nchunks, 0);
+    std::vector<Completion> done;
+    int error = 0;
+    off_t error_offset = 0;
+    size_t error_count = 0;
+
+    size_t next = 0;
+    while( next < nchunks || m_npending ){
+        while( next < nchunks && m_npending < m_depth ){
+            size_t pos = next * chunk_size;
+            push(offset + pos, static_cast<uint8_t*>(buf) + pos, std::min(chunk_size, count - pos), next);
+            next++;
+        }
+
+        done.clear();
+        reap(done, 1);
+        for( const auto& c : done ){
+            chunk_nread[c.tag] = c.nread;
+            if( c.error && !error ){
+                error = c.error;
+                error_offset = c.offset;
+                error_count = c.count;
+            }
+        }
+    }
+
+    if( error ){
+        throw Reader::ReadError(fmt::format("read(fd {:#x}, offset {:#x}, count {:#x}): {}", m_reader.fd(), error_offset, error_count, strerror(error)));
+    }
+
+    size_t total = 0;
+    for( size_t i = 0; i < nchunks; i++ ){
+        total += chunk_nread[i];
+        if( chunk_nread[i] < std::min(chunk_size, count - i * chunk_size) )
+            break;
+    }
+    return total;
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include "Reader.hpp"
+
+// batched asynchronous reads on top of a Reader:
+//  - push() any number of reads (up to depth), submit() them at once, reap() completions
+//  - backed by io_uring on linux, falls back to sequential Reader::read_at() elsewhere
+//    (or when the kernel refuses to set up a ring or to read through it)
+//
+// not thread-safe: one queue per reading thread
+class ReadQueue {
+    public:
+    ReadQueue(Reader& reader, unsigned depth = 32);
+    ~ReadQueue();
+
+    ReadQueue(const ReadQueue&) = delete;
+    ReadQueue& operator=(const ReadQueue&) = delete;
+
+    struct Completion {
+        uint64_t tag;
+        off_t offset;
+        void* buf;
+        size_t count;
+        size_t nread;   // may be less than count only at EOF
+        int error;      // errno, 0 on success
+    };
+
+    // queue a read, throws std::logic_error if depth reads are already pending
+    void push(off_t offset, void* buf, size_t count, uint64_t tag = 0);
+
+    // hand all pushed reads to the kernel, returns number of reads submitted
+    size_t submit();
+
+    // wait for at least min_complete reads (submitting pushed ones first), append all finished ones to out
+    size_t reap(std::vector<Completion>& out, size_t min_complete = 1);
+
+    // same contract as Reader::read_at(), but splits the read into chunk_size pieces kept in flight together
+    size_t read_at(off_t offset, void* buf, size_t count, size_t chunk_size);
+
+    bool is_async() const { return m_ring_fd != -1; }
+    unsigned depth() const { return m_depth; }
+    size_t pending() const { return m_npending; }
+
+    private:
+    struct Request {
+        uint64_t tag;
+        off_t offset;
+        void* buf;
+        size_t count;
+        bool busy = false;
+    };
+
+    bool setup_ring();
+    void close_ring();
+    Completion complete(const Request& req, int res);
+    Completion read_sync(const Request& req);
+
+    Reader& m_reader;
+    unsigned m_depth;
+    size_t m_npending = 0;
+
+    std::vector<Request> m_slots;   // indexed by io_uring user_data
+    std::deque<size_t> m_queued;    // slots pushed but not submitted yet
+
+    // io_uring state
+    int m_ring_fd = -1;
+    uint8_t m_read_op = 0;              // IORING_OP_READ once probed
+    bool m_read_unsupported = false;    // kernel answered -EINVAL, finish in-flight reads and go synchronous
+    void* m_sq_ptr = nullptr;
+    void* m_cq_ptr = nullptr;
+    void* m_sqes = nullptr;
+    size_t m_sq_map_size = 0;
+    size_t m_cq_map_size = 0;
+    size_t m_sqes_map_size = 0;
+
+    unsigned* m_sq_head = nullptr;
+    unsigned* m_sq_tail = nullptr;
+    unsigned* m_sq_mask = nullptr;
+    unsigned* m_sq_array = nullptr;
+    unsigned* m_cq_head = nullptr;
+    unsigned* m_cq_tail = nullptr;
+    unsigned* m_cq_mask = nullptr;
+    void* m_cqes = nullptr;
+
+    friend class ReadQueueTest;
+};
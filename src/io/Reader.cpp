@@ -9,17 +9,27 @@
  */
 
 #include "Reader.hpp"
+#include "core/BufferPool.hpp"
 #include "utils/common.hpp"
 #include <spdlog/fmt/bundled/core.h>
 
+#include <algorithm>
+#include <fstream>
+
 #include <sys/stat.h>
 #include <unistd.h>
 
+#ifndef __WIN32__
+#include <sys/mman.h>
+#endif
+
 #ifdef __linux__
 #include <sys/ioctl.h>
 #include <linux/fs.h>
 #elif __APPLE__
 #include <sys/disk.h>
+#include <fcntl.h>
+#include <climits>
 #elif __WIN32__
 #include <windows.h>
 #include <winioctl.h>
@@ -65,6 +75,12 @@ static size_t get_dev_align(const std::filesystem::path& fname){
 
 size_t Reader::get_size(const std::filesystem::path& fname) {
     size_t size = 0;
+    if( is_part_list(fname) ) {
+        for( const auto& part : read_part_list(fname) ) {
+            size += get_size(part);
+        }
+        return size;
+    }
     struct stat st;
     if( stat(fname.string().c_str(), &st) == -1 ) {
 #ifdef __WIN32__
@@ -114,17 +130,94 @@ size_t Reader::get_size(const std::filesystem::path& fname) {
 #define OPEN_MODE O_RDONLY
 #endif
 
+bool Reader::is_part_list(const std::filesystem::path& fname) {
+    return fname.native().size() > 1 && fname.native()[0] == '@';
+}
+
+/**
+ * @brief Reads the list of parts of a concatenated source.
+ *
+ * @param fname "@" followed by the pathname of the list file.
+ * @return Pathnames of the parts, in order.
+ * @throws std::runtime_error If the list can't be read or is empty.
+ */
+std::vector<std::filesystem::path> Reader::read_part_list(const std::filesystem::path& fname) {
+    const std::filesystem::path list_fname = fname.native().substr(1);
+    std::ifstream in(list_fname);
+    if( !in ) {
+        throw std::runtime_error(fmt::format("open(\"{}\"): {}", list_fname, strerror(errno)));
+    }
+
+    std::vector<std::filesystem::path> parts;
+    std::string line;
+    while( std::getline(in, line) ) {
+        if( !line.empty() && line.back() == '\r' ) {
+            line.pop_back();
+        }
+        if( line.empty() || line[0] == '#' ) {
+            continue;
+        }
+        std::filesystem::path part(line);
+        parts.push_back(part.is_relative() ? list_fname.parent_path() / part : part);
+    }
+    if( parts.empty() ) {
+        throw std::runtime_error(fmt::format("{}: no parts listed", list_fname));
+    }
+    return parts;
+}
+
+/**
+ * @brief Opens every part of a concatenated source.
+ *
+ * Parts are opened with the same flags, except RF_MMAP: a view() spanning two
+ * parts could not be served from one mapping anyway.
+ *
+ * @param fname "@" followed by the pathname of the list file.
+ * @param flags Combination of EFlags.
+ */
+void Reader::open_parts(const std::filesystem::path& fname, int flags) {
+    for( const auto& part_fname : read_part_list(fname) ) {
+        m_parts.push_back(std::make_unique<Reader>(part_fname, flags & ~RF_MMAP));
+        m_part_starts.push_back(m_size);
+        m_size += m_parts.back()->size();
+        m_align = std::max(m_align, m_parts.back()->get_align());
+        logger->debug("{}: part {} @ {:#x}, size: {:#x}", fname, part_fname, m_part_starts.back(), m_parts.back()->size());
+    }
+    logger->info("{}: {} parts, {}", fname, m_parts.size(), bytes2human(m_size));
+}
+
 /**
  * @brief Constructs a Reader for the specified file or device.
  *
  * Opens the file/device for reading and determines its size. For Windows block
  * devices (paths starting with "\\\\.\\"), also determines sector alignment requirements.
+ * With RF_DIRECT the page cache is bypassed where the platform supports it; on Linux
+ * this means O_DIRECT, so reads are transparently aligned to the logical sector size.
+ * Filesystems that reject O_DIRECT fall back to buffered reads. With RF_MMAP regular
+ * files are mapped into memory; if mapping fails, plain reads are used.
  *
  * @param fname Path to file or device to open.
+ * @param flags Combination of EFlags.
  * @throws std::runtime_error If file cannot be opened or size cannot be determined.
  */
-Reader::Reader(const std::filesystem::path& fname) : m_fname(fname) {
-    m_fd = open(fname.string().c_str(), OPEN_MODE);
+Reader::Reader(const std::filesystem::path& fname, int flags) : m_fname(fname) {
+    if( is_part_list(fname) ) {
+        open_parts(fname, flags);
+        return;
+    }
+#ifdef O_DIRECT
+    if( flags & RF_DIRECT ) {
+        m_fd = open(fname.string().c_str(), OPEN_MODE | O_DIRECT);
+        if( m_fd == -1 && errno == EINVAL ) {
+            logger->warn("{}: O_DIRECT is not supported, using buffered reads", fname);
+        } else if( m_fd != -1 ) {
+            m_direct = true;
+        }
+    }
+#endif
+    if( m_fd == -1 ) {
+        m_fd = open(fname.string().c_str(), OPEN_MODE);
+    }
     if( m_fd == -1 ) {
         throw std::runtime_error(fmt::format("open(\"{}\", {:#x}): {}", fname, OPEN_MODE, strerror(errno)));
     }
@@ -134,7 +227,31 @@ Reader::Reader(const std::filesystem::path& fname) : m_fname(fname) {
         m_align = get_dev_align(fname);
         logger->debug("Device: {}, size: {}, align: {}", fname, m_size, m_align);
     }
+#elif __APPLE__
+    if( flags & RF_DIRECT ) {
+        m_direct = fcntl(m_fd, F_NOCACHE, 1) != -1;
+    }
+#endif
+#ifdef __linux__
+    if( m_direct ) {
+        m_align = 4096; // safe for any filesystem
+        int sector_size = 0;
+        struct stat st;
+        if( fstat(m_fd, &st) == 0 && S_ISBLK(st.st_mode) && ioctl(m_fd, BLKSSZGET, &sector_size) == 0 && sector_size > 0 ) {
+            m_align = sector_size;
+        }
+        logger->debug("{}: direct I/O, size: {}, align: {}", fname, m_size, m_align);
+    }
 #endif
+    if( (flags & RF_MMAP) && !m_direct && m_size > 0 && std::filesystem::is_regular_file(fname) ) {
+        std::error_code error;
+        m_map.map(fname.native(), error);
+        if( error ) {
+            logger->debug("{}: mmap failed, using reads: {}", fname, error.message());
+        } else {
+            logger->debug("{}: mapped, size: {}", fname, m_size);
+        }
+    }
 }
 
 /**
@@ -146,6 +263,177 @@ Reader::~Reader() {
     }
 }
 
+/**
+ * @brief Calls fn(part, part_offset, count) for every part a range overlaps, in order.
+ *
+ * Stops early when fn returns false. The range must start below m_size.
+ */
+template <typename F>
+void Reader::for_each_part(off_t offset, size_t count, F&& fn) {
+    size_t i = std::upper_bound(m_part_starts.begin(), m_part_starts.end(), offset) - m_part_starts.begin() - 1;
+    for( size_t done = 0; done < count && i < m_parts.size(); i++ ) {
+        const off_t part_offset = offset + done - m_part_starts[i];
+        const size_t n = std::min(count - done, m_parts[i]->size() - part_offset);
+        if( n == 0 ) {
+            continue; // empty part
+        }
+        if( !fn(*m_parts[i], part_offset, n) ) {
+            break;
+        }
+        done += n;
+    }
+}
+
+/**
+ * @brief Finds the next data extent of a sparse file.
+ *
+ * Uses lseek(SEEK_DATA/SEEK_HOLE). Filesystems without hole support report the
+ * whole file as data, so callers can always rely on the result. Extents of a
+ * concatenated source never span parts.
+ *
+ * @param offset Position to search from.
+ * @return [start, end) of the extent containing or following offset, {size, size} if there is none.
+ * @throws std::invalid_argument If offset is negative.
+ */
+std::pair<off_t, off_t> Reader::data_extent(off_t offset) {
+    if( offset < 0 ){
+        throw std::invalid_argument(fmt::format("offset < 0: {:#x}", offset));
+    }
+    const off_t size = m_size;
+    if( offset >= size ) {
+        return {size, size};
+    }
+    if( !m_parts.empty() ) {
+        size_t i = std::upper_bound(m_part_starts.begin(), m_part_starts.end(), offset) - m_part_starts.begin() - 1;
+        for( ; i < m_parts.size(); i++ ) {
+            const off_t part_size = m_parts[i]->size();
+            const off_t part_offset = std::max<off_t>(offset - m_part_starts[i], 0);
+            if( part_offset >= part_size ) {
+                continue;
+            }
+            const auto [start, end] = m_parts[i]->data_extent(part_offset);
+            if( start < part_size ) {
+                return {m_part_starts[i] + start, m_part_starts[i] + end};
+            }
+        }
+        return {size, size};
+    }
+#ifdef SEEK_DATA
+    // pread() doesn't use the file position, so moving it here is harmless
+    const off_t start = lseek(m_fd, offset, SEEK_DATA);
+    if( start == -1 ) {
+        // ENXIO: nothing but a hole up to EOF, anything else: no hole support
+        return errno == ENXIO ? std::pair{size, size} : std::pair{offset, size};
+    }
+    const off_t end = lseek(m_fd, start, SEEK_HOLE);
+    return {std::min(start, size), (end == -1) ? size : std::min(end, size)};
+#else
+    return {offset, size};
+#endif
+}
+
+/**
+ * @brief Tells the kernel how the source is going to be read.
+ *
+ * Hints only: failures are logged at debug level and otherwise ignored.
+ *
+ * @param access Expected access pattern.
+ */
+void Reader::advise(Access access) {
+    for( auto& part : m_parts ) {
+        part->advise(access);
+    }
+    if( m_direct || m_fd == -1 ) {
+        return; // no page cache involved
+    }
+#ifndef __WIN32__
+    if( m_map.is_mapped() ) {
+        const int advice = access == Access::SEQUENTIAL ? MADV_SEQUENTIAL : access == Access::RANDOM ? MADV_RANDOM : MADV_NORMAL;
+        if( madvise((void*)m_map.data(), m_map.mapped_length(), advice) != 0 ) {
+            logger->debug("{}: madvise({}): {}", m_fname, advice, strerror(errno));
+        }
+        return;
+    }
+#endif
+#if defined(__linux__)
+    const int advice = access == Access::SEQUENTIAL ? POSIX_FADV_SEQUENTIAL : access == Access::RANDOM ? POSIX_FADV_RANDOM : POSIX_FADV_NORMAL;
+    if( int err = posix_fadvise(m_fd, 0, 0, advice); err != 0 ) {
+        logger->debug("{}: posix_fadvise({}): {}", m_fname, advice, strerror(err));
+    }
+#elif defined(__APPLE__)
+    // macos only has a readahead on/off switch
+    fcntl(m_fd, F_RDAHEAD, access == Access::RANDOM ? 0 : 1);
+#else
+    (void)access;
+#endif
+}
+
+/**
+ * @brief Starts reading a range into the page cache in the background.
+ *
+ * @param offset Start of the range.
+ * @param count Length of the range.
+ */
+void Reader::will_need(off_t offset, size_t count) {
+    if( m_direct || offset < 0 || (size_t)offset >= m_size || count == 0 ) {
+        return;
+    }
+    if( !m_parts.empty() ) {
+        for_each_part(offset, count, [](Reader& part, off_t part_offset, size_t n) {
+            part.will_need(part_offset, n);
+            return true;
+        });
+        return;
+    }
+    count = std::min(count, m_size - offset);
+#ifndef __WIN32__
+    if( m_map.is_mapped() ) {
+        const off_t start = offset & ~(off_t)0xfff; // madvise wants a page-aligned address
+        madvise((void*)(m_map.data() + start), count + (offset - start), MADV_WILLNEED);
+        return;
+    }
+#endif
+#if defined(__linux__)
+    posix_fadvise(m_fd, offset, count, POSIX_FADV_WILLNEED);
+#elif defined(__APPLE__)
+    struct radvisory ra = { .ra_offset = offset, .ra_count = (int)std::min<size_t>(count, INT_MAX) };
+    fcntl(m_fd, F_RDADVISE, &ra);
+#endif
+}
+
+/**
+ * @brief Drops an already processed range from the page cache.
+ *
+ * @param offset Start of the range.
+ * @param count Length of the range.
+ */
+void Reader::drop_behind(off_t offset, size_t count) {
+    if( m_direct || offset < 0 || (size_t)offset >= m_size || count == 0 ) {
+        return;
+    }
+    if( !m_parts.empty() ) {
+        for_each_part(offset, std::min(count, m_size - offset), [](Reader& part, off_t part_offset, size_t n) {
+            part.drop_behind(part_offset, n);
+            return true;
+        });
+        return;
+    }
+#ifndef __WIN32__
+    if( m_map.is_mapped() ) {
+        // only whole pages inside the range, the neighbours may still be in use
+        const off_t start = (offset + 0xfff) & ~(off_t)0xfff;
+        const off_t end = std::min<off_t>(offset + count, m_map.mapped_length()) & ~(off_t)0xfff;
+        if( end > start ) {
+            madvise((void*)(m_map.data() + start), end - start, MADV_DONTNEED);
+        }
+        return;
+    }
+#endif
+#if defined(__linux__)
+    posix_fadvise(m_fd, offset, count, POSIX_FADV_DONTNEED);
+#endif
+}
+
 /**
  * @brief Thread-safe positioned read for platforms without pread().
  *
@@ -191,11 +479,108 @@ ssize_t Reader::locked_read_at(void* buf, size_t count, off_t offset) {
     return static_cast<ssize_t>(total_read);
 }
 
+/**
+ * @brief Reads data from a specific file/device position (thread-safe).
+ *
+ * Without a bad region map this is read_at_impl(). With one, ranges known to
+ * be bad fail right away with ReadError, without touching the device. In
+ * salvage mode nothing is thrown: unreadable sectors are located by bisection,
+ * zero-filled and recorded in the map.
+ *
+ * @param offset File position to read from.
+ * @param buf Buffer to read into.
+ * @param count Number of bytes to read.
+ * @return Number of bytes actually read (may be less than count at EOF).
+ * @throws std::invalid_argument If offset is negative.
+ * @throws ReadError On read error, or if the range is known to be bad.
+ */
+size_t Reader::read_at(off_t offset, void* buf, size_t count) {
+    if( !m_bad_regions ) {
+        return read_at_impl(offset, buf, count);
+    }
+    if( m_salvage ) {
+        return read_salvage(offset, buf, count);
+    }
+    const auto [bad_start, bad_end] = m_bad_regions->find(offset, count);
+    if( bad_end > bad_start ) {
+        throw ReadError(fmt::format("offset {:#x}, count {:#x}: known bad region {:#x}..{:#x}", offset, count, bad_start, bad_end));
+    }
+    return read_at_impl(offset, buf, count);
+}
+
+/**
+ * @brief Reads a range, zero-filling whatever can't be read.
+ *
+ * Known bad regions are skipped without a read. On a ReadError the range is
+ * split in halves (aligned to the sector size) and each half is retried, so a
+ * few bad sectors in a large read cost a few dozen failing reads instead of
+ * one per sector. Bad sectors are recorded in the bad region map, if any.
+ *
+ * @param offset File position to read from.
+ * @param buf Buffer to read into.
+ * @param count Number of bytes to read.
+ * @return Number of bytes covered (less than count only at EOF).
+ * @throws std::invalid_argument If offset is negative.
+ */
+size_t Reader::read_salvage(off_t offset, void* buf, size_t count) {
+    if( offset < 0 ){
+        throw std::invalid_argument(fmt::format("offset < 0: {:#x}", offset));
+    }
+    if( (size_t)offset >= m_size ) {
+        return 0;
+    }
+    count = std::min(count, m_size - offset);
+    salvage_range(offset, static_cast<uint8_t*>(buf), count);
+    return count;
+}
+
+void Reader::salvage_range(off_t offset, uint8_t* buf, size_t count) {
+    if( count == 0 ) {
+        return;
+    }
+
+    if( m_bad_regions ) {
+        const auto [bad_start, bad_end] = m_bad_regions->find(offset, count);
+        if( bad_end > bad_start ) {
+            const off_t skip_start = std::max(bad_start, offset);
+            const off_t skip_end = std::min<off_t>(bad_end, offset + count);
+            salvage_range(offset, buf, skip_start - offset);
+            memset(buf + (skip_start - offset), 0, skip_end - skip_start);
+            salvage_range(skip_end, buf + (skip_end - offset), offset + count - skip_end);
+            return;
+        }
+    }
+
+    try {
+        size_t nread = read_at_impl(offset, buf, count);
+        if( nread < count ) {
+            memset(buf + nread, 0, count - nread);
+        }
+        return;
+    } catch (const ReadError& e) {
+        const size_t sector = std::max<size_t>(m_align, 512);
+        if( count <= sector ) {
+            logger->trace("{:#x}: {}", offset, e.what());
+            memset(buf, 0, count);
+            if( m_bad_regions ) {
+                m_bad_regions->add(offset, count);
+            }
+            return;
+        }
+        // split on a sector boundary
+        const off_t mid = ((offset + count / 2) / sector) * sector;
+        const size_t half = (mid > offset) ? mid - offset : sector;
+        salvage_range(offset, buf, half);
+        salvage_range(offset + half, buf + half, count - half);
+    }
+}
+
 /**
  * @brief Reads data from a specific file/device position (thread-safe).
  *
  * Performs positioned reads that are thread-safe. Automatically handles sector
- * alignment requirements for raw device access on Windows. Uses pread() on
+ * alignment requirements for raw device access on Windows and for direct I/O,
+ * where the buffer address must be aligned as well. Uses pread() on
  * Unix platforms and locked_read_at() on Windows.
  *
  * @param offset File position to read from.
@@ -205,7 +590,7 @@ ssize_t Reader::locked_read_at(void* buf, size_t count, off_t offset) {
  * @throws std::invalid_argument If offset is negative.
  * @throws ReadError On read error.
  */
-size_t Reader::read_at(off_t offset, void* buf, size_t count) {
+size_t Reader::read_at_impl(off_t offset, void* buf, size_t count) {
     if( offset < 0 ){
         throw std::invalid_argument(fmt::format("offset < 0: {:#x}", offset));
     }
@@ -213,10 +598,23 @@ size_t Reader::read_at(off_t offset, void* buf, size_t count) {
         return 0;
     }
 
-    if( m_align && (count % m_align || offset % m_align) ) {
-        std::vector<char> tmp(count + m_align*2);
+    if( m_map.is_mapped() ) {
+        count = std::min(count, m_map.size() - offset);
+        memcpy(buf, m_map.data() + offset, count);
+        return count;
+    }
+    if( !m_parts.empty() ) {
+        // parts align their own reads
+        return read_parts(offset, static_cast<uint8_t*>(buf), count);
+    }
+
+    if( m_align && (count % m_align || offset % m_align || (m_direct && (uintptr_t)buf % m_align)) ) {
         size_t shift = offset % m_align;
-        size_t nread = read_at(offset - shift, tmp.data(), (count + m_align*2) & ~(m_align-1));
+        pooled_buf_t tmp((shift + count + m_align - 1) & ~(m_align-1), std::max<size_t>(m_align, pooled_buf_t::DEFAULT_ALIGN));
+        size_t nread = read_at_impl(offset - shift, tmp.data(), tmp.size());
+        if( nread <= shift ) {
+            return 0;
+        }
         nread -= shift;
         if( (size_t)nread < count ) {
             count = nread;
@@ -244,3 +642,73 @@ size_t Reader::read_at(off_t offset, void* buf, size_t count) {
     }
     return nread;
 }
+
+/**
+ * @brief Reads a range of a concatenated source, crossing part boundaries as needed.
+ *
+ * @param offset Offset in the concatenated source, below m_size.
+ * @param buf Buffer to read into.
+ * @param count Number of bytes to read.
+ * @return Number of bytes read, less than count at EOF or if a part got shorter since it was opened.
+ * @throws ReadError On read error, the message names the failing part.
+ */
+size_t Reader::read_parts(off_t offset, uint8_t* buf, size_t count) {
+    size_t total = 0;
+    for_each_part(offset, std::min(count, m_size - offset), [&](Reader& part, off_t part_offset, size_t n) {
+        size_t nread = 0;
+        try {
+            nread = part.read_at(part_offset, buf + total, n);
+        } catch (const ReadError& e) {
+            throw ReadError(fmt::format("{} @ {:#x}: {}", part.m_fname, part_offset, e.what()));
+        }
+        total += nread;
+        return nread == n;
+    });
+    return total;
+}
+
+/**
+ * @brief Returns a read-only view of a file range.
+ *
+ * For mapped files the span points straight into the mapping and nothing is
+ * copied. Otherwise the range is read into the fallback buffer. In both cases the
+ * returned span is exactly count bytes long; bytes past EOF read as zero.
+ *
+ * @param offset File position of the range.
+ * @param count Length of the range.
+ * @param fallback Buffer used when the range can't be viewed in place.
+ * @return Span of count bytes, valid until the Reader or fallback changes.
+ * @throws std::invalid_argument If offset is negative.
+ * @throws ReadError On read error.
+ */
+std::span<const uint8_t> Reader::view(off_t offset, size_t count, buf_t& fallback) {
+    if( in_map(offset, count) ) {
+        return {m_map.data() + offset, count};
+    }
+    fallback.resize(count);
+    return read_zero_filled(offset, fallback.data(), count);
+}
+
+std::span<const uint8_t> Reader::view(off_t offset, size_t count, pooled_buf_t& fallback) {
+    if( in_map(offset, count) ) {
+        return {m_map.data() + offset, count};
+    }
+    fallback.resize(count);
+    return read_zero_filled(offset, fallback.data(), count);
+}
+
+bool Reader::in_map(off_t offset, size_t count) const {
+    if( offset < 0 ){
+        throw std::invalid_argument(fmt::format("offset < 0: {:#x}", offset));
+    }
+    return m_map.is_mapped() && (size_t)offset + count <= m_map.size();
+}
+
+// fallback buffers may be uninitialized, so the part past EOF is cleared explicitly
+std::span<const uint8_t> Reader::read_zero_filled(off_t offset, uint8_t* buf, size_t count) {
+    size_t nread = read_at(offset, buf, count);
+    if( nread < count ) {
+        memset(buf + nread, 0, count - nread);
+    }
+    return {buf, count};
+}
@@ -2,11 +2,17 @@
 #include <cstdint>
 #include <fcntl.h>
 #include <filesystem>
+#include <memory>
 #include <mutex>
+#include <span>
 #include <string>
 #include <vector>
 
+#include <mio/mmap.hpp>
+
 #include "core/buf_t.hpp"
+#include "core/BufferPool.hpp"
+#include "BadRegionMap.hpp"
 
 // an universal reader class, which can read from:
 //  - file
@@ -14,11 +20,28 @@
 //  - windows device (\\.\PhysicalDriveX) - sector alignment is done transparently
 //
 //  + also supports huge reads (>4GB) on windows
+//  + optional unbuffered mode (O_DIRECT on linux, F_NOCACHE on macos), alignment is done transparently too
+//  + optional memory-mapped mode for regular files, view() then hands out spans without copying
+//    (a mapped read of a bad sector is a SIGBUS, not a ReadError, so don't map failing media)
+//  + "@list.txt" reads the files listed in list.txt (one per line) as one concatenated source,
+//    e.g. a split dd image; reads spanning part boundaries are handled transparently
 //
 //  XXX seek() is not supported because sector alignment would be way too complex then
 class Reader {
     public:
-    Reader(const std::filesystem::path& fname);
+    enum EFlags {
+        RF_DIRECT = 1, // bypass the page cache
+        RF_MMAP   = 2, // map regular files into memory, ignored for devices and with RF_DIRECT
+    };
+
+    // how the source is going to be read, see advise()
+    enum class Access {
+        NORMAL,
+        SEQUENTIAL, // front to back: bigger kernel readahead
+        RANDOM,     // scattered blocks: no readahead, prefetch with will_need() instead
+    };
+
+    Reader(const std::filesystem::path& fname, int flags = 0);
     ~Reader();
 
     class ReadError : public std::runtime_error {
@@ -27,25 +50,79 @@ class Reader {
     };
 
     // either succeeds or throws an exception
+    // (never throws ReadError in salvage mode, see set_bad_regions())
     size_t read_at(off_t offset, void* buf, size_t count);
     size_t read_at(off_t offset, buf_t& buf) {
         return read_at(offset, buf.data(), buf.size());
     }
+    size_t read_at(off_t offset, pooled_buf_t& buf) {
+        return read_at(offset, buf.data(), buf.size());
+    }
+
+    // reads what can be read, unreadable sectors are found by bisection, zero-filled and added to the bad region map
+    size_t read_salvage(off_t offset, void* buf, size_t count);
+
+    // known bad regions are not read: read_at() throws ReadError right away,
+    // or, with salvage = true, read_at() behaves like read_salvage()
+    void set_bad_regions(std::shared_ptr<BadRegionMap> map, bool salvage = false) { m_bad_regions = std::move(map); m_salvage = salvage; }
+    const std::shared_ptr<BadRegionMap>& bad_regions() const { return m_bad_regions; }
+
+    // count bytes at offset, bytes past EOF are zero
+    // zero-copy if mapped, otherwise read into fallback (resized to count)
+    std::span<const uint8_t> view(off_t offset, size_t count, buf_t& fallback);
+    std::span<const uint8_t> view(off_t offset, size_t count, pooled_buf_t& fallback);
+
+    // access-pattern hints for the kernel, no-ops where unsupported or pointless (direct I/O)
+    // posix_fadvise() on linux, fcntl() on macos, madvise() for mapped files; never throw
+    void advise(Access access);
+    // start reading a range in the background, a later read_at() of it won't wait for the device
+    void will_need(off_t offset, size_t count);
+    // range won't be read again, drop it from the page cache so a long scan doesn't evict everything else
+    void drop_behind(off_t offset, size_t count);
+
+    // data extent [start, end) at or after offset, holes of sparse files are skipped;
+    // {size(), size()} if only a hole follows, {offset, size()} where holes can't be detected (devices, windows)
+    std::pair<off_t, off_t> data_extent(off_t offset);
 
     // get size of a regular file/device
     size_t size() const { return m_size; }
 
     size_t get_align() const { return m_align; }
 
-    // get size of file/*nix device/win device
+    int fd() const { return m_fd; } // -1 for a concatenated source
+    bool is_direct() const { return m_direct; }
+    bool is_mapped() const { return m_map.is_mapped(); }
+    bool is_concatenated() const { return !m_parts.empty(); }
+
+    // get size of file/*nix device/win device/concatenated source
     static size_t get_size(const std::filesystem::path& fname);
 
+    // "@list.txt" => parts listed in list.txt, relative pathnames are relative to its dir,
+    // empty lines and lines starting with '#' are skipped
+    static bool is_part_list(const std::filesystem::path& fname);
+    static std::vector<std::filesystem::path> read_part_list(const std::filesystem::path& fname);
+
     private :
     ssize_t locked_read_at(void* buf, size_t count, off_t offset);
+    size_t read_at_impl(off_t offset, void* buf, size_t count);
+    bool in_map(off_t offset, size_t count) const;
+    std::span<const uint8_t> read_zero_filled(off_t offset, uint8_t* buf, size_t count);
+    void salvage_range(off_t offset, uint8_t* buf, size_t count);
+    void open_parts(const std::filesystem::path& fname, int flags);
+    size_t read_parts(off_t offset, uint8_t* buf, size_t count);
+    template <typename F> void for_each_part(off_t offset, size_t count, F&& fn);
 
         std::filesystem::path m_fname;
         int m_fd = -1;
         size_t m_align = 0;
+        bool m_direct = false;
+        mio::ummap_source m_map;
         size_t m_size = 0;
         std::mutex m_mutex;
+        std::shared_ptr<BadRegionMap> m_bad_regions;
+        bool m_salvage = false;
+
+        // concatenated source: parts and their start offsets, ascending
+        std::vector<std::unique_ptr<Reader>> m_parts;
+        std::vector<off_t> m_part_starts;
 };
@@ -6,6 +6,15 @@
  * On Windows, it automatically enables sparse file support to efficiently handle
  * files with large zero regions. Handles large writes by chunking and provides
  * positioned write operations.
+ *
+ * Extraction writes one 1 MB block at a time. On network shares and ZFS these
+ * per-block syscalls limit throughput, so the buffered mode copies writes into
+ * 1 MB pooled chunks, coalesces file-contiguous ones into runs and writes each
+ * run with pwritev(), optionally on a background thread that writes one batch
+ * while the caller fills the next.
+ *
+ * Blocks that need no decoding can be copied from the source by the kernel
+ * (copy_from()), which also keeps them out of the write-back buffers.
  */
 
 #include "Writer.hpp"
@@ -13,8 +22,19 @@
 #include <spdlog/fmt/bundled/core.h>
 
 #include <fcntl.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
+#ifndef __WIN32__
+#include <climits>
+#include <sys/uio.h>
+#endif
+
+#include <algorithm>
+
+// buffered mode copies into chunks of this size, one iovec each
+static constexpr size_t CHUNK_SIZE = 1024 * 1024;
+
 #ifdef __WIN32__
 #include <windows.h>
 #include <winioctl.h>
@@ -41,6 +61,8 @@ Writer::Writer(const std::filesystem::path& fname, bool truncate) {
     if( m_fd == -1 ){
         throw std::runtime_error(fmt::format("Writer: _open_osfhandle: {}", strerror(errno)));
     }
+    m_orig_size = truncate ? 0 : lseek(m_fd, 0, SEEK_END);
+    lseek(m_fd, 0, SEEK_SET);
 }
 
 #else
@@ -60,6 +82,8 @@ Writer::Writer(const std::filesystem::path& fname, bool truncate) {
     if (m_fd == -1) {
         throw std::runtime_error(fmt::format("Writer: open(\"{}\", {:#x}, 0644): {}", fname.string(), mode, strerror(errno)));
     }
+    struct stat st;
+    m_orig_size = (fstat(m_fd, &st) == 0) ? st.st_size : 0;
 }
 
 #endif
@@ -67,11 +91,36 @@ Writer::Writer(const std::filesystem::path& fname, bool truncate) {
 /**
  * @brief Seeks to a position in the file.
  *
+ * In buffered mode only the logical position changes, SEEK_END flushes first.
+ *
  * @param offset Offset to seek to.
  * @param whence SEEK_SET, SEEK_CUR, or SEEK_END.
- * @throws std::runtime_error On lseek error.
+ * @throws std::runtime_error On lseek error or a negative resulting position.
  */
-void Writer::seek(off_t offset, int whence) const {
+void Writer::seek(off_t offset, int whence) {
+    if (!m_buffered) {
+        seek_fd(offset, whence);
+        return;
+    }
+
+    off_t base = 0;
+    if (whence == SEEK_CUR) {
+        base = m_pos;
+    } else if (whence == SEEK_END) {
+        flush();
+        struct stat st;
+        if (fstat(m_fd, &st) != 0) {
+            throw std::runtime_error(fmt::format("Writer: fstat({:#x}): {}", m_fd, strerror(errno)));
+        }
+        base = st.st_size;
+    }
+    if (base + offset < 0) {
+        throw std::runtime_error(fmt::format("Writer: seek({:#x}, {:#x}, {}): negative position", m_fd, offset, whence));
+    }
+    m_pos = base + offset;
+}
+
+void Writer::seek_fd(off_t offset, int whence) const {
     if (lseek(m_fd, offset, whence) == -1) {
         throw std::runtime_error(fmt::format("Writer: lseek({:#x}, {:#x}, {}): {}", m_fd, offset, whence, strerror(errno)));
     }
@@ -79,10 +128,13 @@ void Writer::seek(off_t offset, int whence) const {
 
 /**
  * @brief Gets the current file position.
- * @return Current file offset.
+ * @return Current file offset (the logical one in buffered mode).
  * @throws std::runtime_error On lseek error.
  */
 off_t Writer::tell() const {
+    if (m_buffered) {
+        return m_pos;
+    }
     off_t offset = lseek(m_fd, 0, SEEK_CUR);
     if (offset == -1) {
         throw std::runtime_error(fmt::format("Writer: lseek({:#x}, 0, SEEK_CUR): {}", m_fd, strerror(errno)));
@@ -98,7 +150,7 @@ off_t Writer::tell() const {
  * @param count Number of bytes to write.
  * @throws std::runtime_error On seek or write error.
  */
-void Writer::write_at(off_t offset, const void* buf, size_t count) const {
+void Writer::write_at(off_t offset, const void* buf, size_t count) {
     seek(offset, SEEK_SET);
     write(buf, count);
 }
@@ -106,6 +158,49 @@ void Writer::write_at(off_t offset, const void* buf, size_t count) const {
 /**
  * @brief Writes data to the file at the current position.
  *
+ * In buffered mode the data is copied and appended to the current batch, which
+ * is written out once it reaches the buffer size.
+ *
+ * @param buf Buffer containing data to write.
+ * @param count Number of bytes to write.
+ * @throws std::runtime_error On write error (in async mode possibly one of an earlier batch).
+ */
+void Writer::write(const void* buf, size_t count) {
+    if (!m_buffered) {
+        write_fd(buf, count);
+        return;
+    }
+
+    rethrow_error();
+    const uint8_t* ptr = static_cast<const uint8_t*>(buf);
+    while (count > 0) {
+        if (m_batch.chunks.empty() || m_batch.used == CHUNK_SIZE) {
+            m_batch.chunks.emplace_back(CHUNK_SIZE);
+            m_batch.used = 0;
+        }
+        if (m_batch.runs.empty() || m_batch.runs.back().offset + (off_t)m_batch.runs.back().size != m_pos) {
+            m_batch.runs.push_back({m_pos, 0, m_batch.chunks.size() - 1, m_batch.used});
+        }
+
+        const size_t n = std::min(count, CHUNK_SIZE - m_batch.used);
+        memcpy(m_batch.chunks.back().data() + m_batch.used, ptr, n);
+        m_batch.used += n;
+        m_batch.runs.back().size += n;
+        m_batch.bytes += n;
+        m_pos += n;
+        m_end = std::max(m_end, m_pos);
+        ptr += n;
+        count -= n;
+
+        if (m_batch.bytes >= m_buffer_size) {
+            submit_batch();
+        }
+    }
+}
+
+/**
+ * @brief Writes data at the current fd position.
+ *
  * Handles large writes by chunking into 1GB pieces. Automatically retries
  * on EINTR signal interruption.
  *
@@ -113,7 +208,7 @@ void Writer::write_at(off_t offset, const void* buf, size_t count) const {
  * @param count Number of bytes to write.
  * @throws std::runtime_error On write error or if write returns 0 bytes.
  */
-void Writer::write(const void* buf, size_t count) const {
+void Writer::write_fd(const void* buf, size_t count) const {
     constexpr size_t CHUNK_SIZE = 1ULL << 30; // 1 GB
     const char* ptr = static_cast<const char*>(buf);
     size_t remaining = count;
@@ -146,12 +241,368 @@ void Writer::write(const void* buf, size_t count) const {
     }
 }
 
+void Writer::pwrite_fd(off_t offset, const void* buf, size_t count) const {
+    seek_fd(offset, SEEK_SET);
+    write_fd(buf, count);
+}
+
+/**
+ * @brief Copies a source range to the current position inside the kernel.
+ *
+ * Tries copy_file_range() first (a reflink on btrfs/xfs), then splice() through
+ * a pipe. A method that fails as unsupported is not tried again. Buffered data
+ * overlapping the target range is written out first.
+ *
+ * @param src_fd Source file descriptor.
+ * @param src_offset Source offset.
+ * @param count Number of bytes to copy.
+ * @return True if everything was copied and the position advanced, false if the caller has to write the data.
+ * @throws std::runtime_error On write error of buffered data.
+ */
+bool Writer::copy_from(int src_fd, off_t src_offset, size_t count) {
+    if (m_copy_mode == CopyMode::NONE || src_fd == -1) {
+        return false;
+    }
+    const off_t offset = tell();
+    if (m_buffered) {
+        flush_range(offset, count);
+    }
+
+    size_t done = copy_fd(src_fd, src_offset, offset, count);
+    if (done < count && m_copy_mode == CopyMode::SPLICE) {
+        done += copy_fd(src_fd, src_offset + done, offset + done, count - done);
+    }
+    if (done < count) {
+        return false;
+    }
+
+    if (m_buffered) {
+        m_pos = offset + count;
+    } else {
+        seek_fd(offset + count, SEEK_SET);
+    }
+    m_end = std::max<off_t>(m_end, offset + count);
+    return true;
+}
+
+// buffered runs overlapping the range are written out first, they would overwrite the copy otherwise
+void Writer::flush_range(off_t offset, size_t count) {
+    auto overlaps = [&](const Batch& batch) {
+        return std::any_of(batch.runs.begin(), batch.runs.end(), [&](const Run& run) {
+            return run.offset < offset + (off_t)count && offset < run.offset + (off_t)run.size;
+        });
+    };
+    if (overlaps(m_batch)) {
+        flush();
+        return;
+    }
+    if (m_async) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (m_has_inflight && overlaps(m_inflight)) {
+            m_cv.wait(lock, [this] { return !m_has_inflight; });
+        }
+    }
+    rethrow_error();
+}
+
+// copies with the current m_copy_mode, switches to the next mode when it's unsupported
+// returns the number of bytes copied, less than count on EOF or any error
+size_t Writer::copy_fd(int src_fd, off_t src_offset, off_t offset, size_t count) {
+#ifdef __linux__
+    loff_t in_off = src_offset, out_off = offset;
+    size_t done = 0;
+    if (m_copy_mode == CopyMode::COPY_FILE_RANGE) {
+        while (done < count) {
+            ssize_t n = copy_file_range(src_fd, &in_off, m_fd, &out_off, count - done, 0);
+            if (n == -1 && errno == EINTR) {
+                continue;
+            }
+            if (n == -1 && (errno == EXDEV || errno == EINVAL || errno == ENOSYS || errno == EOPNOTSUPP || errno == EBADF)) {
+                logger->debug("Writer: copy_file_range(): {}, using splice()", strerror(errno));
+                m_copy_mode = CopyMode::SPLICE;
+            }
+            if (n <= 0) {
+                break;
+            }
+            done += n;
+        }
+        return done;
+    }
+
+    if (m_pipe[0] == -1) {
+        if (pipe(m_pipe) != 0) {
+            m_copy_mode = CopyMode::NONE;
+            return 0;
+        }
+        fcntl(m_pipe[1], F_SETPIPE_SZ, (int)CHUNK_SIZE); // default 64K, a bigger one takes a block in one go
+    }
+    while (done < count) {
+        ssize_t n = splice(src_fd, &in_off, m_pipe[1], nullptr, count - done, SPLICE_F_MOVE);
+        if (n == -1 && errno == EINTR) {
+            continue;
+        }
+        if (n == -1 && (errno == EINVAL || errno == ENOSYS)) {
+            logger->debug("Writer: splice(): {}, copying through userspace", strerror(errno));
+            m_copy_mode = CopyMode::NONE;
+        }
+        if (n <= 0) {
+            break;
+        }
+        // drain the pipe completely, it has to be empty for the next copy
+        for (ssize_t left = n; left > 0; ) {
+            ssize_t m = splice(m_pipe[0], nullptr, m_fd, &out_off, left, SPLICE_F_MOVE);
+            if (m == -1 && errno == EINTR) {
+                continue;
+            }
+            if (m <= 0) {
+                // can't write: no way to tell what is left in the pipe, so don't use it again
+                logger->debug("Writer: splice() to {:#x}: {}", m_fd, m == 0 ? "no progress" : strerror(errno));
+                m_copy_mode = CopyMode::NONE;
+                return done;
+            }
+            left -= m;
+        }
+        done += n;
+    }
+    return done;
+#else
+    (void)src_fd; (void)src_offset; (void)offset; (void)count;
+    m_copy_mode = CopyMode::NONE;
+    return 0;
+#endif
+}
+
+/**
+ * @brief Skips a range that must read as zeros.
+ *
+ * Ranges past the original file size are left as holes (the file is extended
+ * over trailing ones by close()). Ranges over data that existed when the file
+ * was opened are punched out, or zero-filled if the filesystem can't punch.
+ *
+ * @param count Number of bytes to skip.
+ * @throws std::runtime_error On seek or write error.
+ */
+void Writer::write_hole(size_t count) {
+    const off_t start = tell();
+    if (start < m_orig_size) {
+        punch_hole(start, std::min<size_t>(count, m_orig_size - start));
+    }
+    seek(start + count, SEEK_SET);
+    m_end = std::max<off_t>(m_end, start + count);
+}
+
+void Writer::punch_hole(off_t offset, size_t count) {
+    flush(); // buffered data in the range must land first
+
+#ifdef __linux__
+    if (fallocate(m_fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, offset, count) == 0) {
+        return;
+    }
+    logger->debug("Writer: fallocate(PUNCH_HOLE, {:#x}, {:#x}): {}, writing zeroes", offset, count, strerror(errno));
+#endif
+
+    static const std::vector<uint8_t> zeroes(CHUNK_SIZE);
+    for (size_t pos = 0; pos < count; pos += zeroes.size()) {
+        pwrite_fd(offset + pos, zeroes.data(), std::min(count - pos, zeroes.size()));
+    }
+}
+
+/**
+ * @brief Writes all runs of a batch, each with as few pwritev() calls as possible.
+ *
+ * @param batch Batch to write.
+ * @throws std::runtime_error On write error.
+ */
+void Writer::write_batch(Batch& batch) const {
+    for (const Run& run : batch.runs) {
+#ifdef __WIN32__
+        off_t offset = run.offset;
+        size_t remaining = run.size;
+        for (size_t i = run.first_chunk, pos = run.first_pos; remaining > 0; i++, pos = 0) {
+            const size_t n = std::min(remaining, CHUNK_SIZE - pos);
+            pwrite_fd(offset, batch.chunks[i].data() + pos, n);
+            offset += n;
+            remaining -= n;
+        }
+#else
+        std::vector<struct iovec> iov;
+        size_t remaining = run.size;
+        for (size_t i = run.first_chunk, pos = run.first_pos; remaining > 0; i++, pos = 0) {
+            const size_t n = std::min(remaining, CHUNK_SIZE - pos);
+            iov.push_back({batch.chunks[i].data() + pos, n});
+            remaining -= n;
+        }
+
+        off_t offset = run.offset;
+        for (size_t i = 0; i < iov.size(); ) {
+            const int cnt = (int)std::min<size_t>(iov.size() - i, IOV_MAX);
+            ssize_t nwritten = ::pwritev(m_fd, &iov[i], cnt, offset);
+            if (nwritten == -1) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw std::runtime_error(fmt::format("Writer: pwritev({:#x}, {} iovecs, {:#x}): {}", m_fd, cnt, offset, strerror(errno)));
+            }
+            if (nwritten == 0) {
+                throw std::runtime_error(fmt::format("Writer: pwritev({:#x}, {} iovecs, {:#x}): write returned 0 bytes", m_fd, cnt, offset));
+            }
+            offset += nwritten;
+            // skip fully written iovecs, adjust a partially written one
+            while (nwritten > 0 && (size_t)nwritten >= iov[i].iov_len) {
+                nwritten -= iov[i].iov_len;
+                i++;
+            }
+            if (nwritten > 0) {
+                iov[i].iov_base = static_cast<uint8_t*>(iov[i].iov_base) + nwritten;
+                iov[i].iov_len -= nwritten;
+            }
+        }
+#endif
+    }
+}
+
+/**
+ * @brief Enables write-back buffering.
+ *
+ * @param buffer_size Bytes collected before a batch is written out.
+ * @param async Write batches on a background thread.
+ */
+void Writer::set_buffered(size_t buffer_size, bool async) {
+    if (m_buffered) {
+        return;
+    }
+    m_pos = tell();
+    m_buffered = true;
+    m_buffer_size = std::max(buffer_size, CHUNK_SIZE);
+    m_async = async;
+    if (m_async) {
+        m_thread = std::thread(&Writer::writer_thr_proc, this);
+    }
+}
+
+// hands the current batch to the writer thread, or writes it right away
+void Writer::submit_batch() {
+    if (m_batch.runs.empty()) {
+        return;
+    }
+    if (!m_async) {
+        write_batch(m_batch);
+        m_batch = Batch();
+        return;
+    }
+
+    wait_idle();
+    rethrow_error();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_inflight = std::move(m_batch);
+        m_has_inflight = true;
+    }
+    m_cv.notify_all();
+    m_batch = Batch();
+}
+
+void Writer::wait_idle() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_cv.wait(lock, [this] { return !m_has_inflight; });
+}
+
+void Writer::rethrow_error() {
+    std::exception_ptr error;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::swap(error, m_error);
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+void Writer::writer_thr_proc() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+        m_cv.wait(lock, [this] { return m_has_inflight || m_stop; });
+        if (!m_has_inflight) {
+            return; // stopped
+        }
+
+        lock.unlock();
+        std::exception_ptr error;
+        try {
+            write_batch(m_inflight);
+        } catch (...) {
+            error = std::current_exception();
+        }
+        lock.lock();
+
+        if (error && !m_error) {
+            m_error = error;
+        }
+        m_inflight = Batch();
+        m_has_inflight = false;
+        m_cv.notify_all();
+    }
+}
+
+/**
+ * @brief Writes out all buffered data.
+ *
+ * @throws std::runtime_error On write error, including errors of earlier async batches.
+ */
+void Writer::flush() {
+    if (!m_buffered) {
+        return;
+    }
+    submit_batch();
+    if (m_async) {
+        wait_idle();
+    }
+    rethrow_error();
+}
+
+/**
+ * @brief Flushes and extends the file over trailing holes.
+ *
+ * Without this a file ending with skipped (sparse) blocks would be shorter than
+ * its logical size.
+ *
+ * @throws std::runtime_error On write or truncate error.
+ */
+void Writer::close() {
+    flush();
+    struct stat st;
+    if (m_end > 0 && fstat(m_fd, &st) == 0 && st.st_size < m_end) {
+        if (ftruncate(m_fd, m_end) != 0) {
+            throw std::runtime_error(fmt::format("Writer: ftruncate({:#x}, {:#x}): {}", m_fd, m_end, strerror(errno)));
+        }
+    }
+}
+
 /**
  * @brief Destructor closes the file descriptor if open.
  */
 Writer::~Writer() {
+    try {
+        close();
+    } catch (const std::exception& e) {
+        logger->error("{}", e.what());
+    }
+    if (m_thread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_cv.notify_all();
+        m_thread.join();
+    }
     if( m_fd != -1 ){
-        close(m_fd);
+        ::close(m_fd);
         m_fd = -1;
     }
+    for (int& fd : m_pipe) {
+        if (fd != -1) {
+            ::close(fd);
+            fd = -1;
+        }
+    }
 }
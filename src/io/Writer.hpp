@@ -1,18 +1,100 @@
 #pragma once
+#include <condition_variable>
+#include <exception>
 #include <filesystem>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "core/BufferPool.hpp"
 
 // mostly for writing sparse files transparently on windows
 // also writes huge files transparently, i.e. at least on windows write() fails to write a chunk larger than 4GB
+//
+// optional write-back mode (set_buffered()): writes are copied into memory, consecutive ones are coalesced
+// and written out with a few large pwritev() calls, optionally from a background thread
 class Writer {
     public:
+    static constexpr size_t DEFAULT_BUFFER_SIZE = 32 * 1024 * 1024;
+
     Writer(const std::filesystem::path& fname, bool truncate = true);
     ~Writer();
 
-    void seek(off_t offset, int whence = SEEK_SET) const;
-    void write(const void* buf, size_t count) const;
-    void write_at(off_t offset, const void* buf, size_t count) const;
+    Writer(const Writer&) = delete;
+    Writer& operator=(const Writer&) = delete;
+
+    // must be called before the first write
+    // async: a background thread writes one batch while the next one is filled,
+    // its errors are thrown from a later write(), flush() or close()
+    void set_buffered(size_t buffer_size = DEFAULT_BUFFER_SIZE, bool async = true);
+
+    void seek(off_t offset, int whence = SEEK_SET);
+    void write(const void* buf, size_t count);
+    void write_at(off_t offset, const void* buf, size_t count);
     off_t tell() const;
 
+    // copies count bytes of src_fd at src_offset to the current position without passing them through
+    // userspace: copy_file_range(), or splice() through a pipe where the filesystems don't support it.
+    // false if that's not possible (other platforms, O_DIRECT source, short source), nothing is written
+    // then as far as the position is concerned, the caller writes the data itself
+    bool copy_from(int src_fd, off_t src_offset, size_t count);
+
+    // skips count bytes that must read as zeros: a hole in a new file,
+    // punched (or zero-filled where punching is unsupported) over data that existed before
+    void write_hole(size_t count);
+
+    // writes out buffered data
+    void flush();
+    // flush() and extend the file over trailing holes, the destructor does the same but only logs errors
+    void close();
+
     private:
+    // file-contiguous range of buffered data
+    struct Run {
+        off_t offset;
+        size_t size;
+        size_t first_chunk; // index into Batch::chunks
+        size_t first_pos;   // start within that chunk
+    };
+    struct Batch {
+        std::vector<pooled_buf_t> chunks;
+        size_t used = 0; // bytes used in chunks.back()
+        std::vector<Run> runs;
+        size_t bytes = 0;
+    };
+
+    void seek_fd(off_t offset, int whence) const;
+    void write_fd(const void* buf, size_t count) const;
+    void pwrite_fd(off_t offset, const void* buf, size_t count) const;
+    void punch_hole(off_t offset, size_t count);
+    void flush_range(off_t offset, size_t count);
+    size_t copy_fd(int src_fd, off_t src_offset, off_t offset, size_t count);
+    void write_batch(Batch& batch) const;
+    void submit_batch();
+    void wait_idle();
+    void rethrow_error();
+    void writer_thr_proc();
+
     int m_fd = -1;
+    off_t m_orig_size = 0; // size when opened, holes below it must be punched
+    off_t m_end = 0;       // logical end, incl. trailing holes
+
+    bool m_buffered = false;
+    bool m_async = false;
+    size_t m_buffer_size = 0;
+    off_t m_pos = 0;       // logical position in buffered mode
+    Batch m_batch;         // being filled
+
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    Batch m_inflight;      // being written by m_thread
+    bool m_has_inflight = false;
+    bool m_stop = false;
+    std::exception_ptr m_error;
+
+    // copy_from() falls back from copy_file_range() to splice() to nothing once a method is unsupported
+    enum class CopyMode : uint8_t { COPY_FILE_RANGE, SPLICE, NONE };
+    CopyMode m_copy_mode = CopyMode::COPY_FILE_RANGE;
+    int m_pipe[2] = {-1, -1};
 };
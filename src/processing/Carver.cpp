@@ -10,16 +10,13 @@
 
 #include <cstring>
 #include <iomanip>
-#include <sys/stat.h>
-#include <fcntl.h>
-#include <unistd.h>
-#include <errno.h>
 #include <chrono>
 #include "lz4.h"
 
 #include "core/CMeta.hpp"
 #include "Carver.hpp"
 #include "io/Reader.hpp"
+#include "scanning/PatternSearch.hpp"
 #include "utils/units.hpp"
 
 extern "C" {
@@ -29,117 +26,35 @@ extern "C" {
 /**
  * @brief Constructs a Carver and initializes internal buffers.
  */
-Carver::Carver() 
-    #ifdef _WIN32
-        : fd(INVALID_HANDLE_VALUE)
-    #else
-        : fd(-1)
-    #endif
-    {
-    buf.resize(BLOCK_SIZE_CARVER * 2);
-    prevBuf.resize(BLOCK_SIZE_CARVER * 2);
-    lzBuf2.resize(BLOCK_SIZE_CARVER * 2);
-    std::memset(prevBuf.data(), 0, prevBuf.size());
+Carver::Carver() : lzBuf2(BLOCK_SIZE_CARVER * 2, pooled_buf_t::DEFAULT_ALIGN, true) {
 }
 
 Carver::~Carver() {
-    #ifdef _WIN32
-        if (fd != INVALID_HANDLE_VALUE) {
-            CloseHandle(fd);
-        }
-    #else
-        if (fd != -1) {
-            close(fd);
-        }
-    #endif
-    
     if (fOut.is_open()) fOut.close();
     if (fOutM.is_open()) fOutM.close();
 }
 
-bool Carver::OpenInput(const std::string& path, int64_t offset) {
+/**
+ * @brief Opens the source file or device.
+ *
+ * @param path Path to the file or device.
+ * @param offset Offset to start carving from.
+ * @param reader_flags Reader::EFlags passed to the Reader, e.g. RF_DIRECT.
+ * @return True on success.
+ * @throws std::runtime_error If the source cannot be opened.
+ */
+bool Carver::OpenInput(const std::string& path, int64_t offset, int reader_flags) {
     startOffset = offset;
-
-    return OpenFile(path);
-}
-
-bool Carver::OpenFile(const std::string& filePath) {
-    #ifdef _WIN32
-        if (filePath.substr(0, 4) == "\\\\.\\") {
-            fd = CreateFileA(
-                filePath.c_str(),
-                GENERIC_READ,
-                FILE_SHARE_READ | FILE_SHARE_WRITE,
-                NULL,
-                OPEN_EXISTING,
-                FILE_ATTRIBUTE_NORMAL,
-                NULL
-            );
-            
-            if (fd == INVALID_HANDLE_VALUE) {
-                throw std::runtime_error("Failed to open physical drive: " + std::to_string(GetLastError()));
-            }
-        } else {
-            fd = CreateFileA(
-                filePath.c_str(), 
-                GENERIC_READ,
-                FILE_SHARE_READ,
-                NULL,
-                OPEN_EXISTING,
-                FILE_ATTRIBUTE_NORMAL,
-                NULL
-            );
-        }
-        
-        if (fd == INVALID_HANDLE_VALUE) {
-            throw std::runtime_error("Failed to open file: " + std::to_string(GetLastError()));
-        }
-        
-        LARGE_INTEGER size;
-        if (!GetFileSizeEx(fd, &size)) {
-            DISK_GEOMETRY_EX geometry;
-            DWORD bytesReturned;
-            if (!DeviceIoControl(
-                    fd,
-                    IOCTL_DISK_GET_DRIVE_GEOMETRY_EX,
-                    NULL,
-                    0,
-                    &geometry,
-                    sizeof(geometry),
-                    &bytesReturned,
-                    NULL)) {
-                throw std::runtime_error("Failed to get drive geometry: " + std::to_string(GetLastError()));
-            }
-            diskSize = geometry.DiskSize.QuadPart;
-        } else {
-            diskSize = size.QuadPart;
-        }
-    #else
-        fd = open(filePath.c_str(), O_RDONLY);
-        if (fd == -1) {
-            throw std::runtime_error("Failed to open file: " + std::string(strerror(errno)));
-        }
-        diskSize = Reader::get_size(filePath);
-    #endif
-
-    return SetFilePointerEx(fd, startOffset);
-}
-
-bool Carver::SetFilePointerEx(
-    #ifdef _WIN32
-        HANDLE fileHandle,
-    #else
-        int fileHandle,
-    #endif
-    int64_t offset) {
-    
-    #ifdef _WIN32
-        LARGE_INTEGER li;
-        li.QuadPart = offset;
-        return ::SetFilePointerEx(fileHandle, li, NULL, FILE_BEGIN) != 0;
-    #else
-        return lseek(fileHandle, offset, SEEK_SET) != -1;
-    #endif
+    m_reader = std::make_unique<Reader>(path, reader_flags);
+    diskSize = m_reader->size();
+    m_reader->advise(Reader::Access::SEQUENTIAL);
+
+    // aligned so direct reads can go straight into it, scanned byte by byte so on huge pages if possible
+    buf = pooled_buf_t(BLOCK_SIZE_CARVER * 2, std::max(m_reader->get_align(), pooled_buf_t::DEFAULT_ALIGN), true);
+    std::memset(buf.data(), 0, buf.size());
+    logger->info("buffers: {} on {}, {} on {}", bytes2human(buf.size()), page_mode_name(buf.page_mode()),
+        bytes2human(lzBuf2.size()), page_mode_name(lzBuf2.page_mode()));
+    return true;
 }
 
 bool Carver::OpenOutputFiles(const std::string& baseOutputPath) {
@@ -168,26 +83,53 @@ std::string Carver::CalculateMD5(const unsigned char* data, size_t length) {
 
 void Carver::Process() {
     bool firstRead = true;
+    bool prevHole = false;
     uint32_t flip = 0;
+    uint64_t holeBytes = 0;
+
+    // candidate offsets of both kinds in one pass over the chunk instead of probing every byte
+    PatternSearch search;
+    std::vector<PatternSearch::Match> matches;
+    const uint8_t lzId = m_find_data_blocks ? search.add(signatures::lz_hdr()) : UINT8_MAX;
+    if (m_find_empty_blocks) {
+        search.add(signatures::empty_block_digest());
+    }
 
     while (diskReaden < diskSize) {
         size_t toRead = std::min(static_cast<size_t>(BLOCK_SIZE_CARVER), 
                                 static_cast<size_t>(diskSize - diskReaden));
-                                
-        #ifdef _WIN32
-            DWORD bytesRead;
-            if (!ReadFile(fd, buf.data() + flip, toRead, &bytesRead, NULL)) {
-                throw std::runtime_error("Read failed: " + std::to_string(GetLastError()));
+
+        // chunks inside a hole of a sparse source are zeros, nothing to read.
+        // The first one still scans the tail of the previous chunk, the following ones are skipped as a whole.
+        const off_t pos = startOffset + diskReaden;
+        const uint64_t hole = std::max<off_t>(m_reader->data_extent(pos).first - pos, 0);
+        const bool isHole = hole >= toRead;
+        if (isHole && prevHole) {
+            const uint64_t skip = std::max<uint64_t>(hole / BLOCK_SIZE_CARVER * BLOCK_SIZE_CARVER, toRead);
+            diskReaden += skip;
+            holeBytes += skip;
+            continue;
+        }
+
+        size_t bytesRead = toRead;
+        if (isHole) {
+            std::memset(buf.data() + flip, 0, BLOCK_SIZE_CARVER);
+            holeBytes += toRead;
+        } else {
+            if (diskReaden + toRead < diskSize) {
+                m_reader->will_need(startOffset + diskReaden + toRead, BLOCK_SIZE_CARVER);
             }
+            bytesRead = m_reader->read_at(startOffset + diskReaden, buf.data() + flip, toRead);
             if (bytesRead == 0) {
                 break;
             }
-        #else
-            ssize_t bytesRead = read(fd, buf.data() + flip, toRead);
-            if (bytesRead <= 0) {
-                break;
+            // already copied into buf, never read again
+            m_reader->drop_behind(startOffset + diskReaden, bytesRead);
+            if (bytesRead < BLOCK_SIZE_CARVER) {
+                std::memset(buf.data() + flip + bytesRead, 0, BLOCK_SIZE_CARVER - bytesRead);
             }
-        #endif
+        }
+        prevHole = isHole;
 
         // Start processing a little before the end of the last block so you can catch patterns between blocks
         uint32_t startPos;
@@ -199,12 +141,13 @@ void Carver::Process() {
             startPos = flip - (V_BLOCK_SIZE + sizeof(lz_hdr));
         }
 
-        for (uint32_t i = startPos; i < flip + BLOCK_SIZE_CARVER - sizeof(LZ_START_MAGIC); i++) {
-            while (m_find_data_blocks) {
+        const uint32_t scanEnd = isHole ? flip : flip + BLOCK_SIZE_CARVER - sizeof(LZ_START_MAGIC); // zeros match nothing
+        matches.clear();
+        search.find(std::span<const uint8_t>(buf.data(), buf.size()), matches, startPos, scanEnd);
+        for (const auto& m : matches) {
+            const uint32_t i = m.pos;
+            if (m.id == lzId) {
                 const lz_hdr* plz = (const lz_hdr*)(&buf[i]);
-                if (!plz->valid())
-                    break;
-
                 uint64_t qOffset = diskReaden + i + startOffset - flip;
 
                 if (i + (V_BLOCK_SIZE - sizeof(lz_hdr)) <= buf.size()) {
@@ -228,14 +171,9 @@ void Carver::Process() {
                         m_iter_data_blocks_found++;
                     }
                 }
-                break;
-            }
-            
-            if (m_find_empty_blocks) {
-                if (i + sizeof(EMPTY_BLOCK_DIGEST) <= buf.size() && *(digest_t*)(&buf[i]) == EMPTY_BLOCK_DIGEST) {
-                    szBufM += "M;" + IntToHex(diskReaden + i + startOffset) + "\r\n";
-                    m_iter_empty_blocks_found++;
-                }
+            } else {
+                szBufM += "M;" + IntToHex(diskReaden + i + startOffset) + "\r\n";
+                m_iter_empty_blocks_found++;
             }
         }
         
@@ -251,6 +189,9 @@ void Carver::Process() {
     }
     WriteResults();
     UpdateProgress();
+    if (holeBytes > 0) {
+        logger->info("skipped {} of holes", bytes2human(holeBytes));
+    }
 }
 
 void Carver::WriteResults() {
@@ -1,37 +1,27 @@
 #include <cstdint>
 #include <fstream>
 #include <iostream>
+#include <memory>
 #include <string>
 #include <sys/types.h>
 #include <vector>
 
-#ifdef _WIN32
-#include <windows.h>
-#include <winioctl.h>
-#endif
-
 #include "MD5.hpp"
+#include "core/BufferPool.hpp"
+#include "io/Reader.hpp"
 
 class Carver {
 public:
     Carver();
     ~Carver();
 
-    bool OpenInput(const std::string& path, int64_t offset);
+    // reader_flags: Reader::EFlags, e.g. Reader::RF_DIRECT to bypass the page cache
+    bool OpenInput(const std::string& path, int64_t offset, int reader_flags = 0);
     bool OpenOutputFiles(const std::string& baseOutputPath);
     void Process();
     std::vector<std::string> stats() const;
 
 private:
-    bool OpenFile(const std::string& filePath);
-    bool SetFilePointerEx(
-    #ifdef _WIN32
-        HANDLE fileHandle,
-    #else
-        int fileHandle, 
-    #endif
-    int64_t offset);
-
     void WriteResults();
     void UpdateProgress();
     std::string IntToHex(uint64_t value, int width = 8);
@@ -39,13 +29,10 @@ private:
     std::string CalculateMD5(const unsigned char* data, size_t length);
 
     std::ofstream fOut, fOutM;
-    buf_t buf, prevBuf, lzBuf2;
+    pooled_buf_t buf;
+    pooled_buf_t lzBuf2;
 
-    #ifdef _WIN32
-        HANDLE fd;
-    #else
-        int fd;
-    #endif
+    std::unique_ptr<Reader> m_reader;
 
     bool m_find_empty_blocks = true;
     bool m_find_data_blocks = true;
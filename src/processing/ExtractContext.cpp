@@ -149,6 +149,7 @@ void ExtractContext::process_file(const std::string& pathname, const CMeta::VFil
             logger->warn("{} type is \"{}\" but source doesn't exist", vFile.name, vFile.type_str());
         }
         writer.emplace(out_fname, should_truncate);
+        writer->set_buffered(); // blocks are coalesced into big writes, written in the background
         
         if (blocks_to_skip > 0 && writer) {
             off_t resume_offset = blocks_to_skip * BLOCK_SIZE;
@@ -163,12 +164,33 @@ void ExtractContext::process_file(const std::string& pathname, const CMeta::VFil
 
     VAllBlocks vAllB = meta.get_file_blocks(vFile);
 
-    buf_t lzBuf;
-    buf_t lzBuf2;
+    // not zero-filled on resize, every block overwrites them
+    pooled_buf_t lzBuf;
+    pooled_buf_t lzBuf2;
     int64_t remaining_size = vFile.attribs.filesize;
     off_t prev_pos = 0;
     uint8_t prev_device_id = 255;
 
+    // sources are opened with Access::RANDOM (no readahead), so ranges of the next few blocks
+    // are handed to the kernel ahead of time and read while the current one is unpacked
+    constexpr size_t PREFETCH_BLOCKS = 8;
+    size_t prefetched = 0; // blocks below this index were already prefetched
+    auto prefetch = [&](const VBlockDesc& b) {
+        if( b.is_empty() || no_read || (!writer && m_cache.contains(b.hash)) ){
+            return;
+        }
+        if( exHT ){
+            if( const auto* e = exHT.findHash(b.hash) ){
+                Reader* src = have_vbk ? vbkf.get() : (e->device_index < device_files.size() ? device_files[e->device_index].get() : nullptr);
+                if( src ){
+                    src->will_need(vbk_offset + e->offset, e->comp_size + sizeof(lz_hdr) + 0x10);
+                }
+            }
+        } else if( const auto it = bds.find(b.hash); it != bds.end() && vbkf ){
+            vbkf->will_need(vbk_offset + it->second.offset, it->second.allocSize);
+        }
+    };
+
     if( vAllB.size() > (size_t)vFile.attribs.nBlocks ){
         logger->warn("vAllB.size() {:x} > vFile.attribs.nBlocks {:x}", vAllB.size(), vFile.attribs.nBlocks);
     } else {
@@ -180,17 +202,22 @@ void ExtractContext::process_file(const std::string& pathname, const CMeta::VFil
         if (i < blocks_to_skip) {
             continue;
         }
+        for( prefetched = std::max(prefetched, i + 1); prefetched < std::min(i + 1 + PREFETCH_BLOCKS, vAllB.size()); prefetched++ ){
+            prefetch(vAllB[prefetched]);
+        }
         
         if( remaining_size <= 0 ){
             logger->warn_once("Remaining size <= 0: {}", remaining_size);
         }
         size_t skip_size = 0;
+        bool sparse = false;
         const VBlockDesc& blk = vAllB[i];
         logger->trace("Block #{:06x}: {}", i, blk.to_string());
         do {
             if( blk.is_empty() ) {
                 // empty block, no need to lookup in any table
                 fti.sparse_blocks++;
+                sparse = true;
                 skip_size = BLOCK_SIZE;
                 break;
             }
@@ -286,9 +313,29 @@ void ExtractContext::process_file(const std::string& pathname, const CMeta::VFil
                 break;
             }
 
+            if (writer && effective_comp_type == CT_NONE && !effective_keyset) {
+                // nothing to decode: the kernel copies the block from the source straight to the output file.
+                // CT_NONE blocks are not verified on the read path either, so nothing is lost
+                const size_t to_copy = (remaining_size > 0 && remaining_size < (int64_t)effective_allocSize) ? remaining_size : effective_allocSize;
+                const auto& bad = active_file.bad_regions();
+                if ((!bad || !bad->overlaps(vbk_offset + pos, to_copy)) && writer->copy_from(active_file.fd(), vbk_offset + pos, to_copy)) {
+                    actual_written += to_copy;
+                    remaining_size -= to_copy;
+                    fti.nOK++;
+                    m_cache.insert(blkDesc.digest);
+                    prev_pos = 0; // lzBuf doesn't hold this block
+                    break;
+                }
+            }
+
             if(prev_pos == 0 || pos != prev_pos || effective_allocSize != lzBuf.size() || (!have_vbk && !device_files.empty() && (prev_device_id != cur_device_id))){ // If we have multiple device files, don't mix reads from different files at the same position.
                 lzBuf.resize(effective_allocSize);
-                ssize_t nread = active_file.read_at(vbk_offset + pos, lzBuf);
+                ssize_t nread = 0;
+                try {
+                    nread = active_file.read_at(vbk_offset + pos, lzBuf);
+                } catch (const Reader::ReadError& e) {
+                    logger->error("{}", e.what());
+                }
                 if( nread != effective_allocSize){
                     logger->critical("read error at {:012x}: nread={:x}, sizeof(fBuf)={:x}", vbk_offset+pos, nread, effective_allocSize);
                     fti.nReadErr++;
@@ -304,7 +351,7 @@ void ExtractContext::process_file(const std::string& pathname, const CMeta::VFil
                         skip_size = BLOCK_SIZE;
                         break;
                     }
-                    cipher->decrypt(lzBuf);
+                    lzBuf.resize(cipher->decrypt(lzBuf.data(), lzBuf.size(), true));
                 }
                 prev_pos = pos; // massive speedup in case of consecutive identical/empty blocks
                 prev_device_id = cur_device_id;
@@ -337,6 +384,11 @@ void ExtractContext::process_file(const std::string& pathname, const CMeta::VFil
                                 (char*) lzBuf2.data(),
                                 comp_size,
                                 lzBuf2.size());
+                            if( (size_t)lz4res != lzBuf2.size() ){
+                                // don't write leftovers of previous blocks
+                                const size_t ndecoded = lz4res > 0 ? std::min<size_t>(lz4res, lzBuf2.size()) : 0;
+                                memset(lzBuf2.data() + ndecoded, 0, lzBuf2.size() - ndecoded);
+                            }
 
                             to_write = (remaining_size > 0 && remaining_size < plz->srcSize) ? remaining_size : plz->srcSize;
                             if( writer ){
@@ -485,7 +537,12 @@ void ExtractContext::process_file(const std::string& pathname, const CMeta::VFil
 
         if( skip_size > 0 ){
             if( writer ){
-                writer->seek(skip_size, SEEK_CUR); // seek instead of write-zeroes to make sparse file
+                if( sparse && !vFile.is_diff() ){
+                    // sparse, zeroes if the file had data there, the file is extended up to its size on close()
+                    writer->write_hole(std::clamp<int64_t>(remaining_size, 0, skip_size));
+                } else {
+                    writer->seek(skip_size, SEEK_CUR); // leave whatever is there (diffs, unreadable blocks)
+                }
             }
             remaining_size -= skip_size;
         }
@@ -523,6 +580,7 @@ void ExtractContext::process_file(const std::string& pathname, const CMeta::VFil
     }
 
     if( writer ){
+        writer->close(); // surfaces background write errors
         if( writer->tell() == actual_written ){
             logger->info("saved {} to \"{}\"",
                 bytes2human(actual_written, " bytes"),
@@ -1,22 +1,45 @@
 #include <thread>
-#include <mutex>
-#include <condition_variable>
 #include <vector>
 #include <atomic>
 #include <fstream>
+#include <memory>
+#include <span>
 
 #include "utils/common.hpp"
 #include "utils/Progress.hpp"
+#include "core/BufferPool.hpp"
 #include "io/Reader.hpp"
+#include "io/ReadQueue.hpp"
+#include "io/FileWriteQueue.hpp"
 #include "io/Writer.hpp"
 
+// reads the source into a ring of buffers on one thread and scans them on another
+// the name is historical: the ring holds 2 buffers by default, set_buffers() makes it deeper
 class DblBufScanner {
     public:
 
-    explicit DblBufScanner(const std::string& fname, off_t start = 0, size_t block_size = 8*1024*1024) :
-            m_fname(fname), m_block_size(block_size), m_start(start), m_reader(fname), m_progress(m_reader.size(), start) {
-        m_buffers[0].resize(m_block_size);
-        m_buffers[1].resize(m_block_size);
+    // reader_flags: Reader::EFlags, e.g. Reader::RF_DIRECT to bypass the page cache
+    explicit DblBufScanner(const std::string& fname, off_t start = 0, size_t block_size = 8*1024*1024, int reader_flags = 0) :
+            m_fname(fname), m_block_size(block_size), m_start(start), m_reader(fname, reader_flags), m_progress(m_reader.size(), start) {
+        if (!m_reader.is_mapped()) {
+            // regions found unreadable by earlier runs are not read again, new ones are appended
+            m_bad_regions = std::make_shared<BadRegionMap>(get_out_pathname(fname, "bad_regions.csv"));
+            m_reader.set_bad_regions(m_bad_regions);
+        }
+    }
+
+    // split each block into queue_depth concurrent reads (io_uring on linux), 1 = single pread
+    void set_queue_depth(unsigned depth) { m_queue_depth = std::max(depth, 1u); }
+
+    // stop scanning at end (exclusive), 0 = EOF
+    // objects starting before end are still read to completion, so adjacent ranges can be scanned independently
+    void set_end(off_t end) { m_end = end; }
+
+    // number of read-ahead buffers and their size, must be called before scan()
+    // more buffers let the reader run ahead while the scanner is busy with slow blocks
+    void set_buffers(size_t count, size_t block_size) {
+        m_ring_size = std::max<size_t>(count, 2);
+        m_block_size = std::max<size_t>((block_size + 0xfff) & ~0xfffULL, 0x1000);
     }
 
     void scan() {
@@ -27,6 +50,26 @@ class DblBufScanner {
 
     protected:
     void virtual start() {
+        // read once front to back: big readahead, processed buffers are dropped from the page cache
+        m_reader.advise(Reader::Access::SEQUENTIAL);
+        if (m_reader.is_mapped()) {
+            // nothing to read, the scan thread walks the mapping directly
+            m_scan_thread = std::thread(&DblBufScanner::mapped_thr_proc, this);
+            return;
+        }
+        // aligned so direct reads can go straight into them
+        const size_t align = std::max(m_reader.get_align(), pooled_buf_t::DEFAULT_ALIGN);
+        m_ring.clear();
+        for (size_t i = 0; i < m_ring_size; i++) {
+            // scanned byte by byte, huge pages save a lot of TLB misses
+            m_ring.emplace_back(m_block_size, align, true);
+        }
+        logger->info("read buffers: {} x {} on {}", m_ring_size, bytes2human(m_block_size), page_mode_name(m_ring.front().page_mode()));
+        m_offsets.assign(m_ring_size, 0);
+        m_holes.assign(m_ring_size, 0);
+        m_head = 0;
+        m_tail = 0;
+
         m_read_thread = std::thread(&DblBufScanner::read_thr_proc, this);
         m_scan_thread = std::thread(&DblBufScanner::scan_thr_proc, this);
     }
@@ -39,18 +82,28 @@ class DblBufScanner {
 
     protected:
     const std::string m_fname;
-    const size_t m_block_size;
+    size_t m_block_size;
     const off_t m_start;
+    off_t m_end = 0;
 
-    private:
-    buf_t m_buffers[2];
-    bool m_buf_ready[2] = {false, false};
-    off_t m_offsets[2];
-
-    std::mutex m_buffer_mutex;
-    std::condition_variable m_buffer_cv;
+    off_t end_offset() const {
+        return (m_end > 0 && (size_t)m_end < m_reader.size()) ? m_end : (off_t)m_reader.size();
+    }
 
-    std::atomic<bool> m_done = false;
+    private:
+    unsigned m_queue_depth = 1;
+
+    // single producer (read thread), single consumer (scan thread)
+    // slot for sequence number n is n % m_ring_size
+    // m_head: number of filled buffers, written only by the reader, RING_EOF is set after the last one
+    // m_tail: number of processed buffers, written only by the scanner
+    static constexpr uint64_t RING_EOF = 1ULL << 63;
+    size_t m_ring_size = 2;
+    std::vector<pooled_buf_t> m_ring;
+    std::vector<off_t> m_offsets;
+    std::vector<size_t> m_holes; // non-zero: the slot is a hole of that size, its buffer is unused
+    std::atomic<uint64_t> m_head = 0;
+    std::atomic<uint64_t> m_tail = 0;
 
     protected:
     Reader m_reader;
@@ -61,141 +114,253 @@ class DblBufScanner {
     std::thread m_read_thread;
     std::thread m_scan_thread;
 
-    size_t try_read_by_sector(off_t pos, uint8_t* buf, size_t size) {
-        size_t sector_size = m_reader.get_align();
-        if (sector_size <= 1) {
-            sector_size = 512;
-        }
+    std::shared_ptr<BadRegionMap> m_bad_regions;
 
-        memset(buf, 0, size);
-        size_t nread = 0;
-        while(nread < size) {
-            try {
-                size_t nr = m_reader.read_at(pos + nread, buf + nread, std::min(size - nread, sector_size));
-                if (nr == 0)
-                    break;
-                nread += nr;
-            } catch (const Reader::ReadError& e) {
-                logger->trace("{:#x}: {}", pos + nread, e.what());
-                nread += sector_size; // skip sector
+    // holes of sparse sources are skipped without reading, smaller ones aren't worth splitting a read
+    static constexpr off_t MIN_HOLE_SIZE = 0x100000;
+    static constexpr off_t HOLE_ALIGN = 0x1000;
+    size_t m_hole_bytes = 0;
+    size_t m_skipped_bytes = 0; // find_skip()
+
+    // returns the end of the hole at pos (whole pages, at least MIN_HOLE_SIZE unless it reaches end),
+    // or pos if data follows; then data_end is set to where the data ends, reads shouldn't cross it
+    off_t find_hole(off_t pos, off_t end, off_t& data_end) {
+        auto [start, stop] = m_reader.data_extent(pos);
+        if (start >= end) {
+            return end;
+        }
+        const off_t hole_end = start & ~(HOLE_ALIGN - 1);
+        if (hole_end - pos >= MIN_HOLE_SIZE) {
+            return hole_end;
+        }
+        // small holes are read as data, up to the end of the next buffer
+        while (stop < end && stop < pos + (off_t)m_block_size) {
+            const auto [next_start, next_stop] = m_reader.data_extent(stop);
+            if (next_start >= end || next_start - stop >= MIN_HOLE_SIZE) {
+                break;
             }
+            stop = next_stop;
         }
-        return nread;
+        data_end = std::min(end, (stop + HOLE_ALIGN - 1) & ~(HOLE_ALIGN - 1));
+        return pos;
     }
 
     void read_thr_proc() {
         off_t pos = m_start;
-        int buf_idx = 0;
-        while (pos < (ssize_t)m_reader.size()){
-            { // a block for a lock
-                std::unique_lock<std::mutex> lock(m_buffer_mutex);
-                m_buffer_cv.wait(lock, [&] { return !m_buf_ready[buf_idx]; });
-                m_progress.update(pos);
-
-                if( m_buffers[buf_idx].size() < m_block_size ) {
-                    m_buffers[buf_idx].resize(m_block_size);
-                }
+        uint64_t seq = 0;
 
-                size_t nread = 0;
-                try {
-                    nread = m_reader.read_at(pos, m_buffers[buf_idx].data(), m_block_size);
-                } catch (const Reader::ReadError& e) {
-                    extern bool g_force;
-                    logger->error("{} @ {:#x}: {}", m_fname, pos, e.what());
-                    if (g_force)
-                        nread = try_read_by_sector(pos, m_buffers[buf_idx].data(), m_block_size);
-                    else
-                        throw;
-                }
+        std::unique_ptr<ReadQueue> queue;
+        size_t chunk_size = m_block_size;
+        if (m_queue_depth > 1) {
+            queue = std::make_unique<ReadQueue>(m_reader, m_queue_depth);
+            chunk_size = std::max<size_t>((m_block_size / m_queue_depth + 0xfff) & ~0xfffULL, 0x1000);
+        }
 
-                if (nread == 0) {
-                    logger->error("{}: unexpected EOF at {:#x}", m_fname, pos);
-                    break;
+        const off_t end = end_offset();
+        off_t data_end = pos;
+        while (pos < end){
+            // wait for a free slot
+            for (uint64_t tail = m_tail.load(std::memory_order_acquire); seq - tail >= m_ring_size; tail = m_tail.load(std::memory_order_acquire)) {
+                m_tail.wait(tail, std::memory_order_acquire);
+            }
+            m_progress.update(pos);
+
+            if (pos >= data_end) {
+                if (const off_t hole_end = find_hole(pos, end, data_end); hole_end > pos) {
+                    // passed through the ring, so the scanner sees it in file order
+                    m_holes[seq % m_ring_size] = hole_end - pos;
+                    m_offsets[seq % m_ring_size] = pos;
+                    m_hole_bytes += hole_end - pos;
+                    pos = hole_end;
+                    m_head.store(++seq, std::memory_order_release);
+                    m_head.notify_one();
+                    continue;
                 }
+            }
+            if (const off_t skip_end = find_skip(pos, data_end); skip_end > pos) {
+                m_skipped_bytes += skip_end - pos;
+                pos = skip_end;
+                continue;
+            }
 
-                if( nread < m_buffers[buf_idx].size() ) {
-                    m_buffers[buf_idx].resize(nread);
-                }
-                m_offsets[buf_idx] = pos;
-                m_buf_ready[buf_idx] = true;
-                pos += nread;
+            pooled_buf_t& buf = m_ring[seq % m_ring_size];
+            const size_t count = std::min<size_t>(m_block_size, data_end - pos);
+            if( buf.size() < count ) {
+                buf.resize(count);
+            }
+
+            // kernel fills the next buffer while this one is read
+            if (pos + (off_t)count < data_end) {
+                m_reader.will_need(pos + count, std::min<size_t>(m_block_size, data_end - pos - count));
             }
 
-            m_buffer_cv.notify_one();
-            buf_idx = 1 - buf_idx;
+            size_t nread = 0;
+            try {
+                if (queue && !m_bad_regions->overlaps(pos, count))
+                    nread = queue->read_at(pos, buf.data(), count, chunk_size);
+                else
+                    nread = m_reader.read_at(pos, buf.data(), count);
+            } catch (const Reader::ReadError& e) {
+                extern bool g_force;
+                logger->error("{} @ {:#x}: {}", m_fname, pos, e.what());
+                if (g_force)
+                    nread = m_reader.read_salvage(pos, buf.data(), count);
+                else
+                    throw;
+            }
+
+            if (nread == 0) {
+                logger->error("{}: unexpected EOF at {:#x}", m_fname, pos);
+                break;
+            }
+
+            if( nread != buf.size() ) {
+                buf.resize(nread);
+            }
+            m_holes[seq % m_ring_size] = 0;
+            m_offsets[seq % m_ring_size] = pos;
+            pos += nread;
+
+            m_head.store(++seq, std::memory_order_release);
+            m_head.notify_one();
+        }
+        m_head.store(seq | RING_EOF, std::memory_order_release);
+        m_head.notify_one();
+
+        if (m_hole_bytes > 0) {
+            logger->info("{}: skipped {} of holes", m_fname, bytes2human(m_hole_bytes));
+        }
+        if (m_skipped_bytes > 0) {
+            logger->info("{}: skipped {} already covered", m_fname, bytes2human(m_skipped_bytes));
+        }
+
+        if (m_bad_regions->count() > 0) {
+            logger->warn("{}: {} bad region(s), {} unreadable, see {}", m_fname, m_bad_regions->count(),
+                bytes2human(m_bad_regions->total_bytes()), m_bad_regions->fname().string());
         }
-        m_done = true;
-        m_buffer_cv.notify_all();
     }
 
-    void virtual process_buf(const buf_t& buf, off_t offset) = 0;
+    void virtual process_buf(std::span<const uint8_t> buf, off_t offset) = 0;
+    // a hole of a sparse source, reads as zeros and was not read at all
+    void virtual process_hole(off_t /*offset*/, size_t /*size*/) {}
+    // a range at pos the scanner doesn't need to see (e.g. covered by an earlier scan): returns its end, capped at data_end,
+    // otherwise returns pos and may lower data_end to the start of the next such range, so reads stop there
+    // called on the read thread
+    off_t virtual find_skip(off_t pos, off_t& /*data_end*/) { return pos; }
+    // everything before next_offset is processed, called on the scan thread after each buffer or hole
+    void virtual buf_done(off_t /*next_offset*/) {}
+
+    void mapped_thr_proc() {
+        buf_t unused;
+        const off_t end = end_offset();
+        off_t data_end = m_start;
+        for (off_t pos = m_start; pos < end; ) {
+            m_progress.update(pos);
+            if (pos >= data_end) {
+                if (const off_t hole_end = find_hole(pos, end, data_end); hole_end > pos) {
+                    process_hole(pos, hole_end - pos);
+                    m_hole_bytes += hole_end - pos;
+                    pos = hole_end;
+                    buf_done(pos);
+                    continue;
+                }
+            }
+            if (const off_t skip_end = find_skip(pos, data_end); skip_end > pos) {
+                m_skipped_bytes += skip_end - pos;
+                pos = skip_end;
+                continue;
+            }
+            const size_t count = std::min<size_t>(m_block_size, data_end - pos);
+            process_buf(m_reader.view(pos, count, unused), pos);
+            m_reader.drop_behind(pos, count);
+            pos += count;
+            buf_done(pos);
+        }
+        if (m_hole_bytes > 0) {
+            logger->info("{}: skipped {} of holes", m_fname, bytes2human(m_hole_bytes));
+        }
+        if (m_skipped_bytes > 0) {
+            logger->info("{}: skipped {} already covered", m_fname, bytes2human(m_skipped_bytes));
+        }
+    }
 
     void scan_thr_proc() {
-        int buf_idx = 0;
-        while (!m_done || m_buf_ready[buf_idx]) {
-            std::unique_lock<std::mutex> lock(m_buffer_mutex);
-            m_buffer_cv.wait(lock, [&] { return m_buf_ready[buf_idx] || m_done; });
-
-            if (m_buf_ready[buf_idx]) {
-                process_buf(m_buffers[buf_idx], m_offsets[buf_idx]);
-                m_buf_ready[buf_idx] = false; // Mark as processed
+        for (uint64_t seq = 0; ; ) {
+            const uint64_t head = m_head.load(std::memory_order_acquire);
+            if (seq == (head & ~RING_EOF)) {
+                if (head & RING_EOF)
+                    break;
+                m_head.wait(head, std::memory_order_acquire);
+                continue;
             }
 
-            m_buffer_cv.notify_one();
-            buf_idx = 1 - buf_idx;
+            const size_t idx = seq % m_ring_size;
+            if (m_holes[idx]) {
+                process_hole(m_offsets[idx], m_holes[idx]);
+                buf_done(m_offsets[idx] + m_holes[idx]);
+            } else {
+                process_buf(m_ring[idx], m_offsets[idx]);
+                m_reader.drop_behind(m_offsets[idx], m_ring[idx].size());
+                buf_done(m_offsets[idx] + m_ring[idx].size());
+            }
+
+            m_tail.store(++seq, std::memory_order_release);
+            m_tail.notify_one();
         }
     }
 
     protected:
     void virtual finish() {
         m_progress.finish();
+        m_out_queue.flush();
     }
 
     void found(const char* key){
         m_progress.found(key);
     }
 
-    void save_file(const std::string& fname, off_t start_offset, size_t size) {
-        std::filesystem::path out_fname = get_out_pathname(m_fname, fname);
-        logger->trace("saving {}", out_fname);
+    // writes data to "<fname>" in the background, data may be reused right after the call
+    void save_file(const std::string& fname, std::span<const uint8_t> data) {
+        m_out_queue.write(get_out_pathname(m_fname, fname), data);
+    }
 
-        Writer w(out_fname);
-        buf_t buf(m_block_size);
+    // data => write to "<fname_ofs>.<ext>" @ dst_offset, in the background after earlier saves
+    void update_file(off_t fname_ofs, const char* ext, off_t dst_offset, std::span<const uint8_t> data) {
+        m_out_queue.write(get_out_pathname(m_fname, fmt::format("{:012x}{}", fname_ofs, ext)), data, false, dst_offset);
+    }
 
-        off_t pos = start_offset;
-        for(size_t remain = size; remain > 0; ){
-            ssize_t nread = m_reader.read_at(pos, buf.data(), std::min(remain, m_block_size));
-            if (nread == 0) {
-                logger->error("save_file(\"{}\", {:#x}, {:#x}): unexpected EOF at {:#x}", fname, start_offset, size, pos);
-                break;
-            }
-            w.write(buf.data(), nread);
-            pos += nread;
-            remain -= nread;
-        }
+    // m_reader.read_at(start_offset, size) => "<fname>", for data that isn't in memory
+    void save_file(const std::string& fname, off_t start_offset, size_t size) {
+        buf_t buf(size);
+        save_file(fname, std::span<const uint8_t>(buf.data(), read_fully(buf, start_offset, "save_file")));
     }
 
     // m_reader.read_at(start_offset, size) => write to "<fname_ofs>.<ext>" @ dst_offset
     void update_file(off_t fname_ofs, const char* ext, off_t dst_offset, off_t start_offset, size_t size) {
-        std::filesystem::path out_fname = get_out_pathname(m_fname, fmt::format("{:012x}{}", fname_ofs, ext));
-        logger->trace("updating {} @ {:x}", out_fname, dst_offset);
-
-        Writer w(out_fname, false);
-        w.seek(dst_offset);
+        buf_t buf(size);
+        update_file(fname_ofs, ext, dst_offset, std::span<const uint8_t>(buf.data(), read_fully(buf, start_offset, "update_file")));
+    }
 
-        buf_t buf(m_block_size);
+    // waits until the files saved so far are written
+    void flush_files() {
+        m_out_queue.flush();
+    }
 
-        off_t pos = start_offset;
-        for(size_t remain = size; remain > 0; ){
-            ssize_t nread = m_reader.read_at(pos, buf.data(), std::min(remain, m_block_size));
+    private:
+    // returns the number of bytes read, less than buf.size() only at EOF
+    size_t read_fully(buf_t& buf, off_t start_offset, const char* caller) {
+        size_t done = 0;
+        while (done < buf.size()) {
+            const size_t nread = m_reader.read_at(start_offset + done, buf.data() + done, std::min(buf.size() - done, m_block_size));
             if (nread == 0) {
-                logger->error("update_file({:#x}, \"{}\", {:#x}, {:#x}): unexpected EOF at {:#x}", fname_ofs, ext, start_offset, size, start_offset);
+                logger->error("{}({:#x}, {:#x}): unexpected EOF at {:#x}", caller, start_offset, buf.size(), start_offset + done);
                 break;
             }
-            w.write(buf.data(), nread);
-            pos += nread;
-            remain -= nread;
+            done += nread;
         }
+        return done;
     }
+
+    FileWriteQueue m_out_queue;
 };
 
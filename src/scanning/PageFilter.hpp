@@ -0,0 +1,24 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// classifies the pages of a scan buffer before ScannerV2 runs its validators
+// a page is all zeros, might be a bank header, might be a slot, or none of these;
+// only candidates reach check_bank() / check_slot(), zero pages skip the zero test of the data probes
+// the flags are necessary conditions of the validators, never a verdict
+namespace PageFilter {
+
+enum : uint8_t {
+    ZERO = 1,
+    BANK = 2, // CBank::HeaderPage with a sane nPages and an all-zero `zeroes` area
+    SLOT = 4, // CSlot::valid_fast()
+};
+
+// flags of npages consecutive pages at buf, written to out[0..npages)
+void classify(const uint8_t* buf, size_t npages, uint8_t* out);
+uint8_t classify(const uint8_t* page);
+
+// SIMD version of is_all_zero()
+bool is_zero(const uint8_t* p, size_t size);
+
+} // namespace PageFilter
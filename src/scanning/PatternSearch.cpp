@@ -0,0 +1,340 @@
+/**
+ * @file PatternSearch.cpp
+ * @brief Implementation of the multi-pattern signature search shared by the scanners.
+ *
+ * Each pattern is reduced to two anchor bytes: its first byte and a later,
+ * preferably distinctive one. A vector of positions is checked for both anchors
+ * of every pattern at once, and only the (rare) positions where they match are
+ * compared in full and passed to the pattern's verify function. The AVX2 path
+ * is selected at runtime, SSE2 is always available on x86-64.
+ */
+
+#include "PatternSearch.hpp"
+#include "core/structs.hpp"
+
+#include <bit>
+#include <cstring>
+#include <stdexcept>
+
+#if !defined(__x86_64__) && !defined(_M_X64)
+#error "Only x86-64 is supported"
+#endif
+
+#include <immintrin.h>
+#if defined(_MSC_VER)
+    #include <intrin.h>
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define AVX2_TARGET __attribute__((target("avx2")))
+#else
+#define AVX2_TARGET
+#endif
+
+PatternSearch::PatternSearch() : m_isa(best_isa()) {
+}
+
+/**
+ * @brief Detects the best instruction set the CPU and OS support.
+ *
+ * @return Isa::AVX2 if AVX2 is usable, Isa::SSE2 otherwise.
+ */
+PatternSearch::Isa PatternSearch::best_isa() {
+#if defined(_MSC_VER)
+    int regs[4] = {0, 0, 0, 0};
+    __cpuid(regs, 1);
+    const bool osxsave = (regs[2] & (1 << 27)) != 0;
+    __cpuidex(regs, 7, 0);
+    const bool avx2 = osxsave && (regs[1] & (1 << 5)) != 0 && (_xgetbv(0) & 6) == 6;
+#else
+    // also checks that the OS saves the ymm registers
+    const bool avx2 = __builtin_cpu_supports("avx2");
+#endif
+    return avx2 ? Isa::AVX2 : Isa::SSE2;
+}
+
+const char* PatternSearch::isa_name(Isa isa) {
+    switch (isa) {
+        case Isa::SCALAR: return "scalar";
+        case Isa::SSE2:   return "SSE2";
+        case Isa::AVX2:   return "AVX2";
+    }
+    return "?";
+}
+
+// lowering only, an instruction set the CPU lacks is never selected
+void PatternSearch::set_isa(Isa isa) {
+    m_isa = std::min(isa, best_isa());
+}
+
+/**
+ * @brief Adds a pattern to the set.
+ *
+ * @param pattern Pattern bytes, optional mask, alignment and verify function.
+ * @return Id of the pattern, reported in Match::id.
+ * @throws std::invalid_argument If the pattern is empty, its mask doesn't match its size,
+ *         the alignment is not a power of two or the set is full.
+ */
+uint8_t PatternSearch::add(Pattern pattern) {
+    if (pattern.bytes.empty()) {
+        throw std::invalid_argument("PatternSearch: empty pattern");
+    }
+    if (pattern.mask.empty()) {
+        pattern.mask.assign(pattern.bytes.size(), 0xFF);
+    } else if (pattern.mask.size() != pattern.bytes.size()) {
+        throw std::invalid_argument("PatternSearch: mask size differs from pattern size");
+    }
+    if (!std::has_single_bit(pattern.align)) {
+        throw std::invalid_argument(fmt::format("PatternSearch: alignment {} is not a power of two", pattern.align));
+    }
+    if (m_patterns.size() >= MAX_PATTERNS) {
+        throw std::invalid_argument(fmt::format("PatternSearch: more than {} patterns", MAX_PATTERNS));
+    }
+    for (size_t i = 0; i < pattern.bytes.size(); i++) {
+        pattern.bytes[i] &= pattern.mask[i];
+    }
+
+    // second anchor: the last fully masked non-zero byte, zeros are too common in backups
+    size_t anchor = 0;
+    for (size_t i = pattern.bytes.size() - 1; i > 0 && anchor == 0; i--) {
+        if (pattern.mask[i] == 0xFF && pattern.bytes[i] != 0) anchor = i;
+    }
+    for (size_t i = pattern.bytes.size() - 1; i > 0 && anchor == 0; i--) {
+        if (pattern.mask[i] != 0) anchor = i;
+    }
+
+    Compiled c{std::move(pattern), anchor, 0, 0, 0, 0};
+    c.b0 = c.p.bytes[0];
+    c.m0 = c.p.mask[0];
+    c.b1 = c.p.bytes[anchor];
+    c.m1 = c.p.mask[anchor];
+    m_max_anchor = std::max(m_max_anchor, anchor);
+    m_patterns.push_back(std::move(c));
+    return static_cast<uint8_t>(m_patterns.size() - 1);
+}
+
+bool PatternSearch::match_at(const Compiled& c, std::span<const uint8_t> buf, size_t pos) const {
+    const auto& p = c.p;
+    if (pos % p.align != 0 || pos + p.bytes.size() > buf.size()) {
+        return false;
+    }
+    const uint8_t* d = buf.data() + pos;
+    for (size_t i = 0; i < p.bytes.size(); i++) {
+        if ((d[i] & p.mask[i]) != p.bytes[i]) return false;
+    }
+    return !p.verify || p.verify(d, buf.size() - pos);
+}
+
+size_t PatternSearch::find_scalar(std::span<const uint8_t> buf, std::vector<Match>* out, size_t from, size_t to, size_t limit) const {
+    size_t found = 0;
+    to = std::min(to, buf.size());
+    for (size_t pos = from; pos < to; pos++) {
+        for (size_t i = 0; i < m_patterns.size(); i++) {
+            if (match_at(m_patterns[i], buf, pos)) {
+                if (out) out->push_back({pos, static_cast<uint8_t>(i)});
+                if (++found == limit) return found;
+            }
+        }
+    }
+    return found;
+}
+
+// bits of the positions in a vector block that satisfy the alignment,
+// blocks start at multiples of the vector width so this is the same for every block
+static uint32_t align_mask(size_t align, size_t width, size_t block_pos) {
+    if (align > width) {
+        return block_pos % align == 0 ? 1 : 0;
+    }
+    uint32_t mask = 0;
+    for (size_t j = 0; j < width; j += align) {
+        mask |= 1u << j;
+    }
+    return mask;
+}
+
+size_t PatternSearch::find_sse2(std::span<const uint8_t> buf, std::vector<Match>* out, size_t from, size_t to, size_t limit) const {
+    constexpr size_t W = 16;
+    const size_t n = m_patterns.size();
+    const uint8_t* data = buf.data();
+    to = std::min(to, buf.size());
+
+    __m128i b0[MAX_PATTERNS], m0[MAX_PATTERNS], b1[MAX_PATTERNS], m1[MAX_PATTERNS];
+    for (size_t i = 0; i < n; i++) {
+        const Compiled& c = m_patterns[i];
+        b0[i] = _mm_set1_epi8(static_cast<char>(c.b0));
+        m0[i] = _mm_set1_epi8(static_cast<char>(c.m0));
+        b1[i] = _mm_set1_epi8(static_cast<char>(c.b1));
+        m1[i] = _mm_set1_epi8(static_cast<char>(c.m1));
+    }
+
+    // loads of a block at b reach up to b + m_max_anchor + W - 1
+    const size_t simd_end = buf.size() >= m_max_anchor + W ? buf.size() - m_max_anchor - W + 1 : 0;
+    size_t found = 0;
+    size_t b = from & ~(W - 1);
+    for (; b < simd_end && b < to; b += W) {
+        const __m128i v0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + b));
+        uint32_t bits[MAX_PATTERNS];
+        uint32_t any = 0;
+        for (size_t i = 0; i < n; i++) {
+            const Compiled& c = m_patterns[i];
+            bits[i] = align_mask(c.p.align, W, b);
+            if (bits[i] == 0) continue;
+            __m128i eq = _mm_cmpeq_epi8(_mm_and_si128(v0, m0[i]), b0[i]);
+            if (c.anchor) {
+                const __m128i v1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + b + c.anchor));
+                eq = _mm_and_si128(eq, _mm_cmpeq_epi8(_mm_and_si128(v1, m1[i]), b1[i]));
+            }
+            bits[i] &= static_cast<uint32_t>(_mm_movemask_epi8(eq));
+            any |= bits[i];
+        }
+        if (any == 0) continue;
+
+        if (b < from) any &= ~0u << (from - b);
+        if (to - b < W) any &= (1u << (to - b)) - 1;
+        while (any) {
+            const size_t j = std::countr_zero(any);
+            any &= any - 1;
+            for (size_t i = 0; i < n; i++) {
+                if ((bits[i] >> j & 1) && match_at(m_patterns[i], buf, b + j)) {
+                    if (out) out->push_back({b + j, static_cast<uint8_t>(i)});
+                    if (++found == limit) return found;
+                }
+            }
+        }
+    }
+    return found + find_scalar(buf, out, std::max(b, from), to, limit - found);
+}
+
+AVX2_TARGET size_t PatternSearch::find_avx2(std::span<const uint8_t> buf, std::vector<Match>* out, size_t from, size_t to, size_t limit) const {
+    constexpr size_t W = 32;
+    const size_t n = m_patterns.size();
+    const uint8_t* data = buf.data();
+    to = std::min(to, buf.size());
+
+    __m256i b0[MAX_PATTERNS], m0[MAX_PATTERNS], b1[MAX_PATTERNS], m1[MAX_PATTERNS];
+    for (size_t i = 0; i < n; i++) {
+        const Compiled& c = m_patterns[i];
+        b0[i] = _mm256_set1_epi8(static_cast<char>(c.b0));
+        m0[i] = _mm256_set1_epi8(static_cast<char>(c.m0));
+        b1[i] = _mm256_set1_epi8(static_cast<char>(c.b1));
+        m1[i] = _mm256_set1_epi8(static_cast<char>(c.m1));
+    }
+
+    const size_t simd_end = buf.size() >= m_max_anchor + W ? buf.size() - m_max_anchor - W + 1 : 0;
+    size_t found = 0;
+    size_t b = from & ~(W - 1);
+    for (; b < simd_end && b < to; b += W) {
+        const __m256i v0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + b));
+        uint32_t bits[MAX_PATTERNS];
+        uint32_t any = 0;
+        for (size_t i = 0; i < n; i++) {
+            const Compiled& c = m_patterns[i];
+            bits[i] = align_mask(c.p.align, W, b);
+            if (bits[i] == 0) continue;
+            __m256i eq = _mm256_cmpeq_epi8(_mm256_and_si256(v0, m0[i]), b0[i]);
+            if (c.anchor) {
+                const __m256i v1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + b + c.anchor));
+                eq = _mm256_and_si256(eq, _mm256_cmpeq_epi8(_mm256_and_si256(v1, m1[i]), b1[i]));
+            }
+            bits[i] &= static_cast<uint32_t>(_mm256_movemask_epi8(eq));
+            any |= bits[i];
+        }
+        if (any == 0) continue;
+
+        if (b < from) any &= ~0u << (from - b);
+        if (to - b < W) any &= (1u << (to - b)) - 1;
+        while (any) {
+            const size_t j = std::countr_zero(any);
+            any &= any - 1;
+            for (size_t i = 0; i < n; i++) {
+                if ((bits[i] >> j & 1) && match_at(m_patterns[i], buf, b + j)) {
+                    if (out) out->push_back({b + j, static_cast<uint8_t>(i)});
+                    if (++found == limit) return found;
+                }
+            }
+        }
+    }
+    return found + find_scalar(buf, out, std::max(b, from), to, limit - found);
+}
+
+size_t PatternSearch::find_impl(std::span<const uint8_t> buf, std::vector<Match>* out, size_t from, size_t to, size_t limit) const {
+    if (m_patterns.empty() || from >= std::min(to, buf.size())) {
+        return 0;
+    }
+    switch (m_isa) {
+        case Isa::AVX2: return find_avx2(buf, out, from, to, limit);
+        case Isa::SSE2: return find_sse2(buf, out, from, to, limit);
+        default:        return find_scalar(buf, out, from, to, limit);
+    }
+}
+
+/**
+ * @brief Finds all matches of all patterns in a buffer.
+ *
+ * @param buf Buffer to search, pattern alignment is relative to its start.
+ * @param out Matches are appended here, ordered by position, then by pattern id.
+ * @param from First position to report.
+ * @param to End of the positions to report (exclusive), a match must still fit into buf.
+ */
+void PatternSearch::find(std::span<const uint8_t> buf, std::vector<Match>& out, size_t from, size_t to) const {
+    find_impl(buf, &out, from, to, SIZE_MAX);
+}
+
+size_t PatternSearch::find_first(std::span<const uint8_t> buf, size_t from, size_t to) const {
+    std::vector<Match> out;
+    find_impl(buf, &out, from, to, 1);
+    return out.empty() ? SIZE_MAX : out[0].pos;
+}
+
+namespace signatures {
+
+static PatternSearch::Pattern from_bytes(const void* p, size_t size, size_t align) {
+    const uint8_t* b = static_cast<const uint8_t*>(p);
+    return PatternSearch::Pattern{std::vector<uint8_t>(b, b + size), {}, align, nullptr};
+}
+
+PatternSearch::Pattern lz_hdr(size_t align) {
+    const uint32_t magic = LZ_START_MAGIC;
+    auto p = from_bytes(&magic, sizeof(magic), align);
+    // crc and srcSize are checked by valid()
+    p.bytes.resize(sizeof(::lz_hdr), 0);
+    p.mask.assign(sizeof(::lz_hdr), 0);
+    std::fill_n(p.mask.begin(), sizeof(magic), 0xFF);
+    p.verify = [](const uint8_t* d, size_t) {
+        return reinterpret_cast<const ::lz_hdr*>(d)->valid();
+    };
+    return p;
+}
+
+PatternSearch::Pattern lz_hdr_prefix(size_t align) {
+    auto p = lz_hdr(align);
+    p.mask.back() = 0xFF; // high byte of srcSize is 0
+    p.verify = nullptr;
+    return p;
+}
+
+bool is_zlib_header(const uint8_t* data) {
+    const uint8_t first_byte = data[0];
+    const uint8_t second_byte = data[1];
+    return (first_byte & 0x0F) == 0x08 && // deflate compression method
+           ((first_byte * 256 + second_byte) % 31) == 0 && // header checksum
+           ((first_byte >> 4) & 0x0F) <= 7 && // window size <= 15 (32KB)
+           (second_byte & 0x20) == 0; // no preset dictionary (Veeam doesn't use this)
+}
+
+PatternSearch::Pattern zlib_header(size_t align) {
+    // CM = 8 and CINFO <= 7 in the first byte, FDICT = 0 in the second, the check bits are verified
+    PatternSearch::Pattern p{{0x08, 0x00}, {0x8F, 0x20}, align, nullptr};
+    p.verify = [](const uint8_t* d, size_t) { return is_zlib_header(d); };
+    return p;
+}
+
+PatternSearch::Pattern text(std::string_view s, size_t align) {
+    return from_bytes(s.data(), s.size(), align);
+}
+
+PatternSearch::Pattern empty_block_digest(size_t align) {
+    return from_bytes(&EMPTY_BLOCK_DIGEST, sizeof(EMPTY_BLOCK_DIGEST), align);
+}
+
+} // namespace signatures
@@ -0,0 +1,86 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <vector>
+
+// finds all occurrences of a small set of byte signatures in a buffer in one pass
+// two anchor bytes of every pattern are compared 32 (AVX2) or 16 (SSE2) positions at a time,
+// only positions where they match are compared in full, so scanners no longer probe every offset
+class PatternSearch {
+    public:
+    static constexpr size_t MAX_PATTERNS = 8;
+
+    enum class Isa : uint8_t { SCALAR, SSE2, AVX2 };
+
+    // extra check of a candidate that matched the masked bytes, avail = bytes from p to the end of the buffer
+    using verify_fn = bool (*)(const uint8_t* p, size_t avail);
+
+    struct Pattern {
+        std::vector<uint8_t> bytes;
+        std::vector<uint8_t> mask;  // per byte, empty = all 0xFF, bits not in the mask are ignored
+        size_t align = 1;           // power of two, relative to the start of the searched buffer
+        verify_fn verify = nullptr;
+    };
+
+    struct Match {
+        size_t pos;
+        uint8_t id; // as returned by add()
+
+        bool operator==(const Match&) const = default;
+    };
+
+    PatternSearch();
+
+    // returns the pattern id, matches at the same position are reported in id order
+    uint8_t add(Pattern pattern);
+    size_t size() const { return m_patterns.size(); }
+
+    // appends matches starting in [from, to) that fit entirely into buf to out, ordered by position
+    void find(std::span<const uint8_t> buf, std::vector<Match>& out, size_t from = 0, size_t to = SIZE_MAX) const;
+    // position of the first match of any pattern in [from, to), SIZE_MAX if none
+    size_t find_first(std::span<const uint8_t> buf, size_t from = 0, size_t to = SIZE_MAX) const;
+
+    // best instruction set supported by the CPU, used unless lowered with set_isa()
+    static Isa best_isa();
+    static const char* isa_name(Isa isa);
+    void set_isa(Isa isa);
+    Isa isa() const { return m_isa; }
+
+    private:
+    struct Compiled {
+        Pattern p;
+        size_t anchor;      // offset of the second anchor byte, the first one is at 0
+        uint8_t b0, m0;     // first byte and its mask
+        uint8_t b1, m1;     // anchor byte and its mask
+    };
+
+    bool match_at(const Compiled& c, std::span<const uint8_t> buf, size_t pos) const;
+    size_t find_scalar(std::span<const uint8_t> buf, std::vector<Match>* out, size_t from, size_t to, size_t limit) const;
+    size_t find_sse2(std::span<const uint8_t> buf, std::vector<Match>* out, size_t from, size_t to, size_t limit) const;
+    size_t find_avx2(std::span<const uint8_t> buf, std::vector<Match>* out, size_t from, size_t to, size_t limit) const;
+    size_t find_impl(std::span<const uint8_t> buf, std::vector<Match>* out, size_t from, size_t to, size_t limit) const;
+
+    std::vector<Compiled> m_patterns;
+    size_t m_max_anchor = 0;
+    Isa m_isa;
+};
+
+// signatures shared by the scanners
+namespace signatures {
+
+// lz_hdr with a valid srcSize, as checked by lz_hdr::valid()
+PatternSearch::Pattern lz_hdr(size_t align = 1);
+// LZ_START_MAGIC followed by any crc and a srcSize below 16M (only the high byte is checked), `blocks` listing
+PatternSearch::Pattern lz_hdr_prefix(size_t align = 1);
+// zlib CMF/FLG pair as written by Veeam: deflate, window <= 32K, valid check bits, no preset dictionary
+PatternSearch::Pattern zlib_header(size_t align = 1);
+// literal text, e.g. "<OibSummary>"
+PatternSearch::Pattern text(std::string_view s, size_t align = 1);
+// EMPTY_BLOCK_DIGEST in binary form
+PatternSearch::Pattern empty_block_digest(size_t align = 1);
+
+bool is_zlib_header(const uint8_t* data);
+
+} // namespace signatures
@@ -0,0 +1,143 @@
+/**
+ * @file ScanCheckpoint.cpp
+ * @brief Crash-safe checkpoint file of long scans.
+ *
+ * Layout: magic, version, the header fields, payload size, payload, and a
+ * CRC32 over everything before it. The file is written to a temporary name,
+ * synced, and renamed over the previous checkpoint, then the directory is
+ * synced, so the checkpoint on disk is always a complete one even after a
+ * power loss.
+ */
+
+#include "ScanCheckpoint.hpp"
+#include "utils/common.hpp"
+
+#include <fstream>
+#include <zlib.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#ifdef __WIN32__
+#include <io.h>
+#endif
+
+static constexpr char MAGIC[8] = {'V', 'P', 'S', 'C', 'K', 'P', 'T', '\n'};
+
+std::filesystem::path ScanCheckpoint::pathname(const std::filesystem::path& src_fname) {
+    return get_out_pathname(src_fname, "scan.checkpoint");
+}
+
+/**
+ * @brief Makes the data written to a file so far durable.
+ *
+ * @param fname File (or, except on Windows, directory) to sync.
+ * @return False if the file can't be opened or synced.
+ */
+bool ScanCheckpoint::sync_file(const std::filesystem::path& fname) {
+#ifdef __WIN32__
+    const int fd = _wopen(fname.c_str(), _O_RDWR | _O_BINARY);
+    if (fd == -1) {
+        return false;
+    }
+    const bool ok = _commit(fd) == 0;
+    _close(fd);
+#else
+    const int fd = open(fname.c_str(), O_RDONLY);
+    if (fd == -1) {
+        return false;
+    }
+    const bool ok = fsync(fd) == 0;
+    close(fd);
+#endif
+    return ok;
+}
+
+/**
+ * @brief Atomically replaces the checkpoint file.
+ *
+ * @param fname Checkpoint pathname.
+ * @param hdr Scan position and parameters.
+ * @param payload Scanner state, see ScanCheckpoint::Out.
+ * @throws std::runtime_error If the file can't be written.
+ */
+void ScanCheckpoint::save(const std::filesystem::path& fname, const Header& hdr, const std::string& payload) {
+    Out out;
+    out.put(MAGIC);
+    out.put(VERSION);
+    out.put(hdr.source_size);
+    out.put(hdr.start);
+    out.put(hdr.end);
+    out.put(hdr.offset);
+    out.put(hdr.flags);
+    out.put<uint64_t>(payload.size());
+    uint32_t crc = crc32(0, reinterpret_cast<const Bytef*>(out.data().data()), out.data().size());
+    crc = crc32(crc, reinterpret_cast<const Bytef*>(payload.data()), payload.size());
+
+    std::filesystem::path tmp_fname = fname;
+    tmp_fname += ".tmp";
+    {
+        std::ofstream f(tmp_fname, std::ios::binary | std::ios::trunc);
+        f.write(out.data().data(), out.data().size());
+        f.write(payload.data(), payload.size());
+        f.write(reinterpret_cast<const char*>(&crc), sizeof(crc));
+        f.close();
+        if (!f) {
+            throw std::runtime_error(fmt::format("checkpoint: failed to write {}: {}", tmp_fname.string(), strerror(errno)));
+        }
+    }
+    if (!sync_file(tmp_fname)) {
+        throw std::runtime_error(fmt::format("checkpoint: failed to sync {}: {}", tmp_fname.string(), strerror(errno)));
+    }
+    std::filesystem::rename(tmp_fname, fname);
+#ifndef __WIN32__
+    sync_file(fname.parent_path().empty() ? "." : fname.parent_path()); // the rename itself
+#endif
+}
+
+/**
+ * @brief Reads and verifies a checkpoint file.
+ *
+ * @param fname Checkpoint pathname.
+ * @param payload If not null, receives the scanner state.
+ * @return The header.
+ * @throws std::runtime_error If the file is missing, of another version or corrupted.
+ */
+ScanCheckpoint::Header ScanCheckpoint::load(const std::filesystem::path& fname, std::string* payload) {
+    std::ifstream f(fname, std::ios::binary);
+    if (!f) {
+        throw std::runtime_error(fmt::format("no checkpoint at {}", fname.string()));
+    }
+    std::string data((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+
+    uint32_t crc = 0;
+    if (data.size() < sizeof(MAGIC) + sizeof(crc) || memcmp(data.data(), MAGIC, sizeof(MAGIC)) != 0) {
+        throw std::runtime_error(fmt::format("{}: not a scan checkpoint", fname.string()));
+    }
+    memcpy(&crc, data.data() + data.size() - sizeof(crc), sizeof(crc));
+    data.resize(data.size() - sizeof(crc));
+    if (crc != crc32(0, reinterpret_cast<const Bytef*>(data.data()), data.size())) {
+        throw std::runtime_error(fmt::format("{}: checkpoint is corrupted (crc mismatch)", fname.string()));
+    }
+
+    In in(std::move(data));
+    in.get_bytes(sizeof(MAGIC));
+    if (const uint32_t version = in.get<uint32_t>(); version != VERSION) {
+        throw std::runtime_error(fmt::format("{}: unsupported checkpoint version {}", fname.string(), version));
+    }
+    Header hdr;
+    hdr.source_size = in.get<uint64_t>();
+    hdr.start = in.get<uint64_t>();
+    hdr.end = in.get<uint64_t>();
+    hdr.offset = in.get<uint64_t>();
+    hdr.flags = in.get<uint32_t>();
+    const uint64_t payload_size = in.get<uint64_t>();
+
+    std::string rest = in.get_bytes(payload_size);
+    if (!in.eof()) {
+        throw std::runtime_error(fmt::format("{}: checkpoint has trailing data", fname.string()));
+    }
+    if (payload) {
+        *payload = std::move(rest);
+    }
+    return hdr;
+}
@@ -0,0 +1,120 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+// snapshot of a long scan, `scan --resume` continues from it
+// a fixed header (where the scan is, what it scans) and an opaque payload with the scanner's state;
+// the file is written next to the old one, synced and renamed over it, so a crash at any moment
+// leaves either the previous or the new checkpoint, and a torn or foreign file fails the crc check
+class ScanCheckpoint {
+    public:
+    static constexpr uint32_t VERSION = 2;
+
+    // Header::flags
+    static constexpr uint32_t F_BLOCKS = 1; // scan --blocks
+    static constexpr uint32_t F_CARVE  = 2; // scan --carve
+
+    struct Header {
+        uint64_t source_size = 0;
+        uint64_t start = 0;  // where the interrupted scan started
+        uint64_t end = 0;    // its end, 0 = EOF
+        uint64_t offset = 0; // everything before it is processed, the resumed scan starts here
+        uint32_t flags = 0;
+    };
+
+    // payload builder, values are stored as they are in memory (little endian, packed structs)
+    class Out {
+        public:
+        template <class T> void put(const T& v) {
+            if constexpr (is_pair<T>::value) {
+                put(v.first);
+                put(v.second);
+            } else {
+                static_assert(std::is_trivially_copyable_v<T>);
+                m_data.append(reinterpret_cast<const char*>(&v), sizeof(v));
+            }
+        }
+
+        // element count followed by the elements
+        template <class C> void put_all(const C& c) {
+            put<uint64_t>(c.size());
+            for (const auto& v : c) {
+                put(v);
+            }
+        }
+
+        const std::string& data() const { return m_data; }
+
+        private:
+        std::string m_data;
+    };
+
+    // payload reader, throws std::runtime_error when reading past the end
+    class In {
+        public:
+        explicit In(std::string data) : m_data(std::move(data)) {}
+
+        template <class T> T get() {
+            if constexpr (is_pair<T>::value) {
+                auto first = get<std::remove_const_t<typename T::first_type>>();
+                return T{std::move(first), get<typename T::second_type>()};
+            } else {
+                static_assert(std::is_trivially_copyable_v<T>);
+                T v;
+                read(&v, sizeof(v));
+                return v;
+            }
+        }
+
+        // replaces the contents of c with what put_all() stored
+        template <class C> void get_all(C& c) {
+            const uint64_t n = get<uint64_t>();
+            if (n > m_data.size() - m_pos) { // every element takes at least a byte
+                throw std::runtime_error("checkpoint: bad element count");
+            }
+            c.clear();
+            for (uint64_t i = 0; i < n; i++) {
+                c.insert(c.end(), get<typename C::value_type>());
+            }
+        }
+
+        std::string get_bytes(size_t size) {
+            std::string s(size, '\0');
+            read(s.data(), size);
+            return s;
+        }
+
+        bool eof() const { return m_pos == m_data.size(); }
+
+        private:
+        void read(void* p, size_t size) {
+            if (size > m_data.size() - m_pos) {
+                throw std::runtime_error("checkpoint: truncated payload");
+            }
+            memcpy(p, m_data.data() + m_pos, size);
+            m_pos += size;
+        }
+
+        std::string m_data;
+        size_t m_pos = 0;
+    };
+
+    // scan.checkpoint in the output dir of the source
+    static std::filesystem::path pathname(const std::filesystem::path& src_fname);
+
+    static void save(const std::filesystem::path& fname, const Header& hdr, const std::string& payload);
+    // throws std::runtime_error if the file is missing, of another version or corrupted
+    static Header load(const std::filesystem::path& fname, std::string* payload = nullptr);
+
+    // makes data written to fname so far durable (fsync / _commit), false on error
+    static bool sync_file(const std::filesystem::path& fname);
+
+    private:
+    template <class T> struct is_pair : std::false_type {};
+    template <class A, class B> struct is_pair<std::pair<A, B>> : std::true_type {};
+};
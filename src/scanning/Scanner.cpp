@@ -14,9 +14,12 @@
 #include "utils/common.hpp"
 #include "utils/Progress.hpp"
 #include "io/Reader.hpp"
+#include "PatternSearch.hpp"
 #include "Veeam/VBK.hpp"
 
+#include <algorithm>
 #include <fstream>
+#include <span>
 #include <unordered_set>
 
 #include <zlib.h>
@@ -33,7 +36,7 @@ using namespace Veeam::VBK;
  * @param[out] mpidOut Guessed metadata ID.
  * @return Always true (legacy behavior).
  */
-bool vGuessMetaID(buf_t& vm, uint32_t& mpidOut) {
+bool vGuessMetaID(std::span<const uint8_t> vm, uint32_t& mpidOut) {
 //    bool result = false;
     uint64_t sum = 0;
     uint32_t cnt = 0;
@@ -69,7 +72,7 @@ bool vGuessMetaID(buf_t& vm, uint32_t& mpidOut) {
     return true; // XXX original function always returns true :(
 }
 
-bool vObtainMetaID(buf_t& meta, uint32_t& metaID) {
+bool vObtainMetaID(std::span<const uint8_t> meta, uint32_t& metaID) {
     bool result = false;
     std::array<uint32_t, 16> id;
     std::vector<uint32_t> cnts;
@@ -431,23 +434,44 @@ bool vDecompressAllBitmaps(std::vector<FileDescriptor>& vFiles) {
     return true;
 }
 
+/**
+ * @brief Checks whether a page looks like the first page of a bank.
+ *
+ * The first word holds the page count of the bank, every other byte of the
+ * page must be 0 or 1. hBuf need not be aligned: the backward search calls
+ * this at every byte offset of a page. The bytes are ORed 64 at a time, which
+ * the compiler turns into vector ORs, with an early exit after every block.
+ *
+ * @param hBuf PAGE_SIZE bytes to check.
+ * @return True if the page passes.
+ */
 bool check_hbuf(const char* hBuf){
-    uint16_t castW = *(uint16_t*)hBuf;
+    uint16_t castW;
+    memcpy(&castW, hBuf, sizeof(castW));
     if( castW <= 1 || castW > 0xfffd ){
         return false;
     }
 
-    if( 0xfefe & (*(uint16_t*) &hBuf[2]) ){
-        return false;
+    uint64_t acc = 0;
+    for(size_t i=1; i<8; i++){
+        uint64_t v;
+        memcpy(&v, hBuf + i*sizeof(v), sizeof(v));
+        acc |= v;
     }
-
-    if( 0xfefefefe & (*(uint32_t*) &hBuf[4]) ){
+    uint64_t head;
+    memcpy(&head, hBuf, sizeof(head));
+    if( 0xfefefefefefefefe & ((head & ~0xffffULL) | acc) ){
         return false;
     }
 
-    uint64_t *p = (uint64_t*) hBuf;
-    for(size_t i=1; i<PAGE_SIZE/sizeof(uint64_t); i++){
-        if( 0xfefefefefefefefe & p[i] ){
+    for(size_t ofs=64; ofs<PAGE_SIZE; ofs+=64){
+        acc = 0;
+        for(size_t i=0; i<8; i++){
+            uint64_t v;
+            memcpy(&v, hBuf + ofs + i*sizeof(v), sizeof(v));
+            acc |= v;
+        }
+        if( 0xfefefefefefefefe & acc ){
             return false;
         }
     }
@@ -455,7 +479,68 @@ bool check_hbuf(const char* hBuf){
     return true;
 }
 
-void saveFile(const buf_t& fm, uint64_t hPos, const std::string in_fname, const std::string ext){
+// Pages for the backward bank search, read in large chunks.
+// The search steps back one byte (or one page) at a time from an empty block
+// hash, up to 32 banks, and looks at the page at every step. Reading each
+// page on its own meant up to millions of 4K reads per hash found; the window
+// is refilled only when a page falls outside of it, ending at that page so
+// that the following steps back are served from memory.
+// It also remembers the last run of page-aligned offsets that failed
+// check_hbuf(): empty block hashes usually come in bunches and every one of
+// them walks back over the same pages, those are skipped instead of checked again.
+class BackwardWindow {
+    public:
+    static constexpr size_t CHUNK_SIZE = 4*1024*1024;
+
+    BackwardWindow(Reader& reader, off_t fsize) : m_reader(reader), m_fsize(fsize), m_buf(CHUNK_SIZE + PAGE_SIZE) {}
+
+    // PAGE_SIZE bytes at pos, zero-filled past EOF
+    const char* page_at(off_t pos) {
+        if( pos < m_start || pos + (off_t)PAGE_SIZE > m_start + (off_t)m_buf.size() ){
+            fill(pos);
+        }
+        return (const char*)m_buf.data() + (pos - m_start);
+    }
+
+    // start of the known miss run pos is in, pos itself if it's not in one
+    off_t skip_misses(off_t pos) const {
+        return (pos >= m_miss_lo && pos < m_miss_hi) ? m_miss_lo : pos;
+    }
+
+    // page-aligned pos failed check_hbuf()
+    void add_miss(off_t pos) {
+        if( pos + (off_t)PAGE_SIZE == m_run_lo ){
+            m_run_lo = pos;
+        } else {
+            m_run_lo = pos;
+            m_run_hi = pos + PAGE_SIZE;
+        }
+        if( m_run_lo <= m_miss_hi && m_run_hi >= m_miss_lo ){
+            m_miss_lo = std::min(m_miss_lo, m_run_lo);
+            m_miss_hi = std::max(m_miss_hi, m_run_hi);
+        } else if( m_run_hi - m_run_lo > m_miss_hi - m_miss_lo ){
+            m_miss_lo = m_run_lo;
+            m_miss_hi = m_run_hi;
+        }
+    }
+
+    private:
+    void fill(off_t pos) {
+        m_start = std::max<off_t>(0, ((pos + PAGE_SIZE) & ~(off_t)(PAGE_SIZE-1)) - CHUNK_SIZE);
+        const size_t avail = m_start < m_fsize ? std::min<size_t>(m_buf.size(), m_fsize - m_start) : 0;
+        const size_t nread = avail ? m_reader.read_at(m_start, m_buf.data(), avail) : 0;
+        memset(m_buf.data() + nread, 0, m_buf.size() - nread);
+    }
+
+    Reader& m_reader;
+    const off_t m_fsize;
+    buf_t m_buf;
+    off_t m_start = -1;
+    off_t m_run_lo = -1, m_run_hi = -1;   // misses found by the current walk
+    off_t m_miss_lo = -1, m_miss_hi = -1; // longest known miss run
+};
+
+void saveFile(std::span<const uint8_t> fm, uint64_t hPos, const std::string in_fname, const std::string ext){
     std::filesystem::path out_fname = get_out_pathname(in_fname, fmt::format("{:012x}{}", hPos, ext));
     logger->trace("saving {}", out_fname);
 
@@ -470,6 +555,7 @@ void Scanner::scan(){
     static const char empty_md_chunk[PAGE_SIZE] = {0};
 
     Reader reader(m_fname);
+    reader.advise(Reader::Access::SEQUENTIAL);
     m_fsize = reader.size();
     Progress progress(m_fsize, m_start_offset);
 
@@ -484,10 +570,13 @@ void Scanner::scan(){
     std::unordered_set<off_t> visited_offsets;
     char fBuf[1024*1024];
     uint32_t firstMetaSize = 0;
-    buf_t fm;
+    pooled_buf_t fm; // not zero-filled on resize, always read over
     bool cncl = false;
     bool found = false;
     uint32_t obtBankId = 0;
+    PatternSearch emptyHash;
+    emptyHash.add(signatures::empty_block_digest());
+    BackwardWindow window(reader, m_fsize);
     off_t end_pos = m_fsize - sizeof(fBuf) + 1;
     if( end_pos < 0 ){
         end_pos = m_fsize;
@@ -507,13 +596,13 @@ void Scanner::scan(){
 //        while( (p = (char*)memmem(p+1, nread - ((char*)p - fBuf), &EMPTY_BLOCK_DIGEST, sizeof(EMPTY_BLOCK_DIGEST))) ){
         
         // TODO: check not only first found entry?
-        if( void* p = memmem(fBuf, nread, &EMPTY_BLOCK_DIGEST, sizeof(EMPTY_BLOCK_DIGEST)) ){
+        const size_t emptyPos = nread > 0 ? emptyHash.find_first(std::span<const uint8_t>((const uint8_t*)fBuf, nread)) : SIZE_MAX;
+        if( emptyPos != SIZE_MAX ){
             int64_t revHPos = 0;
-            int64_t hPos = filepos + (char*)p - fBuf;
+            int64_t hPos = filepos + emptyPos;
 
             logger->trace("{:012x}: empty block hash, firstMetaSize = {:x}", hPos, firstMetaSize);
 
-            char hBuf[PAGE_SIZE];
             int64_t inHPos = hPos;
             cncl = false;
             found = false;
@@ -527,13 +616,17 @@ void Scanner::scan(){
                 } else {
                     hPos--;
                 }
-                if( hPos > (int64_t)(m_fsize - sizeof(hBuf)) ){
+                if( hPos > (int64_t)(m_fsize - PAGE_SIZE) ){
                     hPos = m_fsize - 32*MAX_BANK_SIZE;
                     if( hPos < 0 ){
                         hPos = 0;
                     }
                 }
-                reader.read_at(hPos, hBuf, sizeof(hBuf));
+                if( (hPos & 0xfff) == 0 && window.skip_misses(hPos) != hPos ){
+                    hPos = window.skip_misses(hPos); // checked by an earlier walk
+                    continue;
+                }
+                const char* hBuf = window.page_at(hPos);
                 uint16_t castW = *(uint16_t*)hBuf;
                 char prehBuf = hBuf[2];
                 bool found = false;
@@ -552,7 +645,10 @@ void Scanner::scan(){
                     if( currMetaSize == 0 ){
                         throw std::runtime_error("currMetaSize is 0");
                     }
-                    reader.read_at(hPos, (char*)fm.data(), fm.size());
+                    size_t nread = reader.read_at(hPos, fm);
+                    if( nread < fm.size() ){
+                        memset(fm.data() + nread, 0, fm.size() - nread);
+                    }
 
                     bool vObtRes;
                     if( prehBuf == 0 ){
@@ -585,7 +681,7 @@ void Scanner::scan(){
                                     if( fMetas.size() < obtBankId+1 ){
                                         fMetas.resize(obtBankId+1);
                                     }
-                                    fMetas[obtBankId] = fm;
+                                    fMetas[obtBankId].assign(fm.begin(), fm.end());
                                     logger->info("Found meta ID {:x} entry at {:08x}", obtBankId, hPos);
                                     found = true;
                                 }
@@ -593,7 +689,7 @@ void Scanner::scan(){
                                 // fm holds mirror of actual obtained Meta
                                 // TODO: add procedure of comparing content of
                                 // actual meta, and mirror meta and merge two of them to get one functional Meta
-                                if( fm == fMetas[obtBankId] ){
+                                if( std::equal(fm.begin(), fm.end(), fMetas[obtBankId].begin(), fMetas[obtBankId].end()) ){
                                     logger->info("meta ID {:x} mirror at {:08x} - is coherent with already obtained Meta content", obtBankId, hPos);
                                 } else {
                                     logger->warn("meta ID {:x} mirror at {:08x} - is not coherent, need repair and merge meta tables", obtBankId, hPos);
@@ -617,8 +713,7 @@ void Scanner::scan(){
                             }
                             found = false;
                             cncl = true;
-                            reader.read_at(hPos + currMetaSize, hBuf, sizeof(hBuf));
-                            if( check_hbuf(hBuf) ){
+                            if( check_hbuf(window.page_at(hPos + currMetaSize)) ){
                                 hPos += currMetaSize + 1;
                             } else {
                                 hPos += currMetaSize + 0xff000 + 1;
@@ -639,6 +734,8 @@ void Scanner::scan(){
                     } else {
                         throw std::runtime_error("vObtainMetaId Unknown Exception, Failed to get Meta ID");
                     }
+                } else if( !visited && (hPos & 0xfff) == 0 ){
+                    window.add_miss(hPos);
                 }
             } // while( hPos > (inHPos-MAX_BANK_SIZE*32) )
 
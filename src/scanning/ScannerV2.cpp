@@ -12,12 +12,14 @@
 #include "ScannerV2.hpp"
 #include "utils/common.hpp"
 #include "core/structs.hpp"
+#include "ScanCheckpoint.hpp"
 
 #include <lz4.h>
 #include <zlib.h>
 
 #include <fstream>
 #include <cstring>
+#include <cinttypes>
 #include <algorithm>
 #include <span>
 #include <array>
@@ -29,6 +31,14 @@ using BankInfo = CSlot::BankInfo;
 constexpr size_t MAX_COMP_SIZE = LZ4_COMPRESSBOUND(BLOCK_SIZE);
 constexpr size_t BITMAP_BLOCK_SIZE = PAGE_SIZE; // 4kb
 
+static uint64_t calc_bank_id(const BankInfo& bi) {
+    return ((uint64_t)bi.crc << 32) | (uint64_t)bi.size;
+}
+
+static std::string gen_bank_fname(uint64_t id) {
+    return fmt::format("_{:08x}_{:08x}.bank", (uint32_t)(id >> 32), (uint32_t)id);
+}
+
 /**
  * @brief Initializes the scanner and opens output files.
  *
@@ -36,6 +46,12 @@ constexpr size_t BITMAP_BLOCK_SIZE = PAGE_SIZE; // 4kb
  * for tracking scanned regions if data block carving is enabled.
  */
 void ScannerV2::start() {
+    m_scan_start = m_start;
+    if (m_resume) {
+        load_checkpoint(); // before the csv files are opened, it cuts them back
+    }
+    m_last_checkpoint = std::chrono::steady_clock::now();
+
         if (!m_keysets_dump.empty()) {
         if (!load_keysets_dump(m_keysets_dump)) {
             logger->warn("Failed to load keysets from {}", m_keysets_dump);
@@ -43,22 +59,269 @@ void ScannerV2::start() {
     }
 
     if (m_find_blocks) {
-        m_decomp_buf.resize(MAX_COMP_SIZE);
+        m_data_sigs = PatternSearch();
+        m_data_sigs.add(signatures::lz_hdr(PAGE_SIZE));
+        m_data_sigs.add(signatures::zlib_header(PAGE_SIZE));
+        m_data_sigs.add(signatures::text("<OibSummary>", PAGE_SIZE));
+        logger->debug("signature search: {}", PatternSearch::isa_name(m_data_sigs.isa()));
+
+        m_data_ctx.clear();
+        for (unsigned i = 0; i < m_threads; i++) {
+            m_data_ctx.push_back(std::make_unique<DataCtx>());
+            m_data_ctx.back()->decomp_buf.resize(MAX_COMP_SIZE);
+        }
+        m_data_ctx[0]->out = &m_page_results.emplace_back();
+        for (unsigned i = 1; i < m_threads; i++) {
+            m_workers.emplace_back(&ScannerV2::worker_proc, this, i);
+        }
+        if (m_threads > 1) {
+            logger->info("probing data blocks on {} threads", m_threads);
+        }
+        const bool append = m_start != 0 || m_skip_covered || m_resume;
+        const std::filesystem::path log_fname = get_out_pathname(m_fname, CarvedLog::FNAME);
+        logger->info("carving data blocks to {}{}", log_fname.string(), append ? " [append]" : "");
+        m_good_blocks_log = std::make_unique<CarvedLog>(log_fname, append);
+        const auto mode = std::ios::out | std::ios::binary | (append ? std::ios::app : std::ios::trunc);
         std::filesystem::path out_fname = get_out_pathname(m_fname, "carved_blocks.csv");
-        logger->info("carving data blocks to {}{}", out_fname.string(), (m_start == 0) ? "" : " [append]");
-        const auto mode = std::ios::out | std::ios::binary | ((m_start == 0) ? std::ios::trunc : std::ios::app);
-        m_good_blocks_csv = std::ofstream(out_fname, mode);
-        if (!m_good_blocks_csv.is_open()) {
-            logger->error("Failed to open output file {}: {}", out_fname.string(), std::strerror(errno));
-            throw std::runtime_error("Failed to open output file");
+        if (m_write_csv) {
+            m_good_blocks_csv = std::ofstream(out_fname, mode);
+            if (!m_good_blocks_csv.is_open()) {
+                logger->error("Failed to open output file {}: {}", out_fname.string(), std::strerror(errno));
+                throw std::runtime_error("Failed to open output file");
+            }
+        } else if (!append) {
+            std::filesystem::remove(out_fname); // of an earlier scan, it would not match carved_blocks.bin
         }
 
         m_bad_blocks_csv = std::ofstream(get_out_pathname(m_fname, "bad_blocks.csv"), mode);
+    }
+    if (m_find_blocks || m_skip_covered) {
         m_bitmap = std::make_unique<BitFileMappedArray>(get_out_pathname(m_fname, "carved_blocks.map"), m_reader.size() / BITMAP_BLOCK_SIZE);
     }
+    if (m_skip_covered) {
+        find_covered_runs();
+        load_earlier_metadata();
+    }
     DblBufScanner::start();
 }
 
+void ScannerV2::buf_done(off_t next_offset) {
+    if (m_checkpoint_interval == 0 || std::chrono::steady_clock::now() - m_last_checkpoint < std::chrono::seconds(m_checkpoint_interval)) {
+        return;
+    }
+    try {
+        save_checkpoint(next_offset);
+    } catch (const std::exception& e) {
+        // the scan itself is fine, a later checkpoint may succeed
+        logger->error("{}", e.what());
+    }
+    m_last_checkpoint = std::chrono::steady_clock::now();
+}
+
+// size of a block list the interrupted scan didn't write (carved_blocks.csv with --no-csv)
+static constexpr uint64_t NOT_WRITTEN = ~0ULL;
+
+/**
+ * @brief Saves the scan state, everything before offset is processed.
+ *
+ * Outputs are made durable first (csv files, carved_blocks.bin, bitmap, slot
+ * and bank files), so the checkpoint never refers to data that a power loss
+ * could take away. The sizes of the block lists are recorded, a resumed scan
+ * cuts off rows written after them.
+ *
+ * @param offset Offset the resumed scan starts at.
+ * @throws std::runtime_error If the checkpoint can't be written.
+ */
+void ScannerV2::save_checkpoint(off_t offset) {
+    ScanCheckpoint::Out out;
+    for (auto* csv : {&m_good_blocks_csv, &m_bad_blocks_csv}) {
+        const auto fname = get_out_pathname(m_fname, csv == &m_good_blocks_csv ? "carved_blocks.csv" : "bad_blocks.csv");
+        uint64_t size = NOT_WRITTEN;
+        if (csv->is_open()) {
+            csv->flush();
+            ScanCheckpoint::sync_file(fname);
+            size = std::filesystem::file_size(fname);
+        }
+        out.put(size);
+    }
+    uint64_t log_size = 0;
+    if (m_good_blocks_log) {
+        const auto fname = get_out_pathname(m_fname, CarvedLog::FNAME);
+        m_good_blocks_log->flush();
+        ScanCheckpoint::sync_file(fname);
+        log_size = std::filesystem::file_size(fname);
+    }
+    out.put(log_size);
+    if (m_bitmap) {
+        m_bitmap->flush();
+    }
+    flush_files();
+    for (const auto& [slot_offset, _] : m_slots_map) {
+        ScanCheckpoint::sync_file(get_out_pathname(m_fname, fmt::format("{:012x}.slot", slot_offset)));
+    }
+    for (const auto& [bank_id, _] : m_bank_usagecnt) {
+        ScanCheckpoint::sync_file(get_out_pathname(m_fname, gen_bank_fname(bank_id)));
+    }
+
+    out.put<uint64_t>(m_slots_map.size());
+    for (const auto& [slot_offset, si] : m_slots_map) {
+        out.put(slot_offset);
+        out.put_all(si.crc_map);
+        out.put_all(si.offset_map);
+    }
+    out.put_all(m_sbis);
+    out.put_all(m_checked_offsets.offsets(offset)); // the ones behind won't be seen again
+    out.put_all(m_bank_usagecnt);
+    out.put_all(m_seen_bank_ids);
+    out.put_all(m_seen_slot_fingerprints);
+    out.put(m_failed_guess);
+    out.put(m_is_encrypted);
+    out.put(m_current_bank_id);
+    out.put_all(m_seen_bank_crcs);
+    out.put_all(m_bank_id_to_bank);
+    out.put_all(m_bank_crc_to_bank_id);
+
+    ScanCheckpoint::Header hdr;
+    hdr.source_size = m_reader.size();
+    hdr.start = m_scan_start;
+    hdr.end = m_end;
+    hdr.offset = offset;
+    hdr.flags = (m_find_blocks ? ScanCheckpoint::F_BLOCKS : 0) | (m_carve_mode ? ScanCheckpoint::F_CARVE : 0);
+    ScanCheckpoint::save(ScanCheckpoint::pathname(m_fname), hdr, out.data());
+    logger->debug("checkpoint at {:x}: {} slots, {} banks", offset, m_slots_map.size(), m_seen_bank_ids.size());
+}
+
+/**
+ * @brief Restores the state saved by an interrupted scan.
+ *
+ * @throws std::runtime_error If the checkpoint is missing, corrupted, or doesn't match the outputs.
+ * @throws std::invalid_argument If it belongs to another source, range or scan mode.
+ */
+void ScannerV2::load_checkpoint() {
+    const auto fname = ScanCheckpoint::pathname(m_fname);
+    std::string payload;
+    const auto hdr = ScanCheckpoint::load(fname, &payload);
+    if (hdr.source_size != m_reader.size() || hdr.offset != (uint64_t)m_start || hdr.end != (uint64_t)m_end) {
+        throw std::invalid_argument(fmt::format("{} was made for another source or scan range", fname.string()));
+    }
+    const uint32_t flags = (m_find_blocks ? ScanCheckpoint::F_BLOCKS : 0) | (m_carve_mode ? ScanCheckpoint::F_CARVE : 0);
+    if (hdr.flags != flags) {
+        throw std::invalid_argument(fmt::format("the interrupted scan ran {} --blocks and {} --carve, resume it with the same options",
+            (hdr.flags & ScanCheckpoint::F_BLOCKS) ? "with" : "without", (hdr.flags & ScanCheckpoint::F_CARVE) ? "with" : "without"));
+    }
+
+    ScanCheckpoint::In in(std::move(payload));
+    for (const char* name : {"carved_blocks.csv", "bad_blocks.csv", CarvedLog::FNAME}) {
+        const uint64_t size = in.get<uint64_t>();
+        if (!m_find_blocks || size == NOT_WRITTEN) {
+            continue;
+        }
+        const auto csv_fname = get_out_pathname(m_fname, name);
+        const uint64_t cur_size = std::filesystem::exists(csv_fname) ? std::filesystem::file_size(csv_fname) : 0;
+        if (cur_size < size) {
+            throw std::runtime_error(fmt::format("{} is shorter than at the checkpoint ({} < {})", csv_fname.string(), cur_size, size));
+        }
+        if (cur_size > size) {
+            std::filesystem::resize_file(csv_fname, size); // rows of the lost part are found again
+        }
+    }
+
+    const uint64_t nslots = in.get<uint64_t>();
+    for (uint64_t i = 0; i < nslots; i++) {
+        auto& si = m_slots_map[in.get<uint64_t>()];
+        in.get_all(si.crc_map);
+        in.get_all(si.offset_map);
+    }
+    in.get_all(m_sbis);
+    std::vector<uint64_t> checked_offsets;
+    in.get_all(checked_offsets);
+    for (uint64_t offset : checked_offsets) {
+        m_checked_offsets.insert(offset);
+    }
+    in.get_all(m_bank_usagecnt);
+    in.get_all(m_seen_bank_ids);
+    in.get_all(m_seen_slot_fingerprints);
+    m_failed_guess = in.get<bool>();
+    m_is_encrypted = in.get<bool>();
+    m_current_bank_id = in.get<uint32_t>();
+    in.get_all(m_seen_bank_crcs);
+    in.get_all(m_bank_id_to_bank);
+    in.get_all(m_bank_crc_to_bank_id);
+    if (!in.eof()) {
+        throw std::runtime_error(fmt::format("{}: checkpoint has trailing data", fname.string()));
+    }
+
+    m_scan_start = hdr.start;
+    logger->info("resuming the scan started at {:x} from {:x}: {} slots, {} banks known", hdr.start, hdr.offset, m_slots_map.size(), m_seen_bank_ids.size());
+}
+
+/**
+ * @brief Remembers the slots and banks saved by earlier scans of the source.
+ *
+ * Their pages are covered and won't be seen again, so without this a mirrored
+ * copy in an uncovered region would be saved as a new slot, and its banks
+ * would be taken for banks without a slot.
+ */
+void ScannerV2::load_earlier_metadata() {
+    size_t nslots = 0, nbanks = 0;
+    for (const auto& entry : std::filesystem::directory_iterator(get_out_dir(m_fname))) {
+        const std::string name = entry.path().filename().string();
+        uint64_t offset, crc, size;
+        if (name.size() == 17 && name.ends_with(".slot") && sscanf(name.c_str(), "%12" SCNx64, &offset) == 1) {
+            std::ifstream f(entry.path(), std::ios::binary);
+            std::vector<uint8_t> data(entry.file_size());
+            f.read((char*)data.data(), data.size());
+            const CSlot* slot = (const CSlot*)data.data();
+            if (data.size() >= sizeof(CSlot) && slot->valid_fast() && slot->size() <= data.size() && slot->valid_crc()) {
+                m_seen_slot_fingerprints.emplace(slot->fingerprint(), offset);
+                for (uint32_t i = 0; i < slot->allocated_banks; i++) {
+                    m_seen_bank_ids.insert(calc_bank_id(slot->bankInfos[i]));
+                }
+                nslots++;
+            }
+        } else if (name.size() == 23 && name.ends_with(".bank") && sscanf(name.c_str(), "_%8" SCNx64 "_%8" SCNx64, &crc, &size) == 2) {
+            m_seen_bank_ids.insert(crc << 32 | size);
+            nbanks++;
+        }
+    }
+    logger->info("{} slot{} and {} bank{} saved by earlier scans", nslots, nslots == 1 ? "" : "s", nbanks, nbanks == 1 ? "" : "s");
+}
+
+/**
+ * @brief Collects the runs of the bitmap that are big enough to be skipped without reading.
+ *
+ * Smaller covered runs are read with the surrounding data, their pages are skipped
+ * by process_buf(). The list is built before the scan starts, so the reader
+ * doesn't depend on bits set while scanning.
+ */
+void ScannerV2::find_covered_runs() {
+    m_covered_runs.clear();
+    const size_t nbits = m_bitmap->size_bits();
+    size_t covered = 0;
+    for (size_t i = m_bitmap->find_first(true, 0); i < nbits; ) {
+        const size_t e = m_bitmap->find_first(false, i);
+        covered += e - i;
+        if ((e - i) * BITMAP_BLOCK_SIZE >= MIN_SKIP_SIZE) {
+            m_covered_runs.emplace_back(i * BITMAP_BLOCK_SIZE, e * BITMAP_BLOCK_SIZE);
+        }
+        i = m_bitmap->find_first(true, e);
+    }
+    logger->info("{} of {} already covered by earlier scans, {} run{} skipped without reading",
+        bytes2human(covered * BITMAP_BLOCK_SIZE), bytes2human(m_reader.size()), m_covered_runs.size(), m_covered_runs.size() == 1 ? "" : "s");
+}
+
+off_t ScannerV2::find_skip(off_t pos, off_t& data_end) {
+    auto it = std::upper_bound(m_covered_runs.begin(), m_covered_runs.end(), pos,
+        [](off_t p, const std::pair<off_t, off_t>& run) { return p < run.first; });
+    if (it != m_covered_runs.begin() && std::prev(it)->second > pos) {
+        return std::min(std::prev(it)->second, data_end);
+    }
+    if (it != m_covered_runs.end() && it->first < data_end) {
+        data_end = it->first;
+    }
+    return pos;
+}
+
 bool ScannerV2::load_keysets_dump(const std::filesystem::path& path) {
     std::ifstream in(path, std::ios::binary);
     if (!in) {
@@ -91,6 +354,16 @@ bool ScannerV2::load_keysets_dump(const std::filesystem::path& path) {
         crypto::register_keyset(m_aes_keys, m_aes_ciphers, id, aes);
     }
     logger->info("Loaded {} keyset{} from {}", m_aes_keys.size(), m_aes_keys.size() == 1 ? "" : "s", path.string());
+
+    // all keysets are tried on every page that isn't a plain block, same order as m_aes_ciphers
+    m_key_trial.clear();
+    m_trial_keys.clear();
+    for (const auto& [id, c] : m_aes_ciphers) {
+        if (c) {
+            m_key_trial.add(*c);
+            m_trial_keys.emplace_back(&id, c.get());
+        }
+    }
     return true;
 }
 
@@ -103,53 +376,234 @@ const crypto::AES256* ScannerV2::get_aes_cipher(const digest_t& id) const {
     return it->second.get();
 }
 
-void ScannerV2::process_buf(const buf_t& buf, off_t file_offset) {
+ScannerV2::~ScannerV2() {
+    stop_workers();
+}
+
+/**
+ * @brief Scans one buffer for slots, banks and (optionally) data blocks.
+ *
+ * Slots and banks are checked on the calling thread in file order, because
+ * they update the shared slot/bank maps and m_checked_offsets. Data block
+ * probes depend on nothing but the source data, so with several threads they
+ * are run for the whole buffer up front and their results are applied here in
+ * file order, producing exactly the same output as a single-threaded scan.
+ *
+ * @param buf Buffer contents.
+ * @param file_offset File offset of the buffer start.
+ */
+void ScannerV2::process_buf(std::span<const uint8_t> buf, off_t file_offset) {
     if (buf.size() < PAGE_SIZE) {
         logger->warn("{:x}: buf size {} is smaller than PAGE_SIZE, skipping scan", file_offset, buf.size());
         return;
     }
+
+    const size_t npages = (buf.size() - PAGE_SIZE) / PAGE_SIZE + 1;
+    // almost every page fails all checks below, only candidates reach the validators
+    m_page_class.resize(npages);
+    PageFilter::classify(buf.data(), npages, m_page_class.data());
+    if (m_skip_covered) {
+        // taken before any page of this buffer is processed, so the result doesn't depend on the number of threads
+        m_page_covered.assign(npages, 0);
+        for (size_t i = 0; i < npages; i++) {
+            const off_t offset = file_offset + i * PAGE_SIZE;
+            const size_t bit = offset / BITMAP_BLOCK_SIZE;
+            m_page_covered[i] = offset % BITMAP_BLOCK_SIZE == 0 && bit < m_bitmap->size_bits() && m_bitmap->get(bit);
+        }
+    }
+    if (m_find_blocks) {
+        // one pass over the buffer for all plaintext signatures, pages without any skip those probes
+        m_page_sigs.assign(npages, 0);
+        m_sig_matches.clear();
+        m_data_sigs.find(buf, m_sig_matches, 0, (npages - 1) * PAGE_SIZE + 1);
+        for (const auto& m : m_sig_matches) {
+            m_page_sigs[m.pos / PAGE_SIZE] |= 1 << m.id;
+        }
+    }
+
+    const bool parallel = m_find_blocks && m_threads > 1;
+    if (parallel) {
+        scan_data_parallel(buf, file_offset, npages);
+    }
+
     for(size_t pos=0; pos <= buf.size() - PAGE_SIZE; pos += PAGE_SIZE){
-        if( m_checked_offsets.find(file_offset + pos) != m_checked_offsets.end() ){
+        if( m_checked_offsets.contains(file_offset + pos) ){
+            continue;
+        }
+        if (m_skip_covered && m_page_covered[pos / PAGE_SIZE]) {
             continue;
         }
         // at least PAGE_SIZE of data is available
-        check_slot(buf, file_offset, pos);
-        check_bank(buf, file_offset, pos);
+        const uint8_t page_class = m_page_class[pos / PAGE_SIZE];
+        if (page_class & PageFilter::SLOT) {
+            check_slot(buf, file_offset, pos);
+        }
+        if (page_class & PageFilter::BANK) {
+            check_bank(buf, file_offset, pos);
+        }
         if (m_find_blocks) {
-            if( !check_data(buf, file_offset, pos) ) {
-                if( is_all_zero(buf.data() + pos, PAGE_SIZE) ){
-                    set_bitmap(file_offset + pos, PAGE_SIZE); // mark empty pages as occupied bc there is no point in scanning them again
-                }
+            if (parallel) {
+                apply_data_result(m_page_results[pos / PAGE_SIZE]);
+            } else {
+                DataCtx& ctx = *m_data_ctx[0];
+                ctx.out->clear();
+                check_page_data(ctx, buf, file_offset, pos);
+                apply_data_result(*ctx.out);
             }
         }
     }
 }
 
-static uint64_t calc_bank_id(const BankInfo& bi) {
-    return ((uint64_t)bi.crc << 32) | (uint64_t)bi.size;
+/**
+ * @brief Marks a hole of a sparse source in the bitmap without scanning it.
+ *
+ * Holes read as zeros, so the result is the same as marking each empty page in
+ * check_page_data(). Blocks that start before the hole and extend into it are
+ * found by the preceding buffer.
+ *
+ * @param file_offset File offset of the hole, page-aligned.
+ * @param size Size of the hole.
+ */
+void ScannerV2::process_hole(off_t file_offset, size_t size) {
+    // only whole pages, like process_buf(), a partial last page is not in the bitmap anyway
+    size &= ~(PAGE_SIZE - 1);
+    if (m_find_blocks && size > 0) {
+        set_bitmap(file_offset, size);
+    }
 }
 
-static std::string gen_bank_fname(uint64_t id) {
-    return fmt::format("_{:08x}_{:08x}.bank", (uint32_t)(id >> 32), (uint32_t)id);
+// probes one page for data blocks, result goes to ctx.out
+void ScannerV2::check_page_data(DataCtx& ctx, std::span<const uint8_t> buf, off_t file_offset, size_t pos) {
+    if (m_skip_covered && m_page_covered[pos / PAGE_SIZE]) {
+        return;
+    }
+    ctx.out->ok = check_data(ctx, buf, file_offset, pos, m_page_sigs[pos / PAGE_SIZE]);
+    if( !ctx.out->ok && (m_page_class[pos / PAGE_SIZE] & PageFilter::ZERO) ){
+        ctx.out->bitmap.emplace_back(file_offset + pos, PAGE_SIZE); // mark empty pages as occupied bc there is no point in scanning them again
+    }
+}
+
+void ScannerV2::apply_data_result(const DataResult& r) {
+    for (const char* key : r.found) {
+        found(key);
+    }
+    if (!r.good_log.empty()) {
+        m_good_blocks_log->append(r.good_log);
+    }
+    if (!r.good_csv.empty()) {
+        m_good_blocks_csv << r.good_csv;
+    }
+    if (!r.bad_csv.empty()) {
+        m_bad_blocks_csv << r.bad_csv;
+    }
+    for (const auto& [offset, size] : r.bitmap) {
+        set_bitmap(offset, size);
+    }
 }
 
+/**
+ * @brief Runs data block probes for every page of a buffer on all threads.
+ *
+ * Pages are handed out in small batches through an atomic counter, the scan
+ * thread takes part as well. Blocks crossing the end of the buffer are read
+ * from the source by the probes themselves, same as in single-threaded mode.
+ *
+ * @param buf Buffer contents.
+ * @param file_offset File offset of the buffer start.
+ * @param npages Number of pages to probe.
+ * @throws Any exception thrown by a probe, rethrown on the scan thread.
+ */
+void ScannerV2::scan_data_parallel(std::span<const uint8_t> buf, off_t file_offset, size_t npages) {
+    if (m_page_results.size() < npages) {
+        m_page_results.resize(npages);
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_work_mutex);
+        m_work_buf = buf;
+        m_work_offset = file_offset;
+        m_work_next_page = 0;
+        m_work_busy = m_workers.size();
+        m_work_gen++;
+    }
+    m_work_cv.notify_all();
+
+    try {
+        scan_data_pages(*m_data_ctx[0]);
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(m_work_mutex);
+        if (!m_work_error) m_work_error = std::current_exception();
+        m_work_next_page = SIZE_MAX / 2; // make the workers stop early
+    }
 
-static uint64_t calc_slot_fingerprint(const CSlot* slot) {
-    uint64_t h = 1469598103934665603ULL;
-    for (uint32_t i = 0; i < slot->allocated_banks; i++) {
-        const auto& bi = slot->bankInfos[i];
-        h ^= bi.crc;  h *= 1099511628211ULL;
-        h ^= bi.size; h *= 1099511628211ULL;
+    std::unique_lock<std::mutex> lock(m_work_mutex);
+    m_work_done_cv.wait(lock, [&] { return m_work_busy == 0; });
+    if (m_work_error) {
+        std::rethrow_exception(std::exchange(m_work_error, nullptr));
     }
-    return h;
 }
 
+void ScannerV2::scan_data_pages(DataCtx& ctx) {
+    constexpr size_t BATCH = 16;
+    const size_t npages = (m_work_buf.size() - PAGE_SIZE) / PAGE_SIZE + 1;
+    for (size_t first; (first = m_work_next_page.fetch_add(BATCH)) < npages; ) {
+        for (size_t i = first; i < std::min(first + BATCH, npages); i++) {
+            ctx.out = &m_page_results[i];
+            ctx.out->clear();
+            check_page_data(ctx, m_work_buf, m_work_offset, i * PAGE_SIZE);
+        }
+    }
+}
 
-void ScannerV2::save_bank(const BankInfo& bi){
+void ScannerV2::worker_proc(size_t idx) {
+    uint64_t gen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(m_work_mutex);
+            m_work_cv.wait(lock, [&] { return m_work_stop || m_work_gen != gen; });
+            if (m_work_stop) {
+                return;
+            }
+            gen = m_work_gen;
+        }
+
+        try {
+            scan_data_pages(*m_data_ctx[idx]);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(m_work_mutex);
+            if (!m_work_error) m_work_error = std::current_exception();
+            m_work_next_page = SIZE_MAX / 2;
+        }
+
+        std::lock_guard<std::mutex> lock(m_work_mutex);
+        if (--m_work_busy == 0) {
+            m_work_done_cv.notify_one();
+        }
+    }
+}
+
+void ScannerV2::stop_workers() {
+    {
+        std::lock_guard<std::mutex> lock(m_work_mutex);
+        m_work_stop = true;
+    }
+    m_work_cv.notify_all();
+    for (auto& t : m_workers) {
+        if (t.joinable()) t.join();
+    }
+    m_workers.clear();
+}
+
+
+// data: the bank as found, usually still in the scan buffer; read again only if it's shorter than the bank
+void ScannerV2::save_bank(const BankInfo& bi, std::span<const uint8_t> data){
     uint64_t bank_id = calc_bank_id(bi);
     std::string fname = gen_bank_fname(bank_id);
 
-    save_file(fname, bi.offset, bi.size);
+    if (data.size() >= bi.size) {
+        save_file(fname, data.first(bi.size));
+    } else {
+        save_file(fname, bi.offset, bi.size);
+    }
 
     if( m_bank_usagecnt.find(bank_id) == m_bank_usagecnt.end() ){ // do nothing for repeating banks
         m_bank_usagecnt[bank_id] = 0;
@@ -234,14 +688,25 @@ uint32_t ScannerV2::guess_bank_id(const CBank* bank, uint32_t bank_crc) {
 }
 
 void ScannerV2::finish() {
+    stop_workers();
     DblBufScanner::finish();
 
+    size_t zlib_probes = 0, zlib_rejected = 0;
+    for (const auto& ctx : m_data_ctx) {
+        zlib_probes += ctx->zlib.probes();
+        zlib_rejected += ctx->zlib.rejected();
+    }
+    if (zlib_probes > 0) {
+        logger->debug("zlib candidates: {}, {} rejected by the probe", zlib_probes, zlib_rejected);
+    }
+
     if (!m_carve_mode && m_slots_map.empty() && m_is_encrypted && m_bank_id_to_bank.size() <= 1) {
         logger->warn("Encrypted banks detected and no bank was decrypted - skipping synthetic slot reconstruction");
     }
     
     // build a synthetic slot if we found banks but no slot metadata
-    if (!m_carve_mode && m_slots_map.empty() && m_bank_id_to_bank.size() > 1 && !m_failed_guess) {
+    // slots of earlier scans (--skip-covered) are not in m_slots_map, but rule it out as well
+    if (!m_carve_mode && m_slots_map.empty() && m_seen_slot_fingerprints.empty() && m_bank_id_to_bank.size() > 1 && !m_failed_guess) {
         logger->info("No slots found, creating synthetic slot from {} inferred banks", m_bank_id_to_bank.size());
         
         // allocate slot structure (max_banks is always 0x7f00)
@@ -321,12 +786,19 @@ void ScannerV2::finish() {
             logger->debug("Adding bank {:02x}: slot offset {:x}, size {:x}", 
                          bank_id, slot_offset, bank_size);
             
-            // read bank from source file
+            // the bank was saved when it was found, the source is read again only if that file is gone
+            std::span<const uint8_t> bank_view;
             bank_buf.resize(bank_size);
-            m_reader.read_at(bank_info.offset, bank_buf.data(), bank_size);
-            
+            std::ifstream bank_file(get_out_pathname(m_fname, gen_bank_fname(calc_bank_id(bank_info))), std::ios::binary);
+            if (bank_file.read(reinterpret_cast<char*>(bank_buf.data()), bank_size)) {
+                bank_view = bank_buf;
+            } else {
+                logger->debug("Bank {:02x} not saved, reading it from the source", bank_id);
+                bank_view = m_reader.view(bank_info.offset, bank_size, bank_buf);
+            }
+
             slot_append.seek(slot_offset);
-            slot_append.write(bank_buf.data(), bank_size);
+            slot_append.write(bank_view.data(), bank_size);
         }
         
         logger->info("Slot created successfully at {}", slot_path.string());
@@ -344,9 +816,15 @@ void ScannerV2::finish() {
             }
         }
     }
+
+    if (m_checkpoint_interval != 0 || m_resume) {
+        // the scan is complete, nothing to resume
+        std::error_code ec;
+        std::filesystem::remove(ScanCheckpoint::pathname(m_fname), ec);
+    }
 }
 
-void ScannerV2::check_bank(const buf_t& buf, off_t file_offset, size_t pos) {
+void ScannerV2::check_bank(std::span<const uint8_t> buf, off_t file_offset, size_t pos) {
     const off_t bank_offset = file_offset + pos;
     // logger->trace("check_bank: file_offset: {:x}, pos: {:x}, bank_offset: {:x}", file_offset, pos, bank_offset);
 
@@ -356,11 +834,12 @@ void ScannerV2::check_bank(const buf_t& buf, off_t file_offset, size_t pos) {
 
     }
 
-    buf_t tmp;
+    pooled_buf_t tmp;
+    size_t avail = buf.size() - pos;
     if( bank->size() + pos >= buf.size() ){
-        tmp.resize(bank->size());
-        m_reader.read_at(bank_offset, tmp.data(), bank->size());
-        bank = (CBank*)tmp.data();
+        const auto view = m_reader.view(bank_offset, bank->size(), tmp);
+        bank = (const CBank*)view.data();
+        avail = view.size();
         if( !bank->valid_fast() ){ // may be invalid after reading, seen on bad ZFS array (CRC errors) on windows
             logger->warn_once("{:x}: Invalid Bank on 2nd read, but was valid on 1st", bank_offset);
             return;
@@ -372,7 +851,7 @@ void ScannerV2::check_bank(const buf_t& buf, off_t file_offset, size_t pos) {
     }
 
     bool decrypted = false;
-    buf_t decrypted_bank_raw;
+    pooled_buf_t decrypted_bank_raw;
     const CBank* bank_for_guess = bank;
     if (bank->is_encrypted() && !m_aes_ciphers.empty() && m_slots_map.empty() && !m_carve_mode) {
         decrypted_bank_raw.resize(bank->size());
@@ -382,22 +861,20 @@ void ScannerV2::check_bank(const buf_t& buf, off_t file_offset, size_t pos) {
         const auto* cipher = get_aes_cipher(bank_mut->header_page.keyset_id);
         if (cipher) {
             const auto encr_size = bank_mut->encr_size();
-            std::vector<uint8_t> bank_data(reinterpret_cast<uint8_t*>(bank_mut->data_pages[0].data),
-                                           reinterpret_cast<uint8_t*>(bank_mut->data_pages[0].data) + encr_size);
+            uint8_t* bank_data = reinterpret_cast<uint8_t*>(bank_mut->data_pages[0].data);
+            size_t data_size = 0;
             try {
-                cipher->decrypt(bank_data);
+                // in place, the copy above is ours
+                data_size = cipher->decrypt(bank_data, encr_size, true);
             } catch (const std::exception& e) {
                 logger->error("Failed to decrypt Bank @ {:12x} keyset {}: {}", bank_offset, bank_mut->header_page.keyset_id, e.what());
-                bank_data.clear();
                 //decryption failed, but the bank is likely valid and corrupted since it passed valid_fast()
                 m_current_bank_id++;
                 return;
             }
 
-            if (!bank_data.empty()) {
-                const auto padding_size = encr_size - bank_data.size();
-                memcpy(bank_mut->data_pages[0].data, bank_data.data(), bank_data.size());
-                memset(bank_mut->data_pages[0].data + bank_data.size(), 0, padding_size);
+            if (data_size != 0) {
+                memset(bank_data + data_size, 0, encr_size - data_size);
                 bank_mut->header_page.encr_size = 0;
                 bank_mut->header_page.keyset_id = digest_t(0);
                 decrypted = true;
@@ -413,7 +890,7 @@ void ScannerV2::check_bank(const buf_t& buf, off_t file_offset, size_t pos) {
             return;
         }
     } else {
-        if (!bank->valid_slow(tmp.empty() ? (buf.size() - pos) : tmp.size())) {
+        if (!bank->valid_slow(avail)) {
             return;
         }
     }
@@ -450,16 +927,25 @@ void ScannerV2::check_bank(const buf_t& buf, off_t file_offset, size_t pos) {
             }
             
     } else {
-        logger->info("Found Bank at {:12x}, crc {:08x}, size {:7x} {}", bank_offset, crc, bank->size(), process_bank(bank, crc, bank_offset));
+        logger->info("Found Bank at {:12x}, crc {:08x}, size {:7x} {}", bank_offset, crc, bank->size(), process_bank(bank, avail, crc, bank_offset));
     }
     
-    save_bank({crc, bank_offset, bank->size()});
+    save_bank({crc, bank_offset, bank->size()}, {reinterpret_cast<const uint8_t*>(bank), avail});
     m_checked_offsets.insert(bank_offset);
 }
 
-// - updates .slot files with matching bank
+// - updates .slot files with matching bank, avail bytes at bank are in memory
 // - returns string with bank description
-std::string ScannerV2::process_bank(const CBank* bank, uint32_t bank_crc, off_t bank_offset) {
+std::string ScannerV2::process_bank(const CBank* bank, size_t avail, uint32_t bank_crc, off_t bank_offset) {
+    // the slot's idea of the bank size may differ, more than what's in memory is read again
+    auto update_slot = [&](off_t slot_offset, const SlotBankInfo& sbi) {
+        if (sbi.info.size <= avail) {
+            update_file(slot_offset, ".slot", sbi.info.offset, {reinterpret_cast<const uint8_t*>(bank), sbi.info.size});
+        } else {
+            update_file(slot_offset, ".slot", sbi.info.offset, bank_offset, sbi.info.size);
+        }
+    };
+
     std::string s;
     if (bank->is_encrypted())
         s += fmt::format("{}[encrypted]{}", ANSI_COLOR_YELLOW, ANSI_COLOR_RESET);
@@ -478,7 +964,7 @@ std::string ScannerV2::process_bank(const CBank* bank, uint32_t bank_crc, off_t
                         s += fmt::format("{}[bank {:2x} of slot {:012x}]{}", ANSI_COLOR_GREEN, sbi.idx, slot_offset, ANSI_COLOR_RESET);
                         sbi.found = true;
                         nfound++;
-                        update_file(slot_offset, ".slot", sbi.info.offset, bank_offset, sbi.info.size);
+                        update_slot(slot_offset, sbi);
                         m_checked_offsets.insert(sbi.info.offset);
                         increment_bank_usagecnt(sbi.info);
                     }
@@ -488,7 +974,7 @@ std::string ScannerV2::process_bank(const CBank* bank, uint32_t bank_crc, off_t
                             s += fmt::format("[bank {:2x} of slot {:012x}]", sbi.idx, slot_offset);
                         }
                         nfound++;
-                        update_file(slot_offset, ".slot", sbi.info.offset, bank_offset, sbi.info.size);
+                        update_slot(slot_offset, sbi);
                         increment_bank_usagecnt(sbi.info);
                     }
                 }
@@ -504,7 +990,7 @@ std::string ScannerV2::process_bank(const CBank* bank, uint32_t bank_crc, off_t
                                 s += fmt::format("[bank {:2x} of slot {:012x}]", sbi.idx, slot_offset);
                             }
                             nfound++;
-                            update_file(slot_offset, ".slot", sbi.info.offset, bank_offset, sbi.info.size);
+                            update_slot(slot_offset, sbi);
                             // not updating usage count here, because we are not sure if this is the same bank
                         }
                     }
@@ -519,7 +1005,7 @@ std::string ScannerV2::process_bank(const CBank* bank, uint32_t bank_crc, off_t
     return s;
 }
 
-void ScannerV2::check_slot(const buf_t& buf, off_t file_offset, size_t pos) {
+void ScannerV2::check_slot(std::span<const uint8_t> buf, off_t file_offset, size_t pos) {
     const off_t slot_offset = file_offset + pos;
     // logger->trace("check_slot: file_offset: {:x}, pos: {:x}, slot_offset: {:x}", file_offset, pos, slot_offset);
 
@@ -532,9 +1018,7 @@ void ScannerV2::check_slot(const buf_t& buf, off_t file_offset, size_t pos) {
     buf_t slot_buf;
     if( slot->size() + pos >= buf.size() ){
         // TODO: make a test case
-        slot_buf.resize(slot->size());
-        m_reader.read_at(slot_offset, slot_buf.data(), slot->size());
-        slot = (const CSlot*)slot_buf.data();
+        slot = (const CSlot*)m_reader.view(slot_offset, slot->size(), slot_buf).data();
         if( !slot->valid_fast() ){ // may be invalid after reading, seen on bad ZFS array (CRC errors) on windows
             logger->warn_once("{:x}: Invalid Slot on 2nd read, but was valid on 1st", slot_offset);
             return;
@@ -543,7 +1027,7 @@ void ScannerV2::check_slot(const buf_t& buf, off_t file_offset, size_t pos) {
     // logger->trace("file_offset: {:x}, pos: {:x}, slot_offset: {:x}, slot_size: {:x}, slot: {}", file_offset, pos, slot_offset, slot->size(), slot->to_string());
     if( slot->valid_crc() ){
 
-        uint64_t fingerprint = calc_slot_fingerprint(slot);
+        uint64_t fingerprint = slot->fingerprint();
         auto it = m_seen_slot_fingerprints.find(fingerprint);
         if (it != m_seen_slot_fingerprints.end()) {
             logger->info(
@@ -564,7 +1048,7 @@ void ScannerV2::check_slot(const buf_t& buf, off_t file_offset, size_t pos) {
         for(uint32_t i=0; i<slot->allocated_banks; i++){
             logger->info("  bank {:02x}: {}", i, slot->bankInfos[i].to_string());
         }
-        save_file(fmt::format("{:012x}.slot", slot_offset), slot_offset, slot->size());
+        save_file(fmt::format("{:012x}.slot", slot_offset), {reinterpret_cast<const uint8_t*>(slot), slot->size()});
         set_bitmap(slot_offset, slot->size());
 
         // save slot info for later use
@@ -577,9 +1061,8 @@ void ScannerV2::check_slot(const buf_t& buf, off_t file_offset, size_t pos) {
             m_sbis.push_back({i, slot->bankInfos[i]});
             // fast path: try to get bank by offset; skip bank validation bc bank finder might not support it (yet)
             SlotBankInfo& sbi = m_sbis.back();
-            bank_buf.resize(sbi.info.size);
-            m_reader.read_at(sbi.info.offset, bank_buf.data(), sbi.info.size);
-            CBank* bank = (CBank*)bank_buf.data();
+            const auto bank_view = m_reader.view(sbi.info.offset, sbi.info.size, bank_buf);
+            const CBank* bank = (const CBank*)bank_view.data();
             if( bank->valid_fast() ){
                 const uint32_t crc = bank->calc_crc();
 
@@ -598,8 +1081,8 @@ void ScannerV2::check_slot(const buf_t& buf, off_t file_offset, size_t pos) {
                     }
                     m_seen_bank_ids.insert(bank_uid);
                     
-                    logger->info("Found Bank at {:12x}, crc {:08x}, size {:7x} {}", (uint64_t)sbi.info.offset, crc, bank->size(), process_bank(bank, crc, sbi.info.offset));
-                    save_bank({crc, sbi.info.offset, bank->size()});
+                    logger->info("Found Bank at {:12x}, crc {:08x}, size {:7x} {}", (uint64_t)sbi.info.offset, crc, bank->size(), process_bank(bank, bank_view.size(), crc, sbi.info.offset));
+                    save_bank({crc, sbi.info.offset, bank->size()}, bank_view);
                     m_checked_offsets.insert(sbi.info.offset);
                     // do not call found("banks") here because the bank was found implicitly
                 }
@@ -608,13 +1091,11 @@ void ScannerV2::check_slot(const buf_t& buf, off_t file_offset, size_t pos) {
     }
 }
 
-uint32_t ScannerV2::calc_bank_crc(const buf_t& buf, off_t file_offset, size_t buf_pos){
+uint32_t ScannerV2::calc_bank_crc(std::span<const uint8_t> buf, off_t file_offset, size_t buf_pos){
     buf_t tmp;
-    CBank* bank = (CBank*)(buf.data() + buf_pos);
+    const CBank* bank = (const CBank*)(buf.data() + buf_pos);
     if( bank->size() + buf_pos >= buf.size() ){
-        tmp.resize(bank->size());
-        m_reader.read_at(file_offset + buf_pos, tmp.data(), bank->size());
-        bank = (CBank*)tmp.data();
+        bank = (const CBank*)m_reader.view(file_offset + buf_pos, bank->size(), tmp).data();
     }
     return bank->calc_crc();
 }
@@ -629,41 +1110,36 @@ void ScannerV2::set_bitmap(off_t offset, size_t size) {
     m_bitmap->set_range(start_block, end_block + 1);
 }
 
-static inline bool is_zlib_header(const uint8_t* data);
+using signatures::is_zlib_header;
 
-bool ScannerV2::check_data(const buf_t& buf, off_t file_offset, size_t buf_pos) {
+bool ScannerV2::check_data(DataCtx& ctx, std::span<const uint8_t> buf, off_t file_offset, size_t buf_pos, uint8_t sigs) {
 
-    if (check_data_lz4(buf, file_offset, buf_pos))
+    if ((sigs & SIG_LZ4) && check_data_lz4(ctx, buf, file_offset, buf_pos))
         return true;
 
-    if (check_data_zlib(buf, file_offset, buf_pos))
+    if ((sigs & SIG_ZLIB) && check_data_zlib(ctx, buf, file_offset, buf_pos))
         return true;
 
-    if (check_data_xml(buf, file_offset, buf_pos))
+    if ((sigs & SIG_XML) && check_data_xml(ctx, buf, file_offset, buf_pos))
         return true;
 
 
-    // bruteforce through each keyset.
-    if (!m_aes_ciphers.empty()) {
-        for (const auto& [id, c] : m_aes_ciphers) {
-            if (!c) continue;
-
-            std::array<uint8_t, 16> dec{};
-            std::memcpy(dec.data(), buf.data() + buf_pos, dec.size());
-            try {
-                c->decrypt(dec.data(), dec.size(), false);
-            } catch (const std::exception&) {
-                continue;
-            }
+    // bruteforce through each keyset, the first block of the page is decrypted under all of them at once
+    if (!m_trial_keys.empty()) {
+        ctx.trial_plain.resize(m_trial_keys.size());
+        m_key_trial.decrypt_first_block(buf.data() + buf_pos, ctx.trial_plain.data());
+        for (size_t i = 0; i < m_trial_keys.size(); i++) {
+            const auto& dec = ctx.trial_plain[i];
+            const auto [id, c] = m_trial_keys[i];
             // check if we got any matches (for now only LZ4 encrypted blocks or uncompressed summary.xml is supported, otherwise the speed will be considerably slow because of false positives from the zlib check)
             const lz_hdr* plz = reinterpret_cast<const lz_hdr*>(dec.data());
-            if (plz->valid() && check_data_lz4(buf, file_offset, buf_pos, c.get(), &id)) {
+            if (plz->valid() && check_data_lz4(ctx, buf, file_offset, buf_pos, c, id)) {
                 return true;
             }
 
             static const std::string summary_head = "<OibSummary>";
-            if (dec.size() >= summary_head.size() && std::memcmp(dec.data(), summary_head.data(), summary_head.size()) == 0) {
-                if (check_data_xml(buf, file_offset, buf_pos, c.get(), &id)) {
+            if (std::memcmp(dec.data(), summary_head.data(), summary_head.size()) == 0) {
+                if (check_data_xml(ctx, buf, file_offset, buf_pos, c, id)) {
                     return true;
                 }
             }
@@ -676,81 +1152,103 @@ static inline bool is_valid_xml_char(const uint8_t c) {
     return c >= 0x20 || c == 9 || c == 10 || c == 13;
 }
 
-// find uncompressed summary.xml
-bool ScannerV2::check_data_xml(const buf_t& buf, off_t file_offset, size_t buf_pos, crypto::AES256 const* cipher, const Veeam::VBK::digest_t* keyset_id) {
+// find uncompressed summary.xml, decrypting it on the fly if cipher is set
+// the document is read in growing chunks, checked as it comes and the search stops at the closing tag,
+// so a candidate costs about its own size; random data usually fails the character check in the first chunk
+bool ScannerV2::check_data_xml(DataCtx& ctx, std::span<const uint8_t> buf, off_t file_offset, size_t buf_pos, crypto::AES256 const* cipher, const Veeam::VBK::digest_t* keyset_id) {
     static const std::string summary_head = "<OibSummary>";
     static const std::string summary_tail = "</OibSummary>";
 
     const off_t data_offset = file_offset + buf_pos;
+    const off_t buf_end = file_offset + buf.size();
+    const size_t remaining = (static_cast<uint64_t>(data_offset) < m_reader.size())
+        ? m_reader.size() - static_cast<size_t>(data_offset)
+        : 0;
+    const size_t max_size = std::min(remaining, MAX_XML_SIZE);
 
-    const uint8_t* data_ptr = buf.data() + buf_pos;
-    size_t data_size = buf.size() - buf_pos;
-    buf_t tmp;
-
+    uint8_t iv[16];
     if (cipher) {
-        const size_t remaining = (static_cast<uint64_t>(data_offset) < m_reader.size())
-            ? m_reader.size() - static_cast<size_t>(data_offset)
-            : 0;
-        size_t read_size = std::min(static_cast<size_t>(5 * 1024 * 1024), remaining);
-        if (read_size < summary_head.size()) {
-            return false;
-        }
-        tmp.resize(read_size);
-        m_reader.read_at(data_offset, tmp.data(), read_size);
-        cipher->decrypt(tmp, false, 0);
-        data_ptr = tmp.data();
-        data_size = tmp.size();
+        std::memcpy(iv, cipher->iv(), sizeof(iv));
     }
 
-    if (data_size < summary_head.size()) {
-        return false;
-    }
+    buf_t doc;
+    size_t chunk_size = XML_CHUNK_SIZE;
+    while (doc.size() < max_size) {
+        const size_t pos = doc.size();
+        size_t len = std::min(chunk_size, max_size - pos);
+        if (cipher) {
+            len &= ~size_t(15);
+        }
+        if (len == 0) {
+            break;
+        }
 
-    if (memcmp(data_ptr, summary_head.data(), summary_head.size()) != 0) {
-        return false; // not a summary.xml
-    }
+        // the scan buffer first, the reader for anything past its end
+        doc.resize(pos + len);
+        const off_t off = data_offset + pos;
+        size_t n = 0;
+        if (off < buf_end) {
+            n = std::min(len, static_cast<size_t>(buf_end - off));
+            std::memcpy(doc.data() + pos, buf.data() + (off - file_offset), n);
+        }
+        if (n < len) {
+            n += m_reader.read_at(off + n, doc.data() + pos + n, len - n);
+        }
+        if (cipher) {
+            n &= ~size_t(15);
+            cipher->decrypt_chunk(doc.data() + pos, n, iv);
+        }
+        doc.resize(pos + n);
 
-    auto it = std::search(data_ptr + summary_head.size(), data_ptr + data_size, summary_tail.begin(), summary_tail.end());
+        if (pos == 0 && (n < summary_head.size() || memcmp(doc.data(), summary_head.data(), summary_head.size()) != 0)) {
+            return false; // not a summary.xml
+        }
 
-    if (it == data_ptr + data_size && std::all_of(data_ptr, data_ptr + data_size, is_valid_xml_char)) {
-        logger->warn_once("{:x}: Found summary.xml without closing tag, TODO: read further", data_offset);
-        return false;
+        // the closing tag may straddle the previous chunk, everything before it must be text
+        const auto valid_end = std::find_if_not(doc.begin() + pos, doc.end(), is_valid_xml_char);
+        const size_t from = std::max(summary_head.size(), pos >= summary_tail.size() ? pos - summary_tail.size() + 1 : 0);
+        const auto it = std::search(doc.begin() + from, valid_end, summary_tail.begin(), summary_tail.end());
+        if (it != valid_end) {
+            int size = static_cast<int>(std::distance(doc.begin(), it) + summary_tail.size());
+            uint32_t crc = vcrc32(0, doc.data(), size);
+            ctx.out->found.push_back("raw blocks");
+            add_good_block(ctx, data_offset, size, size, ctx.md5.Calculate(doc.data(), size), crc, CT_NONE, keyset_id);
+            ctx.out->bitmap.emplace_back(data_offset, size); // mark the block as occupied
+            return true;
+        }
+        if (valid_end != doc.end() || n < len) {
+            return false; // binary data or the end of the source before the closing tag
+        }
+        chunk_size = std::min(chunk_size * 2, XML_MAX_CHUNK_SIZE);
     }
 
-    if (it != data_ptr + data_size && std::all_of(data_ptr, it, is_valid_xml_char)) {
-        int size = static_cast<int>(std::distance(data_ptr, it + summary_tail.size()));
-        uint32_t crc = vcrc32(0, data_ptr, size);
-        found("raw blocks");
-        add_good_block(data_offset, size, size, m_md5.Calculate(data_ptr, size), crc, "NONE", keyset_id);
-        set_bitmap(data_offset, size); // mark the block as occupied
-        return true;
+    if (doc.size() >= MAX_XML_SIZE) {
+        logger->warn_once("{:x}: Found summary.xml without closing tag in the first {} bytes", data_offset, bytes2human(doc.size()));
     }
     return false;
 }
 
 
-void ScannerV2::add_good_block(off_t offset, int comp_size, int raw_size, digest_t digest, uint32_t crc, const std::string& comp_type, const Veeam::VBK::digest_t* keyset_id) {
-    // if second column equals 3rd column => data is not compressed
-    // if second column is positive       => it's the compressed size
-    // if it's negative                   => it's the LZ4 return code
-    const std::string keyset_str = keyset_id ? fmt::format("{}", *keyset_id) : std::string();
-    std::string line;
-
-    line = fmt::format(
-        "{:012x};{:06x};{:06x};{};{:08x}",
-        offset, comp_size, raw_size, digest, crc
-    );
-    if (!comp_type.empty()) {
-        line += fmt::format(";{}", comp_type);
-    }
-    if (!keyset_str.empty()) {
-        line += fmt::format(";{}", keyset_str);
+void ScannerV2::add_good_block(DataCtx& ctx, off_t offset, int comp_size, int raw_size, digest_t digest, uint32_t crc, ECompType comp_type, const Veeam::VBK::digest_t* keyset_id) {
+    HashEntry entry{};
+    entry.offset = offset;
+    entry.hash = digest;
+    entry.keyset_id = keyset_id ? *keyset_id : digest_t(0);
+    entry.comp_size = comp_size;
+    entry.orig_size = raw_size;
+    entry.comp_type = comp_type;
+    entry.crc = crc;
+    ctx.out->good_log.push_back(entry);
+
+    if (m_write_csv) {
+        // if second column equals 3rd column => data is not compressed
+        // if second column is positive       => it's the compressed size
+        ctx.out->good_csv += CarvedLog::csv_row(entry);
+        ctx.out->good_csv += '\n';
     }
-    line += "\n";
-    m_good_blocks_csv << line;
 }
 // lz_hdr is aligned on page boundary
-bool ScannerV2::check_data_lz4(const buf_t& buf, off_t file_offset, size_t buf_pos, const crypto::AES256 * cipher, const Veeam::VBK::digest_t* keyset_id) {
+bool ScannerV2::check_data_lz4(DataCtx& ctx, std::span<const uint8_t> buf, off_t file_offset, size_t buf_pos, const crypto::AES256 * cipher, const Veeam::VBK::digest_t* keyset_id) {
     const off_t data_offset = file_offset + buf_pos;
 
     const lz_hdr* plz = (const lz_hdr*)(buf.data() + buf_pos);
@@ -796,109 +1294,71 @@ bool ScannerV2::check_data_lz4(const buf_t& buf, off_t file_offset, size_t buf_p
     int comp_size = 0;
     int lz4res = LZ4_decompress_safe_partial_ex(
         (const char*)(plz+1),
-        (char*)m_decomp_buf.data(),
+        (char*)ctx.decomp_buf.data(),
         input_size,
         plz->srcSize,
         plz->srcSize,
         &comp_size
         );
 
-    uint32_t crc = vcrc32(0, m_decomp_buf.data(), plz->srcSize);
+    uint32_t crc = vcrc32(0, ctx.decomp_buf.data(), plz->srcSize);
     // logger->trace("check_data: data_offset: {:x}, srcSize: {:x}, crc: {:08x}, plz->crc: {:08x}", data_offset, plz->srcSize, crc, plz->crc);
     if (crc == plz->crc && static_cast<uint32_t>(lz4res) == plz->srcSize) {
-        found("lz4 blocks");
-        add_good_block(data_offset, comp_size, plz->srcSize, m_md5.Calculate(m_decomp_buf.data(), plz->srcSize), plz->crc, "LZ4", keyset_id);
-        set_bitmap(data_offset, comp_size + sizeof(lz_hdr)); // mark the block as occupied
+        ctx.out->found.push_back("lz4 blocks");
+        add_good_block(ctx, data_offset, comp_size, plz->srcSize, ctx.md5.Calculate(ctx.decomp_buf.data(), plz->srcSize), plz->crc, CT_LZ4, keyset_id);
+        ctx.out->bitmap.emplace_back(data_offset, comp_size + sizeof(lz_hdr)); // mark the block as occupied
         return true;
     }
 
     // only saving when (lz4res != plz->srcSize) bc if they are equal, but CRC is not, it means that the block is corrupted,
     // but somehow is still valid LZ4, so we can't pinpoint the end of the "truely valid" data
     if (static_cast<uint32_t>(lz4res) != plz->srcSize) {
-        found("bad blocks");
+        ctx.out->found.push_back("bad blocks");
 
         if (comp_size == 0 && lz4res < 0)
             comp_size = -lz4res;
 
         std::string line = fmt::format("{:012x};{:06x};{:06x};{:06x}\n", data_offset, plz->srcSize, comp_size, (uint32_t)lz4res);
-        m_bad_blocks_csv << line;
-    }
-    return false;
-}
-
-// Basic zlib header validation
-// First byte: compression method (lower 4 bits) and compression info (upper 4 bits)
-// Second byte: flags including compression level, preset dictionary flag, etc.
-inline bool is_zlib_header(const uint8_t* data) {
-    const uint8_t first_byte = data[0];
-    const uint8_t second_byte = data[1];
-    return (first_byte & 0x0F) == 0x08 && // deflate compression method
-           ((first_byte * 256 + second_byte) % 31) == 0 && // header checksum
-           ((first_byte >> 4) & 0x0F) <= 7 && // window size <= 15 (32KB)
-           (second_byte & 0x20) == 0; // no preset dictionary (Veeam doesn't use this)
-}
-
-bool try_inflate(const uint8_t* data, size_t data_size, std::vector<uint8_t>& out_buf, size_t& comp_size, size_t& decomp_size) {
-    z_stream strm = {};
-    strm.avail_in = data_size;
-    strm.next_in = (Bytef*)data;
-    strm.avail_out = out_buf.size();
-    strm.next_out = (Bytef*)out_buf.data();
-
-    // Use the same window size as Veeam (from ExtractContext.cpp)
-    int ret = inflateInit2(&strm, 15);
-    if (ret != Z_OK) {
-        return false;
-    }
-
-    ret = inflate(&strm, Z_FINISH);
-    int inflate_ret = ret;
-    // check inflateEnd first to always have it called
-    if (inflateEnd(&strm) == Z_OK && inflate_ret == Z_STREAM_END && strm.total_out > 0 && strm.total_out <= BLOCK_SIZE) {
-        comp_size = data_size - strm.avail_in;
-        decomp_size = strm.total_out;
-        return true;
+        ctx.out->bad_csv += line;
     }
     return false;
 }
 
 // Check for zlib compressed data blocks
 // input: at least a PAGE_SIZE of data
-bool ScannerV2::check_data_zlib(const buf_t& buf, off_t file_offset, size_t buf_pos) {
+bool ScannerV2::check_data_zlib(DataCtx& ctx, std::span<const uint8_t> buf, off_t file_offset, size_t buf_pos) {
     const off_t data_offset = file_offset + buf_pos;
     
     if (!is_zlib_header(buf.data() + buf_pos)) {
         return false;
     }
+    // most candidates are random data, rejected after a few hundred bytes, without reading past the buffer
+    if (!ctx.zlib.probe(buf.data() + buf_pos, buf.size() - buf_pos)) {
+        return false;
+    }
 
     // Example of a valid block found in the wild:
     // <BlockDescriptor location=4, usageCnt=1, offset=ecb0df4000, allocSize=101000, dedup=1, digest=d4a8c2b2c4f5600939f2409e8eed185f, compType=4, compSize=100146, srcSize=100000>
     // zlib-compressed, compSize is greater than srcSize and BLOCK_SIZE
     const size_t max_comp_size = BLOCK_SIZE + 0x200;
-    size_t actual_comp_size = 0, decomp_size = 0;
+    const uint8_t* data = buf.data() + buf_pos;
+    buf_t tmp;
     if( max_comp_size + buf_pos >= buf.size() ){
-        buf_t tmp;
         tmp.resize(max_comp_size);
         m_reader.read_at(data_offset, tmp.data(), max_comp_size);
         if (!is_zlib_header(tmp.data())) {
             logger->warn_once("{:x}: Invalid zlib hdr on 2nd read, but was valid on 1st", data_offset);
             return false;
         }
-        if( try_inflate(tmp.data(), max_comp_size, m_decomp_buf, actual_comp_size, decomp_size) ){
-            found("zlib blocks");
-            add_good_block(data_offset, actual_comp_size, decomp_size, m_md5.Calculate(m_decomp_buf.data(), decomp_size), 0, "ZLIB");
-            set_bitmap(data_offset, actual_comp_size); // mark the compressed block as occupied
-            return true;
-        }
-        return false;
+        data = tmp.data();
     }
 
-    if( try_inflate(buf.data() + buf_pos, max_comp_size, m_decomp_buf, actual_comp_size, decomp_size) ){
-        found("zlib blocks");
-        add_good_block(data_offset, actual_comp_size, decomp_size, m_md5.Calculate(m_decomp_buf.data(), decomp_size), 0, "ZLIB");
-        set_bitmap(data_offset, actual_comp_size); // mark the compressed block as occupied
-        return true;
+    size_t actual_comp_size = 0, decomp_size = 0;
+    if (!ctx.zlib.inflate(data, max_comp_size, ctx.decomp_buf, BLOCK_SIZE, actual_comp_size, decomp_size)) {
+        return false;
     }
-    
-    return false;
+    ctx.out->found.push_back("zlib blocks");
+    add_good_block(ctx, data_offset, actual_comp_size, decomp_size, ctx.md5.Calculate(ctx.decomp_buf.data(), decomp_size), 0, CT_ZLIB_LO);
+    ctx.out->bitmap.emplace_back(data_offset, actual_comp_size); // mark the compressed block as occupied
+    return true;
 }
\ No newline at end of file
@@ -1,37 +1,102 @@
 #include "DblBufScanner.hpp"
+#include "PatternSearch.hpp"
+#include "PageFilter.hpp"
+#include "ZlibProbe.hpp"
 #include "Veeam/VBK.hpp"
 #include "processing/MD5.hpp"
 #include "data/BitFileMappedArray.hpp"
+#include "data/PageBitmap.hpp"
+#include "data/CarvedLog.hpp"
 #include "utils/crypto.hpp"
 
+#include <chrono>
 #include <map>
 #include <memory>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
 
 class ScannerV2 : public DblBufScanner {
     using BankInfo = Veeam::VBK::CSlot::BankInfo;
     using CBank = Veeam::VBK::CBank;
 
     public:
-    ScannerV2(const std::string& fname, off_t start, bool find_data_blocks, bool carve_mode = false, const std::string& keysets_dump = {})
-        : DblBufScanner(fname, start), m_find_blocks(find_data_blocks), m_carve_mode(carve_mode), m_keysets_dump(keysets_dump) {}
-    uint32_t calc_bank_crc(const buf_t& buf, off_t file_offset, size_t buf_pos);
-
-    void process_buf(const buf_t& buf, off_t file_offset) override;
-    void check_bank(const buf_t& buf, off_t file_offset, size_t pos);
-    void check_slot(const buf_t& buf, off_t file_offset, size_t pos);
-    bool check_data(const buf_t& buf, off_t file_offset, size_t pos);
-    bool check_data_lz4(const buf_t& buf, off_t file_offset, size_t pos, crypto::AES256 const* cipher = nullptr, const Veeam::VBK::digest_t* keyset_id = nullptr);
-    bool check_data_zlib(const buf_t& buf, off_t file_offset, size_t pos);
-    bool check_data_xml(const buf_t& buf, off_t file_offset, size_t pos, crypto::AES256 const* cipher = nullptr, const Veeam::VBK::digest_t* keyset_id = nullptr);
+    ScannerV2(const std::string& fname, off_t start, bool find_data_blocks, bool carve_mode = false, const std::string& keysets_dump = {}, int reader_flags = 0)
+        : DblBufScanner(fname, start, 8*1024*1024, reader_flags), m_checked_offsets(m_reader.size(), Veeam::VBK::PAGE_SIZE, start % Veeam::VBK::PAGE_SIZE),
+          m_find_blocks(find_data_blocks), m_carve_mode(carve_mode), m_keysets_dump(keysets_dump) {}
+    ~ScannerV2();
+
+    // number of threads probing for data blocks, 1 = everything on the scan thread
+    // output does not depend on it
+    void set_threads(unsigned n) { m_threads = std::max(n, 1u); }
+
+    // found data blocks always go to carved_blocks.bin, carved_blocks.csv is written as well unless disabled
+    void set_write_csv(bool write) { m_write_csv = write; }
+
+    // rescan only what carved_blocks.map of earlier scans doesn't cover, appending to their csv files
+    // big covered runs are not read at all, pages of smaller ones are not probed
+    void set_skip_covered(bool skip) { m_skip_covered = skip; }
+
+    // the scan state is saved to scan.checkpoint in the output dir every `seconds` (0 = never),
+    // the file is removed when the scan completes
+    void set_checkpoint_interval(unsigned seconds) { m_checkpoint_interval = seconds; }
+    // restore the state of an interrupted scan from its checkpoint, the scanner must be created
+    // with start = ScanCheckpoint::Header::offset and set_end() called with its end
+    void set_resume(bool resume) { m_resume = resume; }
+
+    // outcome of the data block probes at one page, applied to outputs in file order
+    struct DataResult {
+        bool ok = false;
+        std::string good_csv, bad_csv;
+        std::vector<HashEntry> good_log;
+        std::vector<std::pair<off_t, size_t>> bitmap;
+        std::vector<const char*> found;
+
+        void clear() { ok = false; good_csv.clear(); bad_csv.clear(); good_log.clear(); bitmap.clear(); found.clear(); }
+    };
+
+    // per-thread state of the data block probes
+    struct DataCtx {
+        buf_t decomp_buf;
+        MD5 md5;
+        ZlibProbe zlib;
+        std::vector<crypto::AES256Multi::block_t> trial_plain; // first block of the page under each keyset
+        DataResult* out = nullptr;
+    };
+
+    uint32_t calc_bank_crc(std::span<const uint8_t> buf, off_t file_offset, size_t buf_pos);
+
+    void process_buf(std::span<const uint8_t> buf, off_t file_offset) override;
+    void process_hole(off_t file_offset, size_t size) override;
+    void check_bank(std::span<const uint8_t> buf, off_t file_offset, size_t pos);
+    void check_slot(std::span<const uint8_t> buf, off_t file_offset, size_t pos);
+    // plaintext signatures found at a page, only those probes are run by check_data()
+    enum : uint8_t { SIG_LZ4 = 1, SIG_ZLIB = 2, SIG_XML = 4, SIG_ALL = 0xFF };
+    bool check_data(DataCtx& ctx, std::span<const uint8_t> buf, off_t file_offset, size_t pos, uint8_t sigs = SIG_ALL);
+    bool check_data_lz4(DataCtx& ctx, std::span<const uint8_t> buf, off_t file_offset, size_t pos, crypto::AES256 const* cipher = nullptr, const Veeam::VBK::digest_t* keyset_id = nullptr);
+    bool check_data_zlib(DataCtx& ctx, std::span<const uint8_t> buf, off_t file_offset, size_t pos);
+    bool check_data_xml(DataCtx& ctx, std::span<const uint8_t> buf, off_t file_offset, size_t pos, crypto::AES256 const* cipher = nullptr, const Veeam::VBK::digest_t* keyset_id = nullptr);
     bool check_encrypted_headers(const uint8_t* dec_head, size_t dec_size);
 
     private:
     bool load_keysets_dump(const std::filesystem::path& path);
     const crypto::AES256* get_aes_cipher(const digest_t& id) const;
-    void add_good_block(off_t offset, int comp_size, int raw_size, digest_t digest, uint32_t crc, const std::string& comp_type = "", const Veeam::VBK::digest_t* keyset_id = nullptr);
+    void add_good_block(DataCtx& ctx, off_t offset, int comp_size, int raw_size, digest_t digest, uint32_t crc, ECompType comp_type, const Veeam::VBK::digest_t* keyset_id = nullptr);
+    void check_page_data(DataCtx& ctx, std::span<const uint8_t> buf, off_t file_offset, size_t pos);
+    void apply_data_result(const DataResult& r);
+    void scan_data_parallel(std::span<const uint8_t> buf, off_t file_offset, size_t npages);
+    void worker_proc(size_t idx);
+    void scan_data_pages(DataCtx& ctx);
+    void stop_workers();
     void set_bitmap(off_t offset, size_t size);
-    std::string process_bank(const CBank*, uint32_t bank_crc, off_t bank_offset);
-    void save_bank(const BankInfo& bi);
+    void find_covered_runs();
+    void load_earlier_metadata();
+    off_t find_skip(off_t pos, off_t& data_end) override;
+    void buf_done(off_t next_offset) override;
+    void save_checkpoint(off_t offset);
+    void load_checkpoint();
+    std::string process_bank(const CBank*, size_t avail, uint32_t bank_crc, off_t bank_offset);
+    void save_bank(const BankInfo& bi, std::span<const uint8_t> data);
     void increment_bank_usagecnt(const BankInfo& bi);
     void start() override;
     void finish() override;
@@ -50,7 +115,7 @@ class ScannerV2 : public DblBufScanner {
 
     std::unordered_map<uint64_t /*slot_offset*/, SlotInfo> m_slots_map;
     std::vector<SlotBankInfo> m_sbis;
-    std::unordered_set<uint64_t> m_checked_offsets;
+    PageBitmap m_checked_offsets; // slots and banks already processed, the scan loop skips them
     std::unordered_map<uint64_t, int> m_bank_usagecnt;
     std::unordered_set<uint64_t> m_seen_bank_ids;
     std::unordered_map<uint64_t, uint64_t> m_seen_slot_fingerprints;
@@ -65,14 +130,55 @@ class ScannerV2 : public DblBufScanner {
     std::unordered_set<uint32_t> m_seen_bank_crcs;
     std::map<uint32_t, BankInfo> m_bank_id_to_bank;  // lightweight BankInfo instead of 4MB CBank
     std::unordered_map<uint32_t, uint32_t> m_bank_crc_to_bank_id;
-    buf_t m_decomp_buf;
-    MD5 m_md5;
     std::ofstream m_good_blocks_csv, m_bad_blocks_csv;
+    std::unique_ptr<CarvedLog> m_good_blocks_log;
+    bool m_write_csv = true;
+
+    // data block workers
+    // [0] belongs to the scan thread, [1..] to m_workers
+    unsigned m_threads = 1;
+    std::vector<std::unique_ptr<DataCtx>> m_data_ctx;
+    std::vector<std::thread> m_workers;
+    std::vector<DataResult> m_page_results; // one per page of the current buffer
+
+    // page-aligned data block signatures, PatternSearch ids are the bit numbers of SIG_*
+    PatternSearch m_data_sigs;
+    std::vector<PatternSearch::Match> m_sig_matches;
+    std::vector<uint8_t> m_page_sigs; // SIG_* per page of the current buffer
+    std::vector<uint8_t> m_page_class; // PageFilter flags per page of the current buffer
+    std::mutex m_work_mutex;
+    std::condition_variable m_work_cv, m_work_done_cv;
+    uint64_t m_work_gen = 0;
+    size_t m_work_busy = 0;
+    bool m_work_stop = false;
+    std::exception_ptr m_work_error;
+    std::span<const uint8_t> m_work_buf;
+    off_t m_work_offset = 0;
+    std::atomic<size_t> m_work_next_page = 0;
 
     std::string m_keysets_dump;
     std::map<Veeam::VBK::digest_t, crypto::aes_key> m_aes_keys;
     std::map<Veeam::VBK::digest_t, std::unique_ptr<crypto::AES256>> m_aes_ciphers;
+    crypto::AES256Multi m_key_trial; // all ciphers of m_aes_ciphers
+    std::vector<std::pair<const Veeam::VBK::digest_t*, const crypto::AES256*>> m_trial_keys; // same order
+
+    // summary.xml candidates are read in chunks growing from XML_CHUNK_SIZE to XML_MAX_CHUNK_SIZE, up to MAX_XML_SIZE
+    static constexpr size_t XML_CHUNK_SIZE = 0x10000;
+    static constexpr size_t XML_MAX_CHUNK_SIZE = 0x100000;
+    static constexpr size_t MAX_XML_SIZE = 0x4000000;
 
     // bitmap
     std::unique_ptr<BitFileMappedArray> m_bitmap;
+
+    // --skip-covered
+    static constexpr size_t MIN_SKIP_SIZE = 0x100000; // smaller runs are read, splitting reads costs more
+    bool m_skip_covered = false;
+    std::vector<std::pair<off_t, off_t>> m_covered_runs; // [start, end) offsets, sorted
+    std::vector<uint8_t> m_page_covered;                 // per page of the current buffer
+
+    // checkpoints
+    unsigned m_checkpoint_interval = 0; // seconds
+    bool m_resume = false;
+    off_t m_scan_start = 0; // start of the first run of a resumed scan
+    std::chrono::steady_clock::time_point m_last_checkpoint;
 };
@@ -0,0 +1,41 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+
+#include <zlib.h>
+
+// reusable zlib validation context of one scan thread
+// the inflate state is allocated once and reset between candidates (inflateReset) instead of
+// inflateInit2()/inflateEnd() per candidate; probe() decodes only the start of a candidate into a
+// small scratch window and gives up at the first error, which rejects nearly all random data that
+// passes the 2-byte header check, inflate() decodes survivors completely
+class ZlibProbe {
+    public:
+    static constexpr size_t PROBE_IN_SIZE = 0x1000;   // compressed bytes looked at by probe()
+    static constexpr size_t PROBE_OUT_SIZE = 0x8000;  // scratch window, probe() stops when it's full
+
+    ZlibProbe();
+    ~ZlibProbe();
+
+    ZlibProbe(const ZlibProbe&) = delete;
+    ZlibProbe& operator=(const ZlibProbe&) = delete;
+
+    // false if data can't be the start of a zlib stream inflate() would accept, never false for one it accepts
+    bool probe(const uint8_t* data, size_t size);
+
+    // inflates a complete zlib stream at data into out, true if it ends within size bytes
+    // and decompresses to 1..max_decomp bytes; comp_size and decomp_size are set then
+    bool inflate(const uint8_t* data, size_t size, std::span<uint8_t> out, size_t max_decomp, size_t& comp_size, size_t& decomp_size);
+
+    // candidates seen by probe() and rejected by it, for statistics
+    size_t probes() const { return m_probes; }
+    size_t rejected() const { return m_rejected; }
+
+    private:
+    z_stream m_strm = {};
+    std::unique_ptr<uint8_t[]> m_scratch;
+    size_t m_probes = 0;
+    size_t m_rejected = 0;
+};
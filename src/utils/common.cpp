@@ -174,6 +174,11 @@ fs::path get_out_dir(fs::path in_fname, const argparse::ArgumentParser& program)
         in_fname = in_fname.native().substr(5);
     }
 
+    if( in_fname.native().substr(0, 1) == "@"_n){
+        // concatenated source '@disk.parts' -> 'disk.parts'
+        in_fname = in_fname.native().substr(1);
+    }
+
     fs::path dir;
     if( program.present("--out-dir") ){
         dir = program.get<std::string>("--out-dir");
@@ -219,47 +219,35 @@ AES_TARGET AES256::AES256(const uint8_t key[32], const uint8_t iv[16]) {
         _mm_storeu_si128(reinterpret_cast<__m128i*>(dec_keys_[i]), dec[i]);
 }
 
-AES_TARGET void AES256::decrypt(std::vector<uint8_t>& data, bool remove_padding, size_t size) const {
+void AES256::decrypt(std::vector<uint8_t>& data, bool remove_padding, size_t size) const {
     const size_t n = (size == 0) ? data.size() : size;
     if (n == 0)
         return;
     if (n > data.size())
         throw std::runtime_error("decrypt size out of range");
-    if ((n & 15) != 0)
-        throw std::runtime_error("aes input size must be a multiple of 16");
-
-    const __m128i* dk = reinterpret_cast<const __m128i*>(dec_keys_);
-    __m128i prev = _mm_loadu_si128(reinterpret_cast<const __m128i*>(iv0_));
-    uint8_t* p = data.data();
-
-    for (size_t off = 0; off < n; off += 16) {
-        if (off + 64 < n) // pre-fetch next blocks for a performance boost.
-            _mm_prefetch(reinterpret_cast<const char*>(p + off + 64), _MM_HINT_T0);
-
-        const __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + off));
-        __m128i x = aes256_dec_block(c, dk);
-        x = _mm_xor_si128(x, prev);
-        _mm_storeu_si128(reinterpret_cast<__m128i*>(p + off), x);
-        prev = c;
-    }
 
-    if (remove_padding) {
-        const size_t pad = pkcs7_unpad_len(data.data(), n);
-        data.resize(n - pad);
-    }
+    const size_t plain_size = decrypt(data.data(), n, remove_padding);
+    if (remove_padding)
+        data.resize(plain_size);
 }
 // overload for raw buffer
-AES_TARGET void AES256::decrypt(uint8_t* data, size_t len, bool remove_padding) const {
+size_t AES256::decrypt(uint8_t* data, size_t len, bool remove_padding) const {
     if (len == 0)
-        return;
+        return 0;
+
+    alignas(16) uint8_t iv[16];
+    std::memcpy(iv, iv0_, sizeof(iv));
+    decrypt_chunk(data, len, iv);
+
+    return remove_padding ? len - pkcs7_unpad_len(data, len) : len;
+}
+
+AES_TARGET void AES256::decrypt_chunk(uint8_t* data, size_t len, uint8_t iv[16]) const {
     if ((len & 15) != 0)
         throw std::runtime_error("aes input size must be a multiple of 16");
 
-    if (remove_padding)
-        throw std::runtime_error("remove_padding not supported for raw buffer decrypt");
-
     const __m128i* dk = reinterpret_cast<const __m128i*>(dec_keys_);
-    __m128i prev = _mm_loadu_si128(reinterpret_cast<const __m128i*>(iv0_));
+    __m128i prev = _mm_loadu_si128(reinterpret_cast<const __m128i*>(iv));
 
     for (size_t off = 0; off < len; off += 16) {
         if (off + 64 < len)
@@ -271,8 +259,55 @@ AES_TARGET void AES256::decrypt(uint8_t* data, size_t len, bool remove_padding)
         _mm_storeu_si128(reinterpret_cast<__m128i*>(data + off), x);
         prev = c;
     }
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(iv), prev);
+}
+
+void AES256Multi::add(const AES256& cipher) {
+    Key& k = keys_.emplace_back();
+    std::memcpy(k.iv, cipher.iv0_, sizeof(k.iv));
+    std::memcpy(k.dec_keys, cipher.dec_keys_, sizeof(k.dec_keys));
 }
 
+// N keys per round: aesdec has a latency of several cycles but a throughput of 1-2 per cycle
+template <size_t N>
+AES_TARGET static inline void dec_first_block_aesni(__m128i c, const AES256Multi::Key* keys, AES256Multi::block_t* out) {
+    __m128i s[N];
+#pragma GCC unroll 8
+    for (size_t j = 0; j < N; j++)
+        s[j] = _mm_xor_si128(c, _mm_load_si128(reinterpret_cast<const __m128i*>(keys[j].dec_keys[0])));
+#pragma GCC unroll 13
+    for (size_t r = 1; r < 14; r++)
+#pragma GCC unroll 8
+        for (size_t j = 0; j < N; j++)
+            s[j] = _mm_aesdec_si128(s[j], _mm_load_si128(reinterpret_cast<const __m128i*>(keys[j].dec_keys[r])));
+#pragma GCC unroll 8
+    for (size_t j = 0; j < N; j++) {
+        s[j] = _mm_aesdeclast_si128(s[j], _mm_load_si128(reinterpret_cast<const __m128i*>(keys[j].dec_keys[14])));
+        s[j] = _mm_xor_si128(s[j], _mm_load_si128(reinterpret_cast<const __m128i*>(keys[j].iv)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out[j].data()), s[j]);
+    }
+}
+
+AES_TARGET void AES256Multi::decrypt_first_block(const uint8_t* in, block_t* out) const {
+    const __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+    // 8 keys at a time, the tail in groups of 4, 2 and 1
+    for (size_t i = 0; i < keys_.size(); ) {
+        const size_t left = keys_.size() - i;
+        if (left >= 8) {
+            dec_first_block_aesni<8>(c, &keys_[i], out + i);
+            i += 8;
+        } else if (left >= 4) {
+            dec_first_block_aesni<4>(c, &keys_[i], out + i);
+            i += 4;
+        } else if (left >= 2) {
+            dec_first_block_aesni<2>(c, &keys_[i], out + i);
+            i += 2;
+        } else {
+            dec_first_block_aesni<1>(c, &keys_[i], out + i);
+            i += 1;
+        }
+    }
+}
 
 // just for convenience
 void register_keyset(std::map<Veeam::VBK::digest_t, aes_key>& keys,
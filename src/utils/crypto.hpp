@@ -4,6 +4,7 @@
 #include <openssl/evp.h>
 #include <openssl/hmac.h>
 #include <openssl/sha.h>
+#include <array>
 #include <cstdint>
 #include <cstddef>
 #include <map>
@@ -37,13 +38,45 @@ class AES256 {
 public:
     AES256(const uint8_t key[32], const uint8_t iv[16]);
     void decrypt(std::vector<uint8_t>& data, bool remove_padding = true, size_t size = 0) const;
-    void decrypt(uint8_t* data, size_t len, bool remove_padding = false) const;
+    // in place, returns the plaintext size (len minus padding, if removed)
+    size_t decrypt(uint8_t* data, size_t len, bool remove_padding = false) const;
+    // in place, one chunk of a longer CBC stream: iv is the IV for the first chunk (see iv()), else
+    // the last ciphertext block of the previous chunk, and is updated to this chunk's last one
+    void decrypt_chunk(uint8_t* data, size_t len, uint8_t iv[16]) const;
+    const uint8_t* iv() const { return iv0_; }
 
 private:
+    friend class AES256Multi;
+
     alignas(16) uint8_t iv0_[16];
     alignas(16) unsigned char dec_keys_[15][16];
 };
 
+// trial decryption of one ciphertext block under many keys, for finding which keyset encrypted a block
+// keys are processed 8 at a time with their rounds interleaved, so the AES-NI pipeline stays full
+// instead of waiting out the latency of each aesdec of a single key
+class AES256Multi {
+public:
+    using block_t = std::array<uint8_t, 16>;
+
+    void clear() { keys_.clear(); }
+    // the cipher's round keys and IV are copied, index = number of keys added before
+    void add(const AES256& cipher);
+    size_t size() const { return keys_.size(); }
+
+    // first CBC block: out[i] = plaintext of in[0..16) under key i, out must have size() elements
+    void decrypt_first_block(const uint8_t* in, block_t* out) const;
+
+    // one key's decryption round keys and IV, laid out for aligned loads
+    struct Key {
+        alignas(16) uint8_t iv[16];
+        alignas(16) unsigned char dec_keys[15][16];
+    };
+
+private:
+    std::vector<Key> keys_;
+};
+
 void register_keyset(std::map<Veeam::VBK::digest_t, aes_key>& keys,
                      std::map<Veeam::VBK::digest_t, std::unique_ptr<AES256>>& ciphers,
                      const Veeam::VBK::digest_t& id,
@@ -0,0 +1,63 @@
+#include <gtest/gtest.h>
+#include "io/BadRegionMap.cpp"
+
+TEST(BadRegionMap, merges_regions) {
+    BadRegionMap map;
+    map.add(0x1000, 0x200);
+    map.add(0x1200, 0x200); // adjacent
+    map.add(0x1100, 0x80);  // inside
+    map.add(0x3000, 0x200);
+    EXPECT_EQ(2, map.count());
+    EXPECT_EQ(0x600, map.total_bytes());
+
+    map.add(0x1300, 0x1e00); // bridges both
+    EXPECT_EQ(1, map.count());
+    EXPECT_EQ(0x2200, map.total_bytes());
+}
+
+TEST(BadRegionMap, find) {
+    BadRegionMap map;
+    map.add(0x1000, 0x200);
+    map.add(0x4000, 0x1000);
+
+    EXPECT_FALSE(map.overlaps(0, 0x1000));
+    EXPECT_FALSE(map.overlaps(0x1200, 0x2e00));
+    EXPECT_TRUE(map.overlaps(0xfff, 2));
+    EXPECT_TRUE(map.overlaps(0x11ff, 1));
+    EXPECT_TRUE(map.overlaps(0, 0x10000));
+
+    auto r = map.find(0x3000, 0x2000);
+    EXPECT_EQ(0x4000, r.first);
+    EXPECT_EQ(0x5000, r.second);
+
+    r = map.find(0x4800, 0x10);
+    EXPECT_EQ(0x4000, r.first);
+    EXPECT_EQ(0x5000, r.second);
+}
+
+TEST(BadRegionMap, persists) {
+    const std::filesystem::path fname = "bad_regions_test.csv";
+    std::filesystem::remove(fname);
+    EXPECT_EQ(nullptr, BadRegionMap::load_if_exists(fname));
+
+    {
+        BadRegionMap map(fname);
+        EXPECT_EQ(0, map.count());
+        EXPECT_FALSE(std::filesystem::exists(fname)); // created on first add
+        map.add(0x1000, 0x200);
+        map.add(0x123456789000, 0x1000);
+    }
+
+    auto map = BadRegionMap::load_if_exists(fname);
+    ASSERT_NE(nullptr, map);
+    EXPECT_EQ(2, map->count());
+    EXPECT_TRUE(map->overlaps(0x123456789800, 1));
+
+    // new regions are appended, and merged on load
+    map->add(0x1200, 0x200);
+    map.reset();
+    BadRegionMap reloaded(fname);
+    EXPECT_EQ(2, reloaded.count());
+    EXPECT_EQ(0x1400, reloaded.total_bytes());
+    std::filesystem::remove(fname);
+}
@@ -0,0 +1,50 @@
+#include <gtest/gtest.h>
+#include "data/BitFileMappedArray.hpp"
+
+static void check_range(size_t start, size_t end) {
+    std::filesystem::remove("test_bitmap.map");
+    BitFileMappedArray bitmap("test_bitmap.map", 40);
+    bitmap.set_range(start, end);
+    for (size_t i = 0; i < bitmap.size_bits(); i++) {
+        EXPECT_EQ(i >= start && i < end, bitmap.get(i)) << "range " << start << ".." << end << ", bit " << i;
+    }
+}
+
+TEST(BitFileMappedArray, set_range) {
+    for (size_t start = 0; start < 40; start++) {
+        for (size_t end = start + 1; end <= 40; end++) {
+            check_range(start, end);
+        }
+    }
+}
+
+TEST(BitFileMappedArray, set_range_bounds) {
+    std::filesystem::remove("test_bitmap.map");
+    BitFileMappedArray bitmap("test_bitmap.map", 16);
+    EXPECT_THROW(bitmap.set_range(0, 17), std::out_of_range);
+    EXPECT_THROW(bitmap.set_range(4, 4), std::out_of_range);
+    bitmap.set_range(8, 16);
+    EXPECT_EQ(0x00, bitmap.data()[0]);
+    EXPECT_EQ(0xff, bitmap.data()[1]);
+}
+
+TEST(BitFileMappedArray, find_first) {
+    std::filesystem::remove("test_bitmap.map");
+    BitFileMappedArray bitmap("test_bitmap.map", 1000);
+    EXPECT_EQ(1000, bitmap.find_first(true, 0));
+    EXPECT_EQ(0, bitmap.find_first(false, 0));
+    EXPECT_EQ(1000, bitmap.find_first(false, 1000));
+
+    const std::pair<size_t, size_t> runs[] = {{3, 5}, {7, 300}, {301, 302}, {640, 997}};
+    for (const auto& [start, end] : runs) {
+        bitmap.set_range(start, end);
+    }
+    for (size_t from = 0; from <= 1000; from++) {
+        size_t expected_set = 1000, expected_unset = 1000;
+        for (size_t i = 999; i + 1 > from; i--) {
+            (bitmap.get(i) ? expected_set : expected_unset) = i;
+        }
+        EXPECT_EQ(expected_set, bitmap.find_first(true, from)) << from;
+        EXPECT_EQ(expected_unset, bitmap.find_first(false, from)) << from;
+    }
+}
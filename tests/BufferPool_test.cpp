@@ -0,0 +1,93 @@
+#include <gtest/gtest.h>
+#include "core/BufferPool.cpp"
+
+TEST(BufferPool, aligned) {
+    pooled_buf_t buf(0x1234, 0x1000);
+    EXPECT_EQ(0x1234, buf.size());
+    EXPECT_EQ(0x2000, buf.capacity());
+    EXPECT_EQ(0, (uintptr_t)buf.data() % 0x1000);
+}
+
+TEST(BufferPool, reuses_blocks) {
+    BufferPool::instance().trim();
+    uint8_t* ptr;
+    {
+        pooled_buf_t buf(0x10000);
+        ptr = buf.data();
+    }
+    EXPECT_EQ(0x10000, BufferPool::instance().cached_bytes());
+
+    pooled_buf_t buf2(0x10000);
+    EXPECT_EQ(ptr, buf2.data());
+    EXPECT_EQ(0, BufferPool::instance().cached_bytes());
+}
+
+TEST(BufferPool, resize_keeps_contents) {
+    pooled_buf_t buf(0x10, 0x10);
+    memcpy(buf.data(), "0123456789abcdef", 0x10);
+
+    buf.resize(4);
+    EXPECT_EQ(4, buf.size());
+    EXPECT_EQ(0x10, buf.capacity());
+
+    buf.resize(0x10);
+    EXPECT_EQ(0, memcmp(buf.data(), "0123456789abcdef", 0x10));
+
+    buf.resize(0x1000);
+    EXPECT_EQ(0x1000, buf.size());
+    EXPECT_EQ(0, memcmp(buf.data(), "0123456789abcdef", 0x10));
+    EXPECT_EQ(0, (uintptr_t)buf.data() % 0x10);
+}
+
+TEST(BufferPool, move) {
+    pooled_buf_t a(0x100);
+    uint8_t* ptr = a.data();
+    pooled_buf_t b = std::move(a);
+    EXPECT_EQ(ptr, b.data());
+    EXPECT_EQ(0x100, b.size());
+    EXPECT_EQ(nullptr, a.data());
+    EXPECT_EQ(0, a.size());
+}
+
+TEST(BufferPool, size_classes) {
+    EXPECT_EQ(0x1000, BufferPool::size_class(0x10, 0x1000));
+    EXPECT_EQ(0x10000, BufferPool::size_class(0x10000, 0x1000));
+    EXPECT_EQ(0x14000, BufferPool::size_class(0x10001, 0x1000));
+    EXPECT_EQ(0x100000, BufferPool::size_class(0xf0000, 0x1000));
+    EXPECT_EQ(0x140000, BufferPool::size_class(0x100010, 0x1000));
+    EXPECT_EQ(0x140000, BufferPool::size_class(0x101000, 0x1000));
+}
+
+TEST(BufferPool, reuses_size_class) {
+    BufferPool::instance().trim();
+    uint8_t* ptr;
+    {
+        pooled_buf_t buf(0x100010);
+        ptr = buf.data();
+    }
+    // a slightly different size maps to the same class
+    pooled_buf_t buf2(0x101000);
+    EXPECT_EQ(ptr, buf2.data());
+    EXPECT_EQ(0x101000, buf2.size());
+    EXPECT_EQ(0x140000, buf2.capacity());
+}
+
+TEST(BufferPool, huge_pages) {
+    BufferPool::instance().trim();
+    uint8_t* ptr;
+    {
+        pooled_buf_t buf(0x300000, 0x1000, true);
+        EXPECT_EQ(0x300000, buf.size());
+        EXPECT_EQ(0x400000, buf.capacity());
+        if (buf.page_mode() != PageMode::NORMAL) {
+            EXPECT_EQ(0, (uintptr_t)buf.data() % BufferPool::HUGE_PAGE_SIZE);
+        }
+        memset(buf.data(), 0x5a, buf.size());
+        ptr = buf.data();
+    }
+    // huge blocks are cached separately from normal ones
+    pooled_buf_t normal(0x400000);
+    EXPECT_NE(ptr, normal.data());
+    pooled_buf_t huge(0x400000, 0x1000, true);
+    EXPECT_EQ(ptr, huge.data());
+}
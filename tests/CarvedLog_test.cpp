@@ -0,0 +1,107 @@
+#include <gtest/gtest.h>
+#include "data/CarvedLog.cpp"
+#include "data/HashTable.hpp"
+
+#include <sstream>
+
+static const std::filesystem::path log_fname = "test_carved_blocks.bin";
+static const std::filesystem::path csv_fname = "test_carved_blocks.csv";
+
+static HashEntry make_entry(uint64_t offset, ECompType comp_type, uint32_t comp_size, uint32_t orig_size, uint32_t crc, digest_t keyset_id = digest_t(0)) {
+    HashEntry e{};
+    e.offset = offset;
+    e.hash = digest_t(offset * 0x9e3779b97f4a7c15ULL, ~offset);
+    e.keyset_id = keyset_id;
+    e.comp_size = comp_size;
+    e.orig_size = orig_size;
+    e.comp_type = comp_type;
+    e.crc = crc;
+    return e;
+}
+
+static const std::vector<HashEntry> entries = {
+    make_entry(0x2000, CT_LZ4, 0x1234, 0x100000, 0xdeadbeef),
+    make_entry(0x3000, CT_ZLIB_LO, 0x800, 0x10000, 0),
+    make_entry(0x123456789000, CT_NONE, 0x5d, 0x5d, 0x11223344),
+    make_entry(0x4000, CT_LZ4, 0x10, 0x20, 1, digest_t(0x1234)),
+};
+
+class CarvedLogTest : public ::testing::Test {
+    protected:
+    void TearDown() override {
+        std::filesystem::remove(log_fname);
+        std::filesystem::remove(csv_fname);
+    }
+};
+
+TEST_F(CarvedLogTest, csv_rows) {
+    EXPECT_EQ("000000002000;001234;100000;" + fmt::format("{}", entries[0].hash) + ";deadbeef;LZ4", CarvedLog::csv_row(entries[0]));
+    EXPECT_EQ("000000003000;000800;010000;" + fmt::format("{}", entries[1].hash) + ";00000000;ZLIB", CarvedLog::csv_row(entries[1]));
+    EXPECT_EQ("123456789000;00005d;00005d;" + fmt::format("{}", entries[2].hash) + ";11223344;NONE", CarvedLog::csv_row(entries[2]));
+    EXPECT_EQ("000000004000;000010;000020;" + fmt::format("{}", entries[3].hash) + ";00000001;LZ4;34120000000000000000000000000000", CarvedLog::csv_row(entries[3]));
+}
+
+TEST_F(CarvedLogTest, append_and_export) {
+    {
+        CarvedLog log(log_fname, false);
+        log.append(std::span(entries).first(2));
+    }
+    {
+        CarvedLog log(log_fname, true); // continues the log, no second header
+        log.append(std::span(entries).subspan(2));
+    }
+    EXPECT_EQ(sizeof(CarvedLogHeader) + entries.size() * sizeof(HashEntry), std::filesystem::file_size(log_fname));
+
+    std::ostringstream csv;
+    EXPECT_EQ(entries.size(), CarvedLog::export_csv(log_fname, csv));
+    std::string expected;
+    for (const auto& e : entries) {
+        expected += CarvedLog::csv_row(e) + "\n";
+    }
+    EXPECT_EQ(expected, csv.str());
+
+    {
+        CarvedLog log(log_fname, false); // truncates
+    }
+    EXPECT_EQ(sizeof(CarvedLogHeader), std::filesystem::file_size(log_fname));
+}
+
+TEST_F(CarvedLogTest, rejects_other_files) {
+    {
+        std::ofstream f(log_fname);
+        f << "000000002000;001234;100000;00;deadbeef;LZ4\n";
+    }
+    EXPECT_FALSE(CarvedLog::is_log(log_fname));
+    EXPECT_THROW(CarvedLog(log_fname, true), std::runtime_error);
+    std::ostringstream csv;
+    EXPECT_THROW(CarvedLog::export_csv(log_fname, csv), std::runtime_error);
+}
+
+// the hash table gets the same entries from the log as from its csv export
+TEST_F(CarvedLogTest, hashtable_loads_log) {
+    {
+        CarvedLog log(log_fname, false);
+        log.append(entries);
+    }
+    {
+        std::ofstream csv(csv_fname, std::ios::binary);
+        CarvedLog::export_csv(log_fname, csv);
+    }
+
+    HashTable from_log, from_csv;
+    ASSERT_TRUE(from_log.loadFromFile(log_fname.string(), 1));
+    ASSERT_TRUE(from_csv.loadFromFile(csv_fname.string(), 1));
+    ASSERT_TRUE(from_log.sortEntries());
+    ASSERT_TRUE(from_csv.sortEntries());
+    ASSERT_EQ(entries.size(), from_log.size());
+    ASSERT_EQ(entries.size(), from_csv.size());
+
+    for (const auto& e : entries) {
+        const HashEntry* a = from_log.findHash(e.hash);
+        const HashEntry* b = from_csv.findHash(e.hash);
+        ASSERT_NE(nullptr, a);
+        ASSERT_NE(nullptr, b);
+        EXPECT_EQ(1, a->device_index);
+        EXPECT_EQ(0, memcmp(a, b, sizeof(HashEntry))) << a->to_string() << " " << b->to_string();
+    }
+}
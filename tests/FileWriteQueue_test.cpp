@@ -0,0 +1,65 @@
+#include <gtest/gtest.h>
+#include "io/FileWriteQueue.cpp"
+
+#include <fstream>
+#include <numeric>
+
+static const std::filesystem::path test_dir = "test_write_queue";
+
+static std::string read_file(const std::filesystem::path& fname) {
+    std::ifstream f(fname, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(f), {});
+}
+
+static std::span<const uint8_t> as_bytes(const std::string& s) {
+    return {reinterpret_cast<const uint8_t*>(s.data()), s.size()};
+}
+
+class FileWriteQueueTest : public ::testing::Test {
+    protected:
+    void SetUp() override {
+        std::filesystem::remove_all(test_dir);
+        std::filesystem::create_directory(test_dir);
+    }
+
+    void TearDown() override {
+        std::filesystem::remove_all(test_dir);
+    }
+};
+
+// a file written into after it was created sees both writes, in order
+TEST_F(FileWriteQueueTest, keeps_order) {
+    FileWriteQueue q;
+    std::string data = "0123456789";
+    q.write(test_dir / "a", as_bytes(data));
+    data = "xx"; // the queue has its own copy
+    q.write(test_dir / "a", as_bytes(data), false, 4);
+    q.write(test_dir / "b", as_bytes("b"));
+    q.write(test_dir / "a", as_bytes("y"), false, 12);
+    q.flush();
+
+    EXPECT_EQ(std::string("0123xx6789\0\0y", 13), read_file(test_dir / "a"));
+    EXPECT_EQ("b", read_file(test_dir / "b"));
+}
+
+// writes larger than the limit don't deadlock, everything is written by the destructor
+TEST_F(FileWriteQueueTest, limits_pending) {
+    std::vector<uint8_t> data(0x10000);
+    std::iota(data.begin(), data.end(), 0);
+    {
+        FileWriteQueue q(0x8000);
+        for (int i = 0; i < 20; i++) {
+            q.write(test_dir / std::to_string(i), data);
+        }
+    }
+    for (int i = 0; i < 20; i++) {
+        EXPECT_EQ(data.size(), std::filesystem::file_size(test_dir / std::to_string(i)));
+    }
+}
+
+TEST_F(FileWriteQueueTest, reports_errors) {
+    FileWriteQueue q;
+    q.write(test_dir / "missing" / "a", as_bytes("a"));
+    EXPECT_THROW(q.flush(), std::runtime_error);
+    q.flush(); // reported once
+}
@@ -0,0 +1,59 @@
+#include <gtest/gtest.h>
+#include "data/PageBitmap.hpp"
+
+#include <random>
+#include <set>
+
+TEST(PageBitmap, insert_contains) {
+    PageBitmap bm(0x100000000ULL, 0x1000);
+    std::set<uint64_t> ref;
+    std::mt19937_64 rng(1);
+    for (int i = 0; i < 10000; i++) {
+        const uint64_t offset = (rng() % 0x100000) * 0x1000;
+        bm.insert(offset);
+        ref.insert(offset);
+    }
+    for (uint64_t page = 0; page < 0x100000; page++) {
+        ASSERT_EQ(ref.count(page * 0x1000) == 1, bm.contains(page * 0x1000)) << page;
+    }
+    EXPECT_LE(bm.memory_usage(), 0x100000 / 8 + 0x100000 / PageBitmap::CHUNK_BITS * sizeof(void*));
+}
+
+TEST(PageBitmap, memory_follows_usage) {
+    PageBitmap bm(50ULL << 40, 0x1000); // 50 TB
+    EXPECT_LT(bm.memory_usage(), 4 * 1024 * 1024);
+    bm.insert(0);
+    bm.insert(0x1000);
+    bm.insert((50ULL << 40) - 0x1000);
+    EXPECT_LT(bm.memory_usage(), 4 * 1024 * 1024 + 2 * PageBitmap::CHUNK_WORDS * 8);
+    EXPECT_TRUE(bm.contains((50ULL << 40) - 0x1000));
+    EXPECT_FALSE(bm.contains((50ULL << 40) - 0x2000));
+}
+
+TEST(PageBitmap, off_grid) {
+    PageBitmap bm(0x100000, 0x1000, 0x200); // scan started at 0x200
+    bm.insert(0x1200);
+    bm.insert(0x1000);   // off the grid
+    bm.insert(0x100);    // below base
+    bm.insert(0x200200); // past the end
+    EXPECT_TRUE(bm.contains(0x1200));
+    EXPECT_TRUE(bm.contains(0x1000));
+    EXPECT_TRUE(bm.contains(0x100));
+    EXPECT_TRUE(bm.contains(0x200200));
+    EXPECT_FALSE(bm.contains(0x2200));
+    EXPECT_FALSE(bm.contains(0x2000));
+    EXPECT_FALSE(bm.contains(0x200));
+}
+
+TEST(PageBitmap, offsets) {
+    PageBitmap bm(0x10000000, 0x1000, 0x200);
+    const std::vector<uint64_t> grid = {0x200, 0x1200, 0x8000200, 0xffff200};
+    for (uint64_t offset : grid) bm.insert(offset);
+    bm.insert(0x5000); // off the grid
+
+    std::vector<uint64_t> expected = grid;
+    expected.push_back(0x5000);
+    EXPECT_EQ(expected, bm.offsets());
+    EXPECT_EQ(std::vector<uint64_t>({0x8000200, 0xffff200}), bm.offsets(0x5001));
+    EXPECT_TRUE(PageBitmap(0x10000, 0x1000).offsets().empty());
+}
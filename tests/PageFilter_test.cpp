@@ -0,0 +1,76 @@
+#include <gtest/gtest.h>
+#include <fstream>
+#include "scanning/PageFilter.cpp"
+#include "test_utils.hpp"
+
+TEST(PageFilter, is_zero) {
+    alignas(64) uint8_t buf[600] = {};
+    for (size_t size = 0; size < 300; size++) {
+        for (size_t start : {0, 1, 7, 32}) {
+            EXPECT_TRUE(PageFilter::is_zero(buf + start, size));
+            for (size_t i = 0; i < size; i += 13) {
+                buf[start + i] = 0x80;
+                EXPECT_FALSE(PageFilter::is_zero(buf + start, size)) << start << " " << size << " " << i;
+                buf[start + i] = 0;
+            }
+        }
+    }
+    buf[299] = 1; // right behind the range
+    EXPECT_TRUE(PageFilter::is_zero(buf, 299));
+}
+
+TEST(PageFilter, classify) {
+    alignas(8) uint8_t page[PAGE_SIZE] = {};
+    EXPECT_EQ(PageFilter::ZERO, PageFilter::classify(page));
+
+    page[PAGE_SIZE - 1] = 1;
+    EXPECT_EQ(0, PageFilter::classify(page));
+
+    std::ifstream f(find_fixture("00189000.bank"), std::ios::binary);
+    ASSERT_TRUE(f.is_open());
+    f.read((char*)page, PAGE_SIZE);
+    ASSERT_TRUE(((CBank*)page)->valid_fast());
+    EXPECT_EQ(PageFilter::BANK, PageFilter::classify(page));
+
+    ((CBank*)page)->header_page.zeroes[100] = 1;
+    EXPECT_EQ(0, PageFilter::classify(page));
+
+    memset(page, 0, PAGE_SIZE);
+    CSlot* slot = (CSlot*)page;
+    slot->crc = 0x12345678;
+    slot->has_snapshot = 1;
+    slot->max_banks = 0x10;
+    slot->allocated_banks = 2;
+    EXPECT_EQ(PageFilter::SLOT, PageFilter::classify(page));
+}
+
+// every page the validators accept must be a candidate
+TEST(PageFilter, no_false_negatives) {
+    const auto fname = find_fixture("AgentBack2024-09-16T164908.vib");
+    std::ifstream f(fname, std::ios::binary);
+    ASSERT_TRUE(f.is_open());
+    std::vector<uint8_t> data(std::filesystem::file_size(fname) / PAGE_SIZE * PAGE_SIZE);
+    f.read((char*)data.data(), data.size());
+
+    const size_t npages = data.size() / PAGE_SIZE;
+    std::vector<uint8_t> flags(npages);
+    PageFilter::classify(data.data(), npages, flags.data());
+
+    size_t nbanks = 0, nslots = 0, nzero = 0;
+    for (size_t i = 0; i < npages; i++) {
+        const uint8_t* page = data.data() + i * PAGE_SIZE;
+        EXPECT_EQ(is_all_zero(page, PAGE_SIZE), (flags[i] & PageFilter::ZERO) != 0) << i;
+        if (((const CBank*)page)->valid_fast()) {
+            EXPECT_TRUE(flags[i] & PageFilter::BANK) << i;
+            nbanks++;
+        }
+        if (((const CSlot*)page)->valid_fast()) {
+            EXPECT_TRUE(flags[i] & PageFilter::SLOT) << i;
+            nslots++;
+        }
+        nzero += (flags[i] & PageFilter::ZERO) != 0;
+    }
+    EXPECT_GT(nbanks, 0);
+    EXPECT_GT(nslots, 0);
+    EXPECT_GT(nzero, 0);
+}
@@ -0,0 +1,138 @@
+#include <gtest/gtest.h>
+#include "scanning/PatternSearch.cpp"
+
+#include <random>
+
+using Isa = PatternSearch::Isa;
+
+static const Isa all_isas[] = {Isa::SCALAR, Isa::SSE2, Isa::AVX2};
+
+// random bytes with patterns planted at random and at edge positions
+static std::vector<uint8_t> make_buf(size_t size, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::vector<uint8_t> buf(size);
+    for (auto& b : buf) {
+        b = rng() % 4 == 0 ? 0 : rng(); // plenty of zeros, like real data
+    }
+
+    const uint32_t magic = LZ_START_MAGIC;
+    const lz_hdr good = {magic, 0x12345678, 0x1000};
+    const lz_hdr bad = {magic, 0x12345678, BLOCK_SIZE + 1};
+    const uint8_t zlib[] = {0x78, 0x9c};
+    auto plant = [&](size_t pos, const void* p, size_t n) {
+        if (pos + n <= buf.size()) memcpy(buf.data() + pos, p, n);
+    };
+    for (int i = 0; i < 200; i++) {
+        const size_t pos = rng() % size;
+        switch (rng() % 5) {
+            case 0: plant(pos, &good, sizeof(good)); break;
+            case 1: plant(pos, &bad, sizeof(bad)); break;
+            case 2: plant(pos, zlib, sizeof(zlib)); break;
+            case 3: plant(pos, "<OibSummary>", 12); break;
+            case 4: plant(pos, &EMPTY_BLOCK_DIGEST, sizeof(EMPTY_BLOCK_DIGEST)); break;
+        }
+    }
+    plant(0, &good, sizeof(good));
+    plant(size - sizeof(EMPTY_BLOCK_DIGEST), &EMPTY_BLOCK_DIGEST, sizeof(EMPTY_BLOCK_DIGEST));
+    plant(size - 11, "<OibSummary>", 11); // doesn't fit
+    return buf;
+}
+
+static PatternSearch make_search(size_t align) {
+    PatternSearch ps;
+    ps.add(signatures::lz_hdr(align));
+    ps.add(signatures::lz_hdr_prefix(align));
+    ps.add(signatures::zlib_header(align));
+    ps.add(signatures::text("<OibSummary>", align));
+    ps.add(signatures::empty_block_digest(align));
+    return ps;
+}
+
+// every position, every pattern, the slow way
+static std::vector<PatternSearch::Match> reference(std::span<const uint8_t> buf, size_t align, size_t from, size_t to) {
+    std::vector<PatternSearch::Match> out;
+    const uint32_t magic = LZ_START_MAGIC;
+    for (size_t pos = from; pos < std::min(to, buf.size()); pos++) {
+        if (pos % align) continue;
+        const uint8_t* p = buf.data() + pos;
+        const size_t avail = buf.size() - pos;
+        if (avail >= sizeof(lz_hdr) && ((const lz_hdr*)p)->valid()) out.push_back({pos, 0});
+        if (avail >= sizeof(lz_hdr) && memcmp(p, &magic, 4) == 0 && p[11] == 0) out.push_back({pos, 1});
+        if (avail >= 2 && signatures::is_zlib_header(p)) out.push_back({pos, 2});
+        if (avail >= 12 && memcmp(p, "<OibSummary>", 12) == 0) out.push_back({pos, 3});
+        if (avail >= 16 && memcmp(p, &EMPTY_BLOCK_DIGEST, 16) == 0) out.push_back({pos, 4});
+    }
+    return out;
+}
+
+TEST(PatternSearch, matches_reference) {
+    const auto buf = make_buf(100000, 1);
+    for (size_t align : {1, 2, 4, 16, 32, 64, 4096}) {
+        PatternSearch ps = make_search(align);
+        const auto expected = reference(buf, align, 0, SIZE_MAX);
+        ASSERT_FALSE(expected.empty());
+        for (Isa isa : all_isas) {
+            ps.set_isa(isa);
+            std::vector<PatternSearch::Match> found;
+            ps.find(buf, found);
+            EXPECT_EQ(expected, found) << "align " << align << ", " << PatternSearch::isa_name(ps.isa());
+        }
+    }
+}
+
+TEST(PatternSearch, from_to) {
+    const auto buf = make_buf(5000, 2);
+    PatternSearch ps = make_search(1);
+    for (Isa isa : all_isas) {
+        ps.set_isa(isa);
+        for (size_t from : {0, 1, 7, 31, 33, 1000, 4990}) {
+            for (size_t to : {0, 1, 33, 64, 2001, 4999, 5000, 10000}) {
+                std::vector<PatternSearch::Match> found;
+                ps.find(buf, found, from, to);
+                EXPECT_EQ(reference(buf, 1, from, to), found) << from << ".." << to << ", " << PatternSearch::isa_name(ps.isa());
+            }
+        }
+    }
+}
+
+TEST(PatternSearch, short_buffers) {
+    PatternSearch ps = make_search(1);
+    for (Isa isa : all_isas) {
+        ps.set_isa(isa);
+        for (size_t size = 0; size < 80; size++) {
+            std::vector<uint8_t> buf(size, 0);
+            if (size >= 16) memcpy(buf.data() + size - 16, &EMPTY_BLOCK_DIGEST, 16);
+            std::vector<PatternSearch::Match> found;
+            ps.find(buf, found);
+            EXPECT_EQ(reference(buf, 1, 0, SIZE_MAX), found) << size;
+        }
+    }
+}
+
+TEST(PatternSearch, find_first) {
+    const auto buf = make_buf(20000, 3);
+    PatternSearch ps;
+    ps.add(signatures::empty_block_digest());
+    const auto all = reference(buf, 1, 0, SIZE_MAX);
+    size_t expected = SIZE_MAX;
+    for (const auto& m : all) {
+        if (m.id == 4) { expected = m.pos; break; }
+    }
+    ASSERT_NE(SIZE_MAX, expected);
+    for (Isa isa : all_isas) {
+        ps.set_isa(isa);
+        EXPECT_EQ(expected, ps.find_first(buf));
+        EXPECT_EQ(SIZE_MAX, ps.find_first(std::span(buf).first(expected + 15)));
+    }
+}
+
+TEST(PatternSearch, invalid_patterns) {
+    PatternSearch ps;
+    EXPECT_THROW(ps.add({}), std::invalid_argument);
+    EXPECT_THROW(ps.add({{1, 2}, {0xFF}, 1, nullptr}), std::invalid_argument);
+    EXPECT_THROW(ps.add({{1, 2}, {}, 3, nullptr}), std::invalid_argument);
+    for (size_t i = 0; i < PatternSearch::MAX_PATTERNS; i++) {
+        EXPECT_EQ(i, ps.add(signatures::text("x")));
+    }
+    EXPECT_THROW(ps.add(signatures::text("x")), std::invalid_argument);
+}
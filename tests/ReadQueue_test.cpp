@@ -0,0 +1,126 @@
+#include <gtest/gtest.h>
+#include "io/Reader.cpp"
+#include "io/ReadQueue.cpp"
+#include <fstream>
+
+static std::vector<uint8_t> make_test_file(const char* fname, size_t size) {
+    std::vector<uint8_t> data(size);
+    for (size_t i = 0; i < size; i++) {
+        data[i] = (uint8_t)(i * 7 + i / 256);
+    }
+    std::ofstream file(fname, std::ios::binary);
+    file.write((const char*)data.data(), data.size());
+    return data;
+}
+
+TEST(ReadQueue, push_reap) {
+    auto data = make_test_file("test_rq.bin", 0x10000);
+    Reader reader("test_rq.bin");
+    ReadQueue q(reader, 4);
+
+    std::vector<uint8_t> bufs[4];
+    for (int i = 0; i < 4; i++) {
+        bufs[i].resize(0x1000);
+        q.push(i * 0x3000, bufs[i].data(), bufs[i].size(), i);
+    }
+    EXPECT_EQ(4, q.pending());
+    EXPECT_THROW(q.push(0, bufs[0].data(), 0x1000), std::logic_error);
+
+    std::vector<ReadQueue::Completion> done;
+    while (q.pending()) {
+        q.reap(done);
+    }
+    ASSERT_EQ(4, done.size());
+    for (const auto& c : done) {
+        EXPECT_EQ(0, c.error);
+        EXPECT_EQ(0x1000, c.nread);
+        EXPECT_EQ(0, memcmp(data.data() + c.tag * 0x3000, bufs[c.tag].data(), 0x1000));
+    }
+}
+
+TEST(ReadQueue, short_read_at_eof) {
+    auto data = make_test_file("test_rq.bin", 0x1800);
+    Reader reader("test_rq.bin");
+    ReadQueue q(reader, 2);
+
+    std::vector<uint8_t> buf(0x1000);
+    q.push(0x1000, buf.data(), buf.size(), 42);
+
+    std::vector<ReadQueue::Completion> done;
+    ASSERT_EQ(1, q.reap(done));
+    EXPECT_EQ(42, done[0].tag);
+    EXPECT_EQ(0x800, done[0].nread);
+    EXPECT_EQ(0, memcmp(data.data() + 0x1000, buf.data(), 0x800));
+}
+
+TEST(ReadQueue, read_at_chunks) {
+    auto data = make_test_file("test_rq.bin", 0x23456);
+    Reader reader("test_rq.bin");
+    ReadQueue q(reader, 3);
+
+    std::vector<uint8_t> buf(0x30000);
+    EXPECT_EQ(0x23456 - 0x123, q.read_at(0x123, buf.data(), buf.size(), 0x4000));
+    EXPECT_EQ(0, memcmp(data.data() + 0x123, buf.data(), 0x23456 - 0x123));
+    EXPECT_EQ(0, q.pending());
+}
+
+TEST(ReadQueue, read_at_matches_reader) {
+    auto data = make_test_file("test_rq.bin", 0x10000);
+    Reader reader("test_rq.bin");
+    ReadQueue q(reader, 8);
+
+    std::vector<uint8_t> buf1(0x8000), buf2(0x8000);
+    EXPECT_EQ(reader.read_at(0x7000, buf1.data(), buf1.size()), q.read_at(0x7000, buf2.data(), buf2.size(), 0x1000));
+    EXPECT_EQ(buf1, buf2);
+}
+
+TEST(ReadQueue, read_at_past_eof) {
+    make_test_file("test_rq.bin", 0x1000);
+    Reader reader("test_rq.bin");
+    ReadQueue q(reader);
+
+    EXPECT_EQ(0, q.read_at(0x1000, nullptr, 0x1000, 0x100));
+    EXPECT_THROW(q.read_at(-1, nullptr, 0x1000, 0x100), std::invalid_argument);
+}
+
+TEST(ReadQueue, concatenated_source) {
+    auto data = make_test_file("test_rq.bin", 0x10000);
+    std::ofstream("test_rq.lst") << "test_rq.bin\ntest_rq.bin\n";
+    Reader reader("@test_rq.lst");
+    ReadQueue q(reader, 4);
+    EXPECT_FALSE(q.is_async()); // no single fd to submit to
+
+    std::vector<uint8_t> buf(0x8000);
+    EXPECT_EQ(buf.size(), q.read_at(0xc000, buf.data(), buf.size(), 0x1000));
+    EXPECT_EQ(0, memcmp(data.data() + 0xc000, buf.data(), 0x4000));
+    EXPECT_EQ(0, memcmp(data.data(), buf.data() + 0x4000, 0x4000));
+}
+
+class ReadQueueTest : public ::testing::Test {
+    protected:
+    // make the kernel answer -EINVAL like 5.1-5.5 do for IORING_OP_READ
+    static void break_read_op(ReadQueue& q) {
+#ifdef HAVE_IO_URING
+        q.m_read_op = IORING_OP_LAST;
+#endif
+    }
+};
+
+TEST_F(ReadQueueTest, read_op_unsupported) {
+    auto data = make_test_file("test_rq.bin", 0x10000);
+    Reader reader("test_rq.bin");
+    ReadQueue q(reader, 4);
+    if (!q.is_async()) {
+        GTEST_SKIP() << "no io_uring here";
+    }
+    break_read_op(q);
+
+    std::vector<uint8_t> buf(0x10000);
+    EXPECT_EQ(buf.size(), q.read_at(0, buf.data(), buf.size(), 0x1000));
+    EXPECT_EQ(data, buf);
+    EXPECT_FALSE(q.is_async()); // stays synchronous
+
+    std::fill(buf.begin(), buf.end(), 0);
+    EXPECT_EQ(buf.size(), q.read_at(0, buf.data(), buf.size(), 0x1000));
+    EXPECT_EQ(data, buf);
+}
@@ -1,5 +1,6 @@
 #include <gtest/gtest.h>
 #include "io/Reader.cpp"
+#include <algorithm>
 #include <fstream>
 
 TEST(Reader, open_not_existing_file) {
@@ -77,3 +78,211 @@ TEST(Reader, align){
     Reader reader("test.bin");
     EXPECT_EQ(0, reader.get_align());
 }
+
+TEST(Reader, direct_unaligned_read){
+    std::vector<uint8_t> data(0x3456);
+    for (size_t i = 0; i < data.size(); i++) {
+        data[i] = (uint8_t)(i * 13);
+    }
+    std::ofstream file("test.bin", std::ios::binary);
+    file.write((const char*)data.data(), data.size());
+    file.close();
+
+    // falls back to buffered reads if the filesystem has no O_DIRECT, result must be the same either way
+    Reader reader("test.bin", Reader::RF_DIRECT);
+    if (reader.is_direct()) {
+        EXPECT_NE(0, reader.get_align());
+    }
+
+    std::vector<uint8_t> buf(0x2001);
+    EXPECT_EQ(0x2001, reader.read_at(0x123, buf.data() + 0, 0x2001));
+    EXPECT_EQ(0, memcmp(data.data() + 0x123, buf.data(), 0x2001));
+
+    // unaligned buffer, aligned offset, short read at EOF
+    EXPECT_EQ(0x456, reader.read_at(0x3000, buf.data() + 1, 0x1000));
+    EXPECT_EQ(0, memcmp(data.data() + 0x3000, buf.data() + 1, 0x456));
+}
+
+TEST(Reader, mmap_view){
+    std::vector<uint8_t> data(0x2345);
+    for (size_t i = 0; i < data.size(); i++) {
+        data[i] = (uint8_t)(i * 11);
+    }
+    std::ofstream file("test.bin", std::ios::binary);
+    file.write((const char*)data.data(), data.size());
+    file.close();
+
+    Reader reader("test.bin", Reader::RF_MMAP);
+    ASSERT_TRUE(reader.is_mapped());
+
+    buf_t fallback;
+    auto v = reader.view(0x100, 0x1000, fallback);
+    EXPECT_EQ(0x1000, v.size());
+    EXPECT_TRUE(fallback.empty()); // zero-copy
+    EXPECT_EQ(0, memcmp(data.data() + 0x100, v.data(), v.size()));
+
+    // crosses EOF: copied, tail zero-filled
+    v = reader.view(0x2000, 0x1000, fallback);
+    EXPECT_EQ(fallback.data(), v.data());
+    EXPECT_EQ(0x1000, v.size());
+    EXPECT_EQ(0, memcmp(data.data() + 0x2000, v.data(), 0x345));
+    EXPECT_TRUE(std::all_of(v.begin() + 0x345, v.end(), [](uint8_t c){ return c == 0; }));
+
+    std::vector<uint8_t> buf(0x1000);
+    EXPECT_EQ(0x345, reader.read_at(0x2000, buf.data(), buf.size()));
+    EXPECT_EQ(0, memcmp(data.data() + 0x2000, buf.data(), 0x345));
+}
+
+TEST(Reader, view_not_mapped){
+    std::vector<uint8_t> data(0x1000, 0x5a);
+    std::ofstream file("test.bin", std::ios::binary);
+    file.write((const char*)data.data(), data.size());
+    file.close();
+
+    Reader reader("test.bin");
+    EXPECT_FALSE(reader.is_mapped());
+
+    buf_t fallback;
+    auto v = reader.view(0x10, 0x100, fallback);
+    EXPECT_EQ(fallback.data(), v.data());
+    EXPECT_EQ(0x100, v.size());
+    EXPECT_EQ(0, memcmp(data.data(), v.data(), v.size()));
+}
+
+TEST(Reader, known_bad_regions){
+    std::vector<uint8_t> data(0x3000, 0x5a);
+    std::ofstream file("test.bin", std::ios::binary);
+    file.write((const char*)data.data(), data.size());
+    file.close();
+
+    auto bad = std::make_shared<BadRegionMap>();
+    bad->add(0x1000, 0x200);
+
+    Reader reader("test.bin");
+    reader.set_bad_regions(bad);
+
+    std::vector<uint8_t> buf(0x1000);
+    EXPECT_EQ(0x1000, reader.read_at(0, buf.data(), buf.size()));
+    EXPECT_THROW(reader.read_at(0x800, buf.data(), buf.size()), Reader::ReadError);
+
+    // known bad part is zero-filled, the rest is read
+    std::fill(buf.begin(), buf.end(), 0xff);
+    EXPECT_EQ(0x1000, reader.read_salvage(0x800, buf.data(), buf.size()));
+    EXPECT_TRUE(std::all_of(buf.begin(), buf.begin() + 0x800, [](uint8_t c){ return c == 0x5a; }));
+    EXPECT_TRUE(std::all_of(buf.begin() + 0x800, buf.begin() + 0xa00, [](uint8_t c){ return c == 0; }));
+    EXPECT_TRUE(std::all_of(buf.begin() + 0xa00, buf.end(), [](uint8_t c){ return c == 0x5a; }));
+
+    // salvage mode: read_at() doesn't throw, clamps at EOF
+    reader.set_bad_regions(bad, true);
+    EXPECT_EQ(0x800, reader.read_at(0x2800, buf.data(), buf.size()));
+    EXPECT_EQ(0x1000, reader.read_at(0xc00, buf.data(), buf.size()));
+    EXPECT_TRUE(std::all_of(buf.begin() + 0x400, buf.begin() + 0x600, [](uint8_t c){ return c == 0; }));
+}
+
+TEST(Reader, access_hints){
+    std::vector<uint8_t> data(0x5000);
+    for (size_t i = 0; i < data.size(); i++) data[i] = i * 7;
+    std::ofstream file("test.bin", std::ios::binary);
+    file.write((const char*)data.data(), data.size());
+    file.close();
+
+    // hints never change what is read, also for unaligned, out-of-range and mapped ranges
+    for (int flags : {0, (int)Reader::RF_MMAP}) {
+        Reader reader("test.bin", flags);
+        reader.advise(Reader::Access::SEQUENTIAL);
+        reader.will_need(0x1234, 0x2000);
+        reader.will_need(0x4800, 0x10000);
+        reader.will_need(0x10000, 0x1000);
+
+        std::vector<uint8_t> buf(0x2000);
+        EXPECT_EQ(0x2000, reader.read_at(0x1234, buf.data(), buf.size()));
+        EXPECT_TRUE(std::equal(buf.begin(), buf.end(), data.begin() + 0x1234));
+
+        reader.drop_behind(0x1234, 0x2000);
+        reader.drop_behind(0, 0x100000);
+        reader.advise(Reader::Access::RANDOM);
+        EXPECT_EQ(0x2000, reader.read_at(0x1234, buf.data(), buf.size()));
+        EXPECT_TRUE(std::equal(buf.begin(), buf.end(), data.begin() + 0x1234));
+    }
+}
+
+TEST(Reader, concatenated){
+    std::vector<uint8_t> data(0x5345);
+    for (size_t i = 0; i < data.size(); i++) data[i] = i * 13;
+
+    std::filesystem::create_directories("parts");
+    const std::vector<std::pair<const char*, size_t>> parts = {{"parts/p1", 0x1800}, {"parts/p2", 0}, {"parts/p3", 0x3000}, {"parts/p4", 0xb45}};
+    size_t pos = 0;
+    for (const auto& [name, size] : parts) {
+        std::ofstream file(name, std::ios::binary);
+        file.write((const char*)data.data() + pos, size);
+        pos += size;
+    }
+    std::ofstream list("parts/list.txt");
+    list << "# split image\np1\np2\r\n\np3\n" << std::filesystem::absolute("parts/p4").string() << "\n";
+    list.close();
+
+    EXPECT_EQ(data.size(), Reader::get_size("@parts/list.txt"));
+    for (int flags : {0, (int)Reader::RF_MMAP}) {
+        Reader reader("@parts/list.txt", flags);
+        EXPECT_TRUE(reader.is_concatenated());
+        EXPECT_FALSE(reader.is_mapped());
+        EXPECT_EQ(-1, reader.fd());
+        EXPECT_EQ(data.size(), reader.size());
+
+        // spans p1, the empty p2 and p3
+        std::vector<uint8_t> buf(0x2000);
+        EXPECT_EQ(0x2000, reader.read_at(0x1000, buf.data(), buf.size()));
+        EXPECT_TRUE(std::equal(buf.begin(), buf.end(), data.begin() + 0x1000));
+
+        // crosses into the last part, short at EOF
+        EXPECT_EQ(0x545, reader.read_at(0x4e00, buf.data(), buf.size()));
+        EXPECT_TRUE(std::equal(buf.begin(), buf.begin() + 0x545, data.begin() + 0x4e00));
+        EXPECT_EQ(0, reader.read_at(data.size(), buf.data(), buf.size()));
+
+        buf_t fallback;
+        auto view = reader.view(0x17f0, 0x20, fallback);
+        EXPECT_TRUE(std::equal(view.begin(), view.end(), data.begin() + 0x17f0));
+
+        reader.will_need(0x1000, 0x4000);
+        reader.drop_behind(0, data.size());
+    }
+
+    std::ofstream("parts/empty.txt") << "# nothing\n";
+    EXPECT_THROW(Reader("@parts/empty.txt"), std::runtime_error);
+    EXPECT_THROW(Reader("@parts/missing.txt"), std::runtime_error);
+}
+
+TEST(Reader, data_extent){
+    // sparse file: hole, 0x2000 of data at 0x200000, hole up to 0x400000
+    {
+        std::ofstream file("sparse.bin", std::ios::binary);
+        file.seekp(0x200000);
+        std::vector<char> data(0x2000, 'x');
+        file.write(data.data(), data.size());
+    }
+    std::filesystem::resize_file("sparse.bin", 0x400000);
+
+    // filesystems without hole support report everything as data, so only check what must hold in any case
+    for (const char* fname : {"sparse.bin", "@sparse.lst"}) {
+        std::ofstream("sparse.lst") << "sparse.bin\nsparse.bin\n";
+        Reader reader(fname);
+        const off_t size = reader.size();
+
+        auto [start, end] = reader.data_extent(0);
+        EXPECT_LE(start, 0x200000);
+        EXPECT_GE(end, 0x202000);
+        EXPECT_LE(end, size);
+
+        std::tie(start, end) = reader.data_extent(0x300000);
+        EXPECT_GE(start, 0x300000);
+        EXPECT_LE(start, end);
+        EXPECT_LE(end, size);
+        if (reader.is_concatenated()) {
+            EXPECT_LE(start, 0x600000); // data of the second part
+        }
+
+        EXPECT_EQ(std::make_pair(size, size), reader.data_extent(size));
+        EXPECT_THROW(reader.data_extent(-1), std::invalid_argument);
+    }
+}
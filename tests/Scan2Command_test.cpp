@@ -1,6 +1,7 @@
 #include <gtest/gtest.h>
 #include <blake3z_file.hpp>
 #include "commands/Scan2Command.hpp"
+#include "data/CarvedLog.hpp"
 #include "test_utils.hpp"
 
 extern argparse::ArgumentParser program;
@@ -16,6 +17,13 @@ class Scan2CommandTest : public CmdTestBase<Scan2Command> {
         delete cmd;
     }
 
+    // a fresh command for every run, argparse can't parse twice
+    int scan(const std::vector<std::string>& args) {
+        Scan2Command scan;
+        scan.parser().parse_args(args);
+        return scan.run();
+    }
+
     Scan2Command* cmd;
 };
 
@@ -59,6 +67,114 @@ TEST_F(Scan2CommandTest, scan_vbk_blocks) {
     ASSERT_EQ(read_file(find_fixture("AgentBack2024-09-16T163946.vbk.csv")), read_file(get_out_dir(fname) / "carved_blocks.csv"));
 }
 
+// the binary log holds the same blocks as the csv
+TEST_F(Scan2CommandTest, scan_vbk_blocks_no_csv) {
+    const std::string fname = vbk_fname_str();
+    std::filesystem::remove_all(get_out_dir(fname));
+
+    cmd->parser().parse_args({"unused", fname, "--blocks", "--no-csv"});
+    ASSERT_EQ(0, cmd->run());
+
+    ASSERT_FALSE(std::filesystem::exists(get_out_dir(fname) / "carved_blocks.csv"));
+    std::ostringstream csv;
+    CarvedLog::export_csv(get_out_dir(fname) / CarvedLog::FNAME, csv);
+    ASSERT_EQ(read_file(find_fixture("AgentBack2024-09-16T163946.vbk.csv")), csv.str());
+}
+
+static std::string read_binary(const fs::path& path) {
+    std::ifstream f(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(f), {});
+}
+
+// a rescan with --skip-covered neither probes pages carved by the first scan nor appends its blocks again
+TEST_F(Scan2CommandTest, skip_covered_rescan) {
+    const fs::path fname = "tmp/skip_covered.vbk";
+    fs::create_directories(fname.parent_path());
+    fs::copy_file(vbk_fname(), fname, fs::copy_options::overwrite_existing);
+    fs::remove_all(get_out_dir(fname));
+
+    ASSERT_EQ(0, scan({"unused", fname.string(), "--blocks"}));
+    const std::string csv = read_file(get_out_dir(fname) / "carved_blocks.csv");
+    const std::string log = read_binary(get_out_dir(fname) / CarvedLog::FNAME);
+    ASSERT_EQ(read_file(find_fixture("AgentBack2024-09-16T163946.vbk.csv")), csv);
+
+    // plant the block found at 18f000 into 18a000, the second page of the covered block at 189000
+    const std::string src = read_binary(fname);
+    {
+        std::fstream f(fname, std::ios::in | std::ios::out | std::ios::binary);
+        f.seekp(0x18a000);
+        f.write(src.data() + 0x18f000, 0x9b);
+    }
+    const std::string planted = "00000018a000;00009b;0000f9;eaa01fada07f91c3fb07cff5cc3afd3e;c2d4afa2;LZ4\n";
+
+    ASSERT_EQ(0, scan({"unused", fname.string(), "--blocks", "--skip-covered"}));
+    EXPECT_EQ(csv, read_file(get_out_dir(fname) / "carved_blocks.csv"));
+    EXPECT_EQ(log, read_binary(get_out_dir(fname) / CarvedLog::FNAME));
+
+    // a full rescan does find the planted block
+    ASSERT_EQ(0, scan({"unused", fname.string(), "--blocks"}));
+    EXPECT_NE(std::string::npos, read_file(get_out_dir(fname) / "carved_blocks.csv").find(planted));
+
+    fs::remove_all(get_out_dir(fname));
+    fs::remove(fname);
+}
+
+TEST_F(Scan2CommandTest, checkpoint_removed_when_complete) {
+    const std::string fname = vbk_fname_str();
+    std::filesystem::remove_all(get_out_dir(fname));
+
+    cmd->parser().parse_args({"unused", fname, "--blocks", "--checkpoint", "1"});
+    ASSERT_EQ(0, cmd->run());
+    EXPECT_FALSE(std::filesystem::exists(get_out_dir(fname) / "scan.checkpoint"));
+}
+
+TEST_F(Scan2CommandTest, resume_needs_checkpoint) {
+    const std::string fname = vbk_fname_str();
+    std::filesystem::remove_all(get_out_dir(fname));
+
+    cmd->parser().parse_args({"unused", fname, "--blocks", "--resume"});
+    EXPECT_THROW(cmd->run(), std::runtime_error);
+}
+
+TEST_F(Scan2CommandTest, resume_rejects_range) {
+    const std::string fname = vbk_fname_str();
+
+    cmd->parser().parse_args({"unused", fname, "--resume", "--range", "1000:"});
+    EXPECT_THROW(cmd->run(), std::invalid_argument);
+}
+
+TEST_F(Scan2CommandTest, scan_vbk_blocks_deep_ring) {
+    const std::string fname = vbk_fname_str();
+    std::filesystem::remove_all(get_out_dir(fname));
+
+    // results must not depend on how the file is split into buffers
+    cmd->parser().parse_args({"unused", fname, "--blocks", "--buffers", "7", "--buffer-size", "1"});
+    ASSERT_EQ(0, cmd->run());
+
+    ASSERT_EQ(read_file(find_fixture("AgentBack2024-09-16T163946.vbk.csv")), read_file(get_out_dir(fname) / "carved_blocks.csv"));
+}
+
+TEST_F(Scan2CommandTest, scan_vbk_blocks_threads) {
+    const std::string fname = vbk_fname_str();
+    std::filesystem::remove_all(get_out_dir(fname));
+
+    // output must be identical to the single-threaded scan
+    cmd->parser().parse_args({"unused", fname, "--blocks", "--threads", "4"});
+    ASSERT_EQ(0, cmd->run());
+
+    ASSERT_EQ(read_file(find_fixture("AgentBack2024-09-16T163946.vbk.csv")), read_file(get_out_dir(fname) / "carved_blocks.csv"));
+}
+
+TEST_F(Scan2CommandTest, scan_vbk_blocks_zlib_threads) {
+    const std::string fname = find_fixture("hi_comp.vbk").string();
+    std::filesystem::remove_all(get_out_dir(fname));
+
+    cmd->parser().parse_args({"unused", fname, "--blocks", "-j", "3", "--buffers", "4", "--buffer-size", "1"});
+    ASSERT_EQ(0, cmd->run());
+
+    ASSERT_EQ(read_file(find_fixture("hi_comp.vbk.csv")), read_file(get_out_dir(fname) / "carved_blocks.csv"));
+}
+
 TEST_F(Scan2CommandTest, scan_vbk_blocks_zlib) {
     const std::string fname = find_fixture("hi_comp.vbk").string();
     std::filesystem::remove_all(get_out_dir(fname));
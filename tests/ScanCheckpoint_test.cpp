@@ -0,0 +1,103 @@
+#include <gtest/gtest.h>
+#include "scanning/ScanCheckpoint.cpp"
+
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+static const std::filesystem::path fname = "test_scan.checkpoint";
+
+static ScanCheckpoint::Header make_header() {
+    ScanCheckpoint::Header hdr;
+    hdr.source_size = 0x123456789000;
+    hdr.start = 0x1000;
+    hdr.end = 0x100000000;
+    hdr.offset = 0x80000000;
+    hdr.flags = ScanCheckpoint::F_BLOCKS;
+    return hdr;
+}
+
+TEST(ScanCheckpoint, roundtrip) {
+    const std::map<uint32_t, std::pair<uint64_t, uint32_t>> m = {{1, {0x1000, 2}}, {0x7f00, {~0ULL, 3}}};
+    const std::unordered_map<uint64_t, int> um = {{5, -1}, {6, 100}};
+    const std::set<uint64_t> st = {1, 2, 3};
+    const std::vector<uint32_t> v = {};
+
+    ScanCheckpoint::Out out;
+    out.put(true);
+    out.put_all(m);
+    out.put_all(um);
+    out.put_all(st);
+    out.put_all(v);
+    ScanCheckpoint::save(fname, make_header(), out.data());
+
+    std::string payload;
+    const auto hdr = ScanCheckpoint::load(fname, &payload);
+    EXPECT_EQ(0x123456789000, hdr.source_size);
+    EXPECT_EQ(0x1000, hdr.start);
+    EXPECT_EQ(0x100000000, hdr.end);
+    EXPECT_EQ(0x80000000, hdr.offset);
+    EXPECT_EQ(ScanCheckpoint::F_BLOCKS, hdr.flags);
+
+    ScanCheckpoint::In in(payload);
+    EXPECT_TRUE(in.get<bool>());
+    std::remove_const_t<decltype(m)> m2;
+    std::remove_const_t<decltype(um)> um2 = {{7, 7}}; // replaced, not merged
+    std::remove_const_t<decltype(st)> st2;
+    std::vector<uint32_t> v2 = {1};
+    in.get_all(m2);
+    in.get_all(um2);
+    in.get_all(st2);
+    in.get_all(v2);
+    EXPECT_EQ(m, m2);
+    EXPECT_EQ(um, um2);
+    EXPECT_EQ(st, st2);
+    EXPECT_EQ(v, v2);
+    EXPECT_TRUE(in.eof());
+    EXPECT_THROW(in.get<uint8_t>(), std::runtime_error);
+}
+
+TEST(ScanCheckpoint, replaces_previous) {
+    auto hdr = make_header();
+    ScanCheckpoint::save(fname, hdr, "first");
+    hdr.offset += 0x1000;
+    ScanCheckpoint::save(fname, hdr, "second");
+
+    std::string payload;
+    EXPECT_EQ(hdr.offset, ScanCheckpoint::load(fname, &payload).offset);
+    EXPECT_EQ("second", payload);
+    std::filesystem::path tmp_fname = fname;
+    EXPECT_FALSE(std::filesystem::exists(tmp_fname += ".tmp"));
+}
+
+TEST(ScanCheckpoint, rejects_bad_files) {
+    std::filesystem::remove(fname);
+    EXPECT_THROW(ScanCheckpoint::load(fname), std::runtime_error);
+
+    ScanCheckpoint::save(fname, make_header(), std::string(100, 'x'));
+    const auto size = std::filesystem::file_size(fname);
+    for (size_t pos : {size_t(0), size_t(20), size / 2, size - 1}) {
+        ScanCheckpoint::save(fname, make_header(), std::string(100, 'x'));
+        {
+            std::fstream f(fname, std::ios::in | std::ios::out | std::ios::binary);
+            f.seekg(pos);
+            const char c = f.get() ^ 1;
+            f.seekp(pos);
+            f.put(c);
+        }
+        EXPECT_THROW(ScanCheckpoint::load(fname), std::runtime_error) << pos;
+    }
+
+    ScanCheckpoint::save(fname, make_header(), std::string(100, 'x'));
+    std::filesystem::resize_file(fname, size - 10);
+    EXPECT_THROW(ScanCheckpoint::load(fname), std::runtime_error);
+}
+
+TEST(ScanCheckpoint, bad_element_count) {
+    ScanCheckpoint::Out out;
+    out.put<uint64_t>(1000); // but no elements
+    ScanCheckpoint::In in(out.data());
+    std::vector<uint64_t> v;
+    EXPECT_THROW(in.get_all(v), std::runtime_error);
+}
@@ -0,0 +1,63 @@
+#include <gtest/gtest.h>
+#include "commands/Scan2Command.hpp"
+#include "commands/ScanMergeCommand.hpp"
+#include "data/CarvedLog.hpp"
+#include "test_utils.hpp"
+
+extern argparse::ArgumentParser program;
+
+class ScanMergeCommandTest : public CmdTestBase<ScanMergeCommand> {
+    protected:
+    void SetUp() override {
+        register_program_args(program);
+    }
+
+    // scan a range of fname into out_dir
+    void scan_range(const std::string& fname, const std::string& range, const std::filesystem::path& out_dir) {
+        std::filesystem::remove_all(out_dir);
+        program.parse_args({"unused", "-o", out_dir.string()});
+        Scan2Command scan;
+        scan.parser().parse_args({"unused", fname, "--blocks", "--range", range});
+        ASSERT_EQ(0, scan.run());
+    }
+
+    int merge(const std::vector<std::string>& args) {
+        ScanMergeCommand cmd;
+        cmd.parser().parse_args(args);
+        return cmd.run();
+    }
+
+    static std::string read_file(const std::filesystem::path& path) {
+        std::ifstream f(path, std::ios::binary);
+        std::ostringstream ss;
+        ss << f.rdbuf();
+        return ss.str();
+    }
+};
+
+TEST_F(ScanMergeCommandTest, registers_itself) {
+    ASSERT_NE(Command::registry()["scan-merge"], nullptr);
+}
+
+TEST_F(ScanMergeCommandTest, merge_two_shards) {
+    const std::string fname = vbk_fname_str();
+    const std::filesystem::path shard1 = "tmp/shard1.out", shard2 = "tmp/shard2.out";
+    scan_range(fname, "0:200000", shard1);
+    scan_range(fname, "200000:", shard2);
+
+    program.parse_args({"unused"});
+    std::filesystem::remove_all(get_out_dir(fname));
+
+    ASSERT_EQ(0, merge({"unused", fname, shard1.string(), shard2.string()}));
+
+    // same blocks as a single full scan
+    ASSERT_EQ(read_file(find_fixture("AgentBack2024-09-16T163946.vbk.csv")), read_file(get_out_dir(fname) / "carved_blocks.csv"));
+    std::ostringstream csv;
+    CarvedLog::export_csv(get_out_dir(fname) / CarvedLog::FNAME, csv);
+    ASSERT_EQ(read_file(find_fixture("AgentBack2024-09-16T163946.vbk.csv")), csv.str());
+    ASSERT_EQ(1, count_files_with_extension(get_out_dir(fname), ".slot"));
+}
+
+TEST_F(ScanMergeCommandTest, missing_shard) {
+    ASSERT_THROW(merge({"unused", vbk_fname_str(), "tmp/no_such_shard.out"}), std::invalid_argument);
+}
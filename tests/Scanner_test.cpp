@@ -75,3 +75,77 @@ TEST(check_hbuf, two) {
     *(uint16_t*)buf = 0xffff;
     EXPECT_FALSE(check_hbuf(buf));
 }
+
+// any byte other than 0 or 1 past the first word fails, at any alignment
+TEST(check_hbuf, unaligned) {
+    std::vector<char> data(0x1000 + 8, 1);
+    for (size_t align = 0; align < 8; align++) {
+        char* buf = data.data() + align;
+        memset(buf, 1, 0x1000);
+        *(uint16_t*)buf = 0x10;
+        EXPECT_TRUE(check_hbuf(buf));
+        for (size_t pos : {2, 7, 8, 63, 64, 0x800, 0xfff}) {
+            buf[pos] = 2;
+            EXPECT_FALSE(check_hbuf(buf)) << align << " " << pos;
+            buf[pos] = 0;
+            EXPECT_TRUE(check_hbuf(buf)) << align << " " << pos;
+        }
+    }
+}
+
+TEST(BackwardWindow, pages) {
+    const std::filesystem::path fname = "test_backward_window.bin";
+    const size_t fsize = BackwardWindow::CHUNK_SIZE * 2 + 0x1234;
+    std::vector<uint8_t> data(fsize);
+    for (size_t i = 0; i < fsize; i++) {
+        data[i] = i * 7 + (i >> 12);
+    }
+    std::ofstream(fname, std::ios::binary).write((const char*)data.data(), data.size());
+
+    {
+        Reader reader(fname);
+        BackwardWindow window(reader, fsize);
+        for (off_t pos : {(off_t)fsize - 0x1000, (off_t)fsize - 0x1001, (off_t)BackwardWindow::CHUNK_SIZE + 0x123, (off_t)BackwardWindow::CHUNK_SIZE - 0x1000, (off_t)0x8001, (off_t)0}) {
+            EXPECT_EQ(0, memcmp(data.data() + pos, window.page_at(pos), 0x1000)) << pos;
+        }
+        // past EOF reads as zeroes
+        const char* p = window.page_at(fsize - 0x10);
+        EXPECT_EQ(0, memcmp(data.data() + fsize - 0x10, p, 0x10));
+        EXPECT_EQ(std::vector<char>(0x1000 - 0x10, 0), std::vector<char>(p + 0x10, p + 0x1000));
+    }
+    std::filesystem::remove(fname);
+}
+
+TEST(BackwardWindow, misses) {
+    const std::filesystem::path fname = "test_backward_window.bin";
+    std::ofstream(fname, std::ios::binary).write("", 0);
+    {
+        Reader reader(fname);
+        BackwardWindow window(reader, 0);
+        EXPECT_EQ(0x10000, window.skip_misses(0x10000));
+
+        // a walk back from 0x20000 to 0x10000
+        for (off_t pos = 0x20000; pos >= 0x10000; pos -= 0x1000) {
+            window.add_miss(pos);
+        }
+        EXPECT_EQ(0x10000, window.skip_misses(0x21000 - 1));
+        EXPECT_EQ(0x10000, window.skip_misses(0x18000));
+        EXPECT_EQ(0x21000, window.skip_misses(0x21000));
+        EXPECT_EQ(0xf000, window.skip_misses(0xf000));
+
+        // a later walk from above joins the known run when it reaches it
+        for (off_t pos = 0x30000; pos >= 0x22000; pos -= 0x1000) {
+            window.add_miss(pos);
+        }
+        EXPECT_EQ(0x30000, window.skip_misses(0x30000)); // shorter than the known run, not used yet
+        window.add_miss(0x21000);
+        EXPECT_EQ(0x10000, window.skip_misses(0x30000));
+
+        // a bank in between splits the runs
+        window.add_miss(0x9000);
+        window.add_miss(0x8000);
+        EXPECT_EQ(0x10000, window.skip_misses(0x30000));
+        EXPECT_EQ(0x9000, window.skip_misses(0x9000));
+    }
+    std::filesystem::remove(fname);
+}
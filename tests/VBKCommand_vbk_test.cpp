@@ -34,6 +34,19 @@ TEST_F(VBKCommandTest, default) {
     EXPECT_THAT(output, HasSubstr("<BankInfo crc=cf25f173, offset=     20ba000, size=  42000>"));
 }
 
+// a mapped backup gives the same listing as the default plain reads
+TEST_F(VBKCommandTest, mmap) {
+    const std::string plain = capture_stdout([&](){
+        run_cmd({"unused", vbk_fname_str(), "-l"});
+    });
+    std::filesystem::remove_all(get_out_dir(vbk_fname_str()));
+    const std::string mapped = capture_stdout([&](){
+        run_cmd({"unused", vbk_fname_str(), "-l", "--mmap"});
+    });
+    EXPECT_THAT(mapped, HasSubstr("0000:0005 IntFib        1 25Kb   6745a759-2205-4cd2-b172-8ec8f7e60ef8 (075920a5-8905-ff57-696f-b06ebfc92287)/summary.xml"));
+    EXPECT_THAT(plain, HasSubstr("0000:0005 IntFib        1 25Kb   6745a759-2205-4cd2-b172-8ec8f7e60ef8 (075920a5-8905-ff57-696f-b06ebfc92287)/summary.xml"));
+}
+
 TEST_F(VBKCommandTest, list_files) {
     std::string output = capture_stdout([&](){
         run_cmd({"unused", vbk_fname_str(), "-l"});
@@ -96,3 +96,128 @@ TEST_F(WriterTest, seek_tell) {
     w.seek(5, SEEK_CUR);
     EXPECT_EQ(w.tell(), 15);
 }
+
+static std::string read_file(const char* fname) {
+    std::ifstream f(fname, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+}
+
+TEST_F(WriterTest, buffered_coalesces) {
+    for (bool async : {false, true}) {
+        std::string expected;
+        {
+            Writer w(test_fname);
+            w.set_buffered(0x100000, async);
+
+            // blocks bigger and smaller than a chunk, across several batches
+            std::string block(0x180000, 'a');
+            for (int i = 0; i < 5; i++) {
+                std::fill(block.begin(), block.end(), 'a' + i);
+                w.write(block.data(), block.size());
+                expected += block;
+            }
+            w.write("xyz", 3);
+            expected += "xyz";
+            EXPECT_EQ((off_t)expected.size(), w.tell());
+
+            // seek back and overwrite buffered data
+            w.seek(0x10);
+            w.write("over", 4);
+            expected.replace(0x10, 4, "over");
+            w.seek(0, SEEK_END);
+            EXPECT_EQ((off_t)expected.size(), w.tell());
+            w.close();
+        }
+        EXPECT_EQ(expected, read_file(test_fname)) << "async " << async;
+    }
+}
+
+TEST_F(WriterTest, buffered_holes) {
+    {
+        Writer w(test_fname);
+        w.set_buffered();
+        w.write("head", 4);
+        w.write_hole(0x2000);
+        w.write("mid", 3);
+        w.write_hole(0x1000); // trailing hole
+        EXPECT_EQ(4 + 0x2000 + 3 + 0x1000, w.tell());
+    }
+    std::string data = read_file(test_fname);
+    ASSERT_EQ(4 + 0x2000 + 3 + 0x1000, data.size());
+    EXPECT_EQ("head", data.substr(0, 4));
+    EXPECT_EQ(std::string(0x2000, '\0'), data.substr(4, 0x2000));
+    EXPECT_EQ("mid", data.substr(0x2004, 3));
+    EXPECT_EQ(std::string(0x1000, '\0'), data.substr(0x2007));
+}
+
+TEST_F(WriterTest, hole_over_existing_data) {
+    {
+        std::ofstream f(test_fname, std::ios::binary);
+        f << std::string(0x3000, 'x');
+    }
+    {
+        Writer w(test_fname, false);
+        w.set_buffered();
+        w.write("ab", 2);
+        w.write_hole(0x2000);
+        w.write("cd", 2);
+    }
+    std::string data = read_file(test_fname);
+    ASSERT_EQ(0x3000, data.size());
+    EXPECT_EQ("ab", data.substr(0, 2));
+    EXPECT_EQ(std::string(0x2000, '\0'), data.substr(2, 0x2000));
+    EXPECT_EQ("cd", data.substr(0x2002, 2));
+    EXPECT_EQ(std::string(0x3000 - 0x2004, 'x'), data.substr(0x2004));
+}
+
+TEST_F(WriterTest, copy_from) {
+    std::string src_data(0x30000, 0);
+    for (size_t i = 0; i < src_data.size(); i++) src_data[i] = 'a' + i % 26;
+    std::ofstream("copy_src.tmp", std::ios::binary) << src_data;
+    const int src_fd = open("copy_src.tmp", O_RDONLY);
+    ASSERT_NE(-1, src_fd);
+
+    for (int mode = 0; mode < 3; mode++) { // unbuffered, buffered sync, buffered async
+        std::filesystem::remove(test_fname);
+        std::string expected;
+        {
+            Writer w(test_fname);
+            if (mode) {
+                w.set_buffered(0x100000, mode == 2);
+            }
+            w.write("head", 4);
+            expected += "head";
+
+            // may fall back to a plain write, the result must be the same
+            auto copy = [&](off_t offset, size_t count) {
+                if (!w.copy_from(src_fd, offset, count)) {
+                    w.write(src_data.data() + offset, count);
+                }
+                expected.replace(w.tell() - count, count, src_data.substr(offset, count));
+            };
+            copy(0x1000, 0x10000);
+            w.write("mid", 3);
+            expected += "mid";
+            copy(0x123, 0x2345);
+            EXPECT_EQ((off_t)expected.size(), w.tell());
+
+            // buffered data under the copied range must not overwrite it later
+            w.seek(0x100);
+            w.write(std::string(0x100, 'x').data(), 0x100);
+            w.seek(0x80);
+            copy(0x20000, 0x200);
+            w.seek(expected.size());
+
+            // short source: nothing is written
+            EXPECT_FALSE(w.copy_from(src_fd, src_data.size() - 0x10, 0x100));
+            EXPECT_EQ((off_t)expected.size(), w.tell());
+#ifdef __linux__
+            EXPECT_TRUE(w.copy_from(src_fd, 0, 0x1000));
+            expected += src_data.substr(0, 0x1000);
+#endif
+        }
+        EXPECT_EQ(expected, read_file(test_fname)) << "mode " << mode;
+    }
+    close(src_fd);
+    std::filesystem::remove("copy_src.tmp");
+}
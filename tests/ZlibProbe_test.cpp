@@ -0,0 +1,124 @@
+#include <gtest/gtest.h>
+#include "scanning/ZlibProbe.cpp"
+#include "scanning/PatternSearch.hpp"
+
+#include <random>
+#include <vector>
+
+static constexpr size_t MAX_DECOMP = 0x100000;
+
+// one-shot inflate the way the scanner did it before ZlibProbe
+static bool reference_inflate(const uint8_t* data, size_t size, std::vector<uint8_t>& out, size_t& comp_size, size_t& decomp_size) {
+    z_stream strm = {};
+    strm.next_in = const_cast<Bytef*>(data);
+    strm.avail_in = size;
+    strm.next_out = out.data();
+    strm.avail_out = out.size();
+    if (inflateInit2(&strm, 15) != Z_OK) {
+        return false;
+    }
+    const int ret = inflate(&strm, Z_FINISH);
+    inflateEnd(&strm);
+    if (ret != Z_STREAM_END || strm.total_out == 0 || strm.total_out > MAX_DECOMP) {
+        return false;
+    }
+    comp_size = size - strm.avail_in;
+    decomp_size = strm.total_out;
+    return true;
+}
+
+static std::vector<uint8_t> compress(const std::vector<uint8_t>& src, int level) {
+    uLongf size = compressBound(src.size());
+    std::vector<uint8_t> out(size);
+    EXPECT_EQ(Z_OK, compress2(out.data(), &size, src.data(), src.size(), level));
+    out.resize(size);
+    return out;
+}
+
+TEST(ZlibProbe, valid_streams) {
+    std::mt19937 rng(1);
+    ZlibProbe zp;
+    std::vector<uint8_t> out(MAX_DECOMP + 0x1000);
+    for (size_t size : {1, 100, 0x1000, 0x10000, 0x100000}) {
+        for (int kind = 0; kind < 3; kind++) {
+            std::vector<uint8_t> src(size);
+            for (auto& b : src) {
+                b = kind == 0 ? 0 : kind == 1 ? rng() % 4 : rng(); // runs, text-like, incompressible
+            }
+            for (int level : {0, 1, 9}) {
+                auto comp = compress(src, level);
+                const size_t comp_len = comp.size();
+                comp.resize(comp_len + 0x200, 0xAA); // garbage behind the stream
+
+                ASSERT_TRUE(signatures::is_zlib_header(comp.data()));
+                EXPECT_TRUE(zp.probe(comp.data(), comp.size())) << size << " " << kind << " " << level;
+                size_t comp_size = 0, decomp_size = 0;
+                ASSERT_TRUE(zp.inflate(comp.data(), comp.size(), out, MAX_DECOMP, comp_size, decomp_size));
+                EXPECT_EQ(comp_len, comp_size);
+                ASSERT_EQ(size, decomp_size);
+                EXPECT_EQ(0, memcmp(src.data(), out.data(), size));
+
+                // damaged after the probed part: passes the probe, fails to inflate
+                if (comp_len > ZlibProbe::PROBE_IN_SIZE + 0x100) {
+                    comp[comp_len - 10] ^= 0x55;
+                    EXPECT_FALSE(zp.inflate(comp.data(), comp.size(), out, MAX_DECOMP, comp_size, decomp_size));
+                }
+            }
+        }
+    }
+}
+
+TEST(ZlibProbe, oversized) {
+    ZlibProbe zp;
+    std::vector<uint8_t> out(MAX_DECOMP + 0x1000);
+    const auto comp = compress(std::vector<uint8_t>(MAX_DECOMP + 1), 9);
+    size_t comp_size = 0, decomp_size = 0;
+    EXPECT_TRUE(zp.probe(comp.data(), comp.size()));
+    EXPECT_FALSE(zp.inflate(comp.data(), comp.size(), out, MAX_DECOMP, comp_size, decomp_size));
+}
+
+// random data behind a valid header: the probe must never reject what a full inflate accepts,
+// and the staged result must match the one-shot inflate exactly
+TEST(ZlibProbe, agrees_with_full_inflate) {
+    std::mt19937 rng(2);
+    ZlibProbe zp;
+    std::vector<uint8_t> out(MAX_DECOMP + 0x1000), ref_out(out.size());
+    std::vector<uint8_t> buf(0x2000);
+    size_t accepted = 0, random = 0, random_rejected = 0;
+    for (int i = 0; i < 20000; i++) {
+        for (auto& b : buf) {
+            b = rng();
+        }
+        buf[0] = 0x78;
+        buf[1] = 0x9c;
+        if (i % 4 == 0) {
+            buf[2] = 0x03; // fixed Huffman, end of block right away: an empty stream...
+            buf[3] = 0x00;
+            if (i % 8 == 0) {
+                buf[2] = 0x63; buf[3] = 0x00; buf[4] = 0x00; // ...or a single zero byte, then the adler32
+                buf[5] = 0x00; buf[6] = 0x01; buf[7] = 0x00; buf[8] = 0x01;
+            }
+        }
+
+        size_t ref_comp = 0, ref_decomp = 0, comp = 0, decomp = 0;
+        const bool ref = reference_inflate(buf.data(), buf.size(), ref_out, ref_comp, ref_decomp);
+        const bool probed = zp.probe(buf.data(), buf.size());
+        if (i % 4 != 0) {
+            random++;
+            random_rejected += !probed;
+        }
+        if (ref) {
+            accepted++;
+            ASSERT_TRUE(probed) << i;
+        }
+        if (probed) {
+            ASSERT_EQ(ref, zp.inflate(buf.data(), buf.size(), out, MAX_DECOMP, comp, decomp)) << i;
+            if (ref) {
+                EXPECT_EQ(ref_comp, comp);
+                EXPECT_EQ(ref_decomp, decomp);
+            }
+        }
+    }
+    EXPECT_GT(accepted, 0);
+    EXPECT_GT(random_rejected, random * 99 / 100) << random_rejected << " of " << random; // random data ends in the probe
+}
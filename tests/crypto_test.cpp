@@ -0,0 +1,126 @@
+#include <gtest/gtest.h>
+#include "utils/crypto.cpp"
+
+#include <random>
+
+// every key count exercises a different mix of 8-, 4-, 2- and 1-key groups
+TEST(AES256Multi, matches_single_key_decrypt) {
+    std::mt19937 rng(1);
+    std::vector<std::unique_ptr<crypto::AES256>> ciphers;
+    crypto::AES256Multi multi;
+    for (size_t nkeys = 0; nkeys <= 21; nkeys++) {
+        if (nkeys > 0) {
+            crypto::aes_key key;
+            for (auto& b : key.key) b = rng();
+            for (auto& b : key.iv) b = rng();
+            ciphers.push_back(std::make_unique<crypto::AES256>(key.key, key.iv));
+            multi.add(*ciphers.back());
+        }
+        ASSERT_EQ(nkeys, multi.size());
+
+        for (int t = 0; t < 10; t++) {
+            uint8_t block[16];
+            for (auto& b : block) b = rng();
+
+            std::vector<crypto::AES256Multi::block_t> out(nkeys);
+            multi.decrypt_first_block(block, out.data());
+            for (size_t i = 0; i < nkeys; i++) {
+                crypto::AES256Multi::block_t expected;
+                memcpy(expected.data(), block, 16);
+                ciphers[i]->decrypt(expected.data(), 16);
+                EXPECT_EQ(expected, out[i]) << nkeys << " keys, key " << i;
+            }
+        }
+    }
+
+    multi.clear();
+    EXPECT_EQ(0, multi.size());
+}
+
+// a CBC stream decrypted in uneven chunks must match one decrypt() of all of it
+TEST(AES256, decrypt_chunk_continues_cbc) {
+    std::mt19937 rng(2);
+    crypto::aes_key key;
+    for (auto& b : key.key) b = rng();
+    for (auto& b : key.iv) b = rng();
+    const crypto::AES256 cipher(key.key, key.iv);
+
+    std::vector<uint8_t> data(16 * 100);
+    for (auto& b : data) b = rng();
+    auto expected = data;
+    cipher.decrypt(expected, false);
+
+    uint8_t iv[16];
+    memcpy(iv, cipher.iv(), sizeof(iv));
+    size_t pos = 0;
+    for (size_t len : {16, 0, 48, 16 * 30, 16 * 66}) {
+        cipher.decrypt_chunk(data.data() + pos, len, iv);
+        pos += len;
+    }
+    ASSERT_EQ(data.size(), pos);
+    EXPECT_EQ(expected, data);
+    EXPECT_THROW(cipher.decrypt_chunk(data.data(), 15, iv), std::runtime_error);
+}
+
+static std::vector<uint8_t> unhex(const std::string& hex) {
+    std::vector<uint8_t> out;
+    for (size_t i = 0; i < hex.size(); i += 2) {
+        out.push_back(std::stoul(hex.substr(i, 2), nullptr, 16));
+    }
+    return out;
+}
+
+// NIST SP 800-38A F.2.6, CBC-AES256.Decrypt
+TEST(AES256, decrypt_known_answer) {
+    const auto key = unhex("603deb1015ca71be2b73aef0857d77811f352c073b6108d72d9810a30914dff4");
+    const auto iv = unhex("000102030405060708090a0b0c0d0e0f");
+    const auto plain = unhex("6bc1bee22e409f96e93d7e117393172aae2d8a571e03ac9c9eb76fac45af8e51"
+                             "30c81c46a35ce411e5fbc1191a0a52eff69f2445df4f9b17ad2b417be66c3710");
+    const auto encrypted = unhex("f58c4c04d6e5f1ba779eabfb5f7bfbd69cfc4e967edb808d679f777bc6702c7d"
+                                 "39f23369a9d9bacfa530e26304231461b2eb05e2c39be9fcda6c19078c6a9d1b");
+    const crypto::AES256 cipher(key.data(), iv.data());
+
+    auto data = encrypted;
+    EXPECT_EQ(data.size(), cipher.decrypt(data.data(), data.size()));
+    EXPECT_EQ(plain, data);
+
+    // only the first size bytes are decrypted, the vector keeps its size
+    data = encrypted;
+    cipher.decrypt(data, false, 32);
+    EXPECT_EQ(std::vector<uint8_t>(plain.begin(), plain.begin() + 32), std::vector<uint8_t>(data.begin(), data.begin() + 32));
+    EXPECT_EQ(std::vector<uint8_t>(encrypted.begin() + 32, encrypted.end()), std::vector<uint8_t>(data.begin() + 32, data.end()));
+
+    // the iv of the cipher is not consumed by a decrypt
+    data = encrypted;
+    cipher.decrypt(data, false);
+    EXPECT_EQ(plain, data);
+
+    EXPECT_THROW(cipher.decrypt(data.data(), 15), std::runtime_error);
+    EXPECT_THROW(cipher.decrypt(data, false, 80), std::runtime_error);
+}
+
+// PKCS#7 padding is stripped from the decrypted data
+TEST(AES256, decrypt_removes_padding) {
+    std::mt19937 rng(3);
+    crypto::aes_key key;
+    for (auto& b : key.key) b = rng();
+    for (auto& b : key.iv) b = rng();
+    const crypto::AES256 cipher(key.key, key.iv);
+
+    // EVP pads "hello" with 11 bytes of 11
+    std::vector<uint8_t> block(32);
+    int len1 = 0, len2 = 0;
+    EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+    ASSERT_EQ(1, EVP_EncryptInit_ex(ctx, EVP_aes_256_cbc(), nullptr, key.key, key.iv));
+    ASSERT_EQ(1, EVP_EncryptUpdate(ctx, block.data(), &len1, reinterpret_cast<const uint8_t*>("hello"), 5));
+    ASSERT_EQ(1, EVP_EncryptFinal_ex(ctx, block.data() + len1, &len2));
+    EVP_CIPHER_CTX_free(ctx);
+    block.resize(len1 + len2);
+    ASSERT_EQ(16, block.size());
+
+    auto data = block;
+    cipher.decrypt(data, true);
+    EXPECT_EQ(std::vector<uint8_t>({'h', 'e', 'l', 'l', 'o'}), data);
+    data = block;
+    EXPECT_EQ(5, cipher.decrypt(data.data(), data.size(), true));
+}